@@ -0,0 +1,267 @@
+/**
+ * uBLoad chunked image stream checker
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "u_assert.h"
+#include "sha256.h"
+#include "chunk_stream.h"
+
+
+static uint32_t chunk_stream_be32(const uint8_t *b) {
+	return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+}
+
+
+#define CHUNK_STREAM_OUT_OK 0
+#define CHUNK_STREAM_OUT_FAILED -1
+static int32_t chunk_stream_out(struct chunk_stream *s, const uint8_t *data, uint32_t len) {
+	if (s->output(data, len, s->output_ctx) != CHUNK_STREAM_OUTPUT_OK) {
+		return CHUNK_STREAM_OUT_FAILED;
+	}
+	s->total += len;
+
+	return CHUNK_STREAM_OUT_OK;
+}
+
+
+/* Hash data of the current chunk. Full blocks are processed immediately,
+ * the last partial block is kept in the block buffer. */
+static void chunk_stream_hash(struct chunk_stream *s, const uint8_t *data, uint32_t len) {
+	while (len > 0) {
+		uint32_t used = s->chunk_pos % SHA256_BLOCK_SIZE;
+		uint32_t n = SHA256_BLOCK_SIZE - used;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(s->block + used, data, n);
+		s->chunk_pos += n;
+		data += n;
+		len -= n;
+
+		if ((s->chunk_pos % SHA256_BLOCK_SIZE) == 0) {
+			sha256_block(&s->hash, s->block);
+		}
+	}
+}
+
+
+/* Compare hash of the current chunk with the table and start the next one. */
+#define CHUNK_STREAM_CHECK_CHUNK_OK 0
+#define CHUNK_STREAM_CHECK_CHUNK_FAILED -1
+static int32_t chunk_stream_check_chunk(struct chunk_stream *s) {
+	uint8_t hash[CHUNK_STREAM_HASH_SIZE];
+
+	sha256_final(&s->hash, s->block, s->chunk_pos);
+	sha256_get(&s->hash, hash, 0, sizeof(hash));
+	if (memcmp(hash, s->table + s->chunk * CHUNK_STREAM_HASH_SIZE, CHUNK_STREAM_HASH_SIZE)) {
+		return CHUNK_STREAM_CHECK_CHUNK_FAILED;
+	}
+
+	s->chunk++;
+	s->chunk_pos = 0;
+	sha256_init(&s->hash);
+
+	return CHUNK_STREAM_CHECK_CHUNK_OK;
+}
+
+
+int32_t chunk_stream_init(
+	struct chunk_stream *s,
+	uint32_t magic,
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx),
+	void *output_ctx
+) {
+	if (u_assert(s != NULL) ||
+	    u_assert(output != NULL)) {
+		return CHUNK_STREAM_INIT_FAILED;
+	}
+
+	s->state = CHUNK_STREAM_STATE_HEADER;
+	s->magic = magic;
+	s->header_len = 0;
+	s->chunk_size = 0;
+	s->len = 0;
+	s->chunks = 0;
+	s->table_len = 0;
+	s->chunk = 0;
+	s->chunk_pos = 0;
+	sha256_init(&s->hash);
+	s->total = 0;
+	s->output = output;
+	s->output_ctx = output_ctx;
+
+	return CHUNK_STREAM_INIT_OK;
+}
+
+
+int32_t chunk_stream_feed(struct chunk_stream *s, const uint8_t *data, uint32_t len) {
+	if (u_assert(s != NULL) ||
+	    u_assert(data != NULL)) {
+		return CHUNK_STREAM_FEED_FAILED;
+	}
+
+	while (len > 0) {
+		switch (s->state) {
+			case CHUNK_STREAM_STATE_HEADER: {
+				/* Section header first, chunk size and length follow. */
+				uint32_t need = (s->header_len < 8) ? 8 : sizeof(s->header);
+				uint32_t n = need - s->header_len;
+				if (n > len) {
+					n = len;
+				}
+				memcpy(s->header + s->header_len, data, n);
+				s->header_len += n;
+				data += n;
+				len -= n;
+
+				if (s->header_len == 8) {
+					if (chunk_stream_be32(s->header) != s->magic) {
+						/* Not chunked, pass everything. */
+						s->state = CHUNK_STREAM_STATE_PASS;
+						if (chunk_stream_out(s, s->header, 8) != CHUNK_STREAM_OUT_OK) {
+							s->state = CHUNK_STREAM_STATE_ERROR;
+							return CHUNK_STREAM_FEED_FAILED;
+						}
+						break;
+					}
+					uint32_t section_len = chunk_stream_be32(s->header + 4);
+					if (section_len < 8 || ((section_len - 8) % CHUNK_STREAM_HASH_SIZE) != 0) {
+						s->state = CHUNK_STREAM_STATE_ERROR;
+						return CHUNK_STREAM_FEED_FAILED;
+					}
+					s->chunks = (section_len - 8) / CHUNK_STREAM_HASH_SIZE;
+					if (s->chunks == 0 || s->chunks > CHUNK_STREAM_MAX_CHUNKS) {
+						s->state = CHUNK_STREAM_STATE_ERROR;
+						return CHUNK_STREAM_FEED_FAILED;
+					}
+				}
+				if (s->header_len == sizeof(s->header)) {
+					/* The length must be covered by all chunks exactly. */
+					s->chunk_size = chunk_stream_be32(s->header + 8);
+					s->len = chunk_stream_be32(s->header + 12);
+					if (s->chunk_size == 0 || (s->chunk_size % SHA256_BLOCK_SIZE) != 0 ||
+					    s->chunk_size > UINT32_MAX / CHUNK_STREAM_MAX_CHUNKS ||
+					    s->len <= (s->chunks - 1) * s->chunk_size ||
+					    s->len - (s->chunks - 1) * s->chunk_size > s->chunk_size) {
+						s->state = CHUNK_STREAM_STATE_ERROR;
+						return CHUNK_STREAM_FEED_FAILED;
+					}
+					s->state = CHUNK_STREAM_STATE_TABLE;
+				}
+				break;
+			}
+
+			case CHUNK_STREAM_STATE_TABLE: {
+				uint32_t n = s->chunks * CHUNK_STREAM_HASH_SIZE - s->table_len;
+				if (n > len) {
+					n = len;
+				}
+				memcpy(s->table + s->table_len, data, n);
+				s->table_len += n;
+				data += n;
+				len -= n;
+
+				if (s->table_len == s->chunks * CHUNK_STREAM_HASH_SIZE) {
+					s->state = CHUNK_STREAM_STATE_DATA;
+				}
+				break;
+			}
+
+			case CHUNK_STREAM_STATE_DATA: {
+				/* The last chunk may be shorter. */
+				uint32_t end = s->len - s->chunk * s->chunk_size;
+				if (end > s->chunk_size) {
+					end = s->chunk_size;
+				}
+				uint32_t n = end - s->chunk_pos;
+				if (n > len) {
+					n = len;
+				}
+				if (chunk_stream_out(s, data, n) != CHUNK_STREAM_OUT_OK) {
+					s->state = CHUNK_STREAM_STATE_ERROR;
+					return CHUNK_STREAM_FEED_FAILED;
+				}
+				chunk_stream_hash(s, data, n);
+				data += n;
+				len -= n;
+
+				if (s->chunk_pos == end) {
+					if (chunk_stream_check_chunk(s) != CHUNK_STREAM_CHECK_CHUNK_OK) {
+						s->state = CHUNK_STREAM_STATE_ERROR;
+						return CHUNK_STREAM_FEED_BAD_CHUNK;
+					}
+					if (s->chunk == s->chunks) {
+						s->state = CHUNK_STREAM_STATE_DONE;
+					}
+				}
+				break;
+			}
+
+			case CHUNK_STREAM_STATE_DONE:
+				len = 0;
+				break;
+
+			case CHUNK_STREAM_STATE_PASS:
+				if (chunk_stream_out(s, data, len) != CHUNK_STREAM_OUT_OK) {
+					s->state = CHUNK_STREAM_STATE_ERROR;
+					return CHUNK_STREAM_FEED_FAILED;
+				}
+				len = 0;
+				break;
+
+			default:
+				return CHUNK_STREAM_FEED_FAILED;
+		}
+	}
+
+	return CHUNK_STREAM_FEED_OK;
+}
+
+
+int32_t chunk_stream_finish(struct chunk_stream *s) {
+	if (u_assert(s != NULL)) {
+		return CHUNK_STREAM_FINISH_FAILED;
+	}
+
+	switch (s->state) {
+		case CHUNK_STREAM_STATE_HEADER:
+			/* Too short to contain a section header, not chunked. */
+			if (s->header_len >= 8) {
+				return CHUNK_STREAM_FINISH_FAILED;
+			}
+			if (s->header_len > 0 &&
+			    chunk_stream_out(s, s->header, s->header_len) != CHUNK_STREAM_OUT_OK) {
+				return CHUNK_STREAM_FINISH_FAILED;
+			}
+			return CHUNK_STREAM_FINISH_OK;
+
+		case CHUNK_STREAM_STATE_PASS:
+		case CHUNK_STREAM_STATE_DONE:
+			return CHUNK_STREAM_FINISH_OK;
+
+		default:
+			return CHUNK_STREAM_FINISH_FAILED;
+	}
+}
@@ -0,0 +1,138 @@
+/**
+ * uBLoad chunked image stream checker
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHUNK_STREAM_H_
+#define _CHUNK_STREAM_H_
+
+#include <stdint.h>
+
+#include "sha256.h"
+
+/**
+ * Chunked streams start with a section (8 byte header with the magic and
+ * length) containing the chunk size (a multiple of the SHA256 block size)
+ * and the length of the data covered by chunks (both 32bit big endian)
+ * followed by SHA256 hashes of all chunks. Chunks cover the stream after
+ * this section, the last one may be shorter. Anything after the last chunk
+ * (eg. XMODEM padding) is dropped.
+ */
+#define CHUNK_STREAM_HASH_SIZE SHA256_HASH_SIZE
+#define CHUNK_STREAM_MAX_CHUNKS 64
+
+enum chunk_stream_state {
+	CHUNK_STREAM_STATE_HEADER,
+	CHUNK_STREAM_STATE_TABLE,
+	CHUNK_STREAM_STATE_DATA,
+	CHUNK_STREAM_STATE_DONE,
+	CHUNK_STREAM_STATE_PASS,
+	CHUNK_STREAM_STATE_ERROR,
+};
+
+/**
+ * Checker of a chunked stream. Data can be fed in chunks of arbitrary
+ * length, they are passed to the output callback without the chunk table
+ * section. Each chunk is checked as soon as it is complete. Streams which
+ * don't start with the chunk table section are passed unchecked.
+ */
+struct chunk_stream {
+	enum chunk_stream_state state;
+	uint32_t magic;
+
+	/* Section header, chunk size and data length are collected here. */
+	uint8_t header[16];
+	uint32_t header_len;
+
+	uint32_t chunk_size;
+	uint32_t len;
+	uint32_t chunks;
+	uint8_t table[CHUNK_STREAM_MAX_CHUNKS * CHUNK_STREAM_HASH_SIZE];
+	uint32_t table_len;
+
+	/* Index of the current chunk and number of its bytes received. */
+	uint32_t chunk;
+	uint32_t chunk_pos;
+	struct sha256_state hash;
+	uint8_t block[SHA256_BLOCK_SIZE];
+
+	/**
+	 * Total number of bytes passed to the output callback.
+	 */
+	uint32_t total;
+
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx);
+	void *output_ctx;
+};
+#define CHUNK_STREAM_OUTPUT_OK 0
+#define CHUNK_STREAM_OUTPUT_FAILED -1
+
+/**
+ * @brief Initialize the checker.
+ *
+ * @param s Checker context.
+ * @param magic Magic number of the chunk table section.
+ * @param output Callback receiving the data. Checking fails if it returns
+ *               anything other than CHUNK_STREAM_OUTPUT_OK.
+ * @param output_ctx Context passed to the @a output callback.
+ *
+ * @return CHUNK_STREAM_INIT_OK if the checker was initialized or
+ *         CHUNK_STREAM_INIT_FAILED otherwise.
+ */
+int32_t chunk_stream_init(
+	struct chunk_stream *s,
+	uint32_t magic,
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx),
+	void *output_ctx
+);
+#define CHUNK_STREAM_INIT_OK 0
+#define CHUNK_STREAM_INIT_FAILED -1
+
+/**
+ * @brief Feed a part of the stream.
+ *
+ * @param s Checker context.
+ * @param data Buffer with stream data.
+ * @param len Length of the @a data buffer.
+ *
+ * @return CHUNK_STREAM_FEED_OK if the data was processed,
+ *         CHUNK_STREAM_FEED_BAD_CHUNK if a chunk doesn't match its hash or
+ *         CHUNK_STREAM_FEED_FAILED if the chunk table is malformed or the
+ *         output callback failed.
+ */
+int32_t chunk_stream_feed(struct chunk_stream *s, const uint8_t *data, uint32_t len);
+#define CHUNK_STREAM_FEED_OK 0
+#define CHUNK_STREAM_FEED_FAILED -1
+#define CHUNK_STREAM_FEED_BAD_CHUNK -2
+
+/**
+ * @brief Finish the checking.
+ *
+ * @param s Checker context.
+ *
+ * @return CHUNK_STREAM_FINISH_OK if all chunks were received and checked
+ *         (or the stream is not chunked) or CHUNK_STREAM_FINISH_FAILED
+ *         otherwise.
+ */
+int32_t chunk_stream_finish(struct chunk_stream *s);
+#define CHUNK_STREAM_FINISH_OK 0
+#define CHUNK_STREAM_FINISH_FAILED -1
+
+
+#endif
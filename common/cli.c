@@ -386,7 +386,7 @@ int32_t cli_execute(struct cli *c, uint32_t argc, char *argv[]) {
 			cli_cmd_verify_flash(c);
 		}
 		if (argc == 2) {
-			cli_print(c, "Verification of a saved firmware image is not supported yet.\r\n");
+			cli_cmd_verify_file(c, argv[1]);
 		}
 		return CLI_EXECUTE_OK;
 	}
@@ -396,7 +396,7 @@ int32_t cli_execute(struct cli *c, uint32_t argc, char *argv[]) {
 			cli_cmd_authenticate_flash(c);
 		}
 		if (argc == 2) {
-			cli_print(c, "Authentication of a saved firmware image is not supported yet.\r\n");
+			cli_cmd_authenticate_file(c, argv[1]);
 		}
 		return CLI_EXECUTE_OK;
 	}
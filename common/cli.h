@@ -30,7 +30,7 @@
 #define CLI_MAX_ARGC 5
 
 /* TODO: meh */
-extern struct fw_image main_fw;
+extern struct fw_image *main_fw;
 extern struct sffs flash_fs;
 extern struct flash_dev flash1;
 
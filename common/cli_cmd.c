@@ -33,9 +33,12 @@
 #include "cli_cmd.h"
 
 #include "fw_image.h"
+#include "chunk_stream.h"
 #include "xmodem.h"
 #include "sffs.h"
 #include "pubkey_storage.h"
+#include "verify_cache.h"
+#include "fw_catalogue.h"
 
 
 int32_t cli_print_help_command(struct cli *c, char *cmd, char *help) {
@@ -193,7 +196,10 @@ int32_t cli_cmd_pubkey_lock(struct cli *c, uint32_t slot_num) {
 
 static int32_t cli_xmodem_recv_to_flash_cb(uint8_t *data, uint32_t len, uint32_t offset, void *ctx) {
 	struct fw_image *fw = (struct fw_image *)ctx;
-	fw_image_program(fw, offset, data, len);
+	(void)offset;
+	if (fw_image_program_stream(fw, data, len) != FW_IMAGE_PROGRAM_STREAM_OK) {
+		return XMODEM_RECV_CB_TERMINATE;
+	}
 
 	return XMODEM_RECV_CB_OK;
 }
@@ -208,8 +214,10 @@ int32_t cli_cmd_program_xmodem(struct cli *c) {
 
 	struct xmodem x;
 	xmodem_init(&x, c->console);
-	xmodem_set_recv_callback(&x, cli_xmodem_recv_to_flash_cb, (void *)&main_fw);
+	xmodem_set_recv_callback(&x, cli_xmodem_recv_to_flash_cb, (void *)main_fw);
+	fw_image_program_begin(main_fw, &flash_fs);
 	int32_t res = xmodem_recv(&x);
+	int32_t program_res = fw_image_program_end(main_fw);
 
 	if (res == XMODEM_RECV_EOT) {
 		/* Clear the terminal after xmodem transfer. */
@@ -217,6 +225,12 @@ int32_t cli_cmd_program_xmodem(struct cli *c) {
 		char s[40];
 		snprintf(s, sizeof(s), "%u bytes programmed.\r\n", (unsigned int)(x.bytes_transferred));
 		cli_print(c, s);
+		if (program_res == FW_IMAGE_PROGRAM_END_OK) {
+			cli_print(c, "Firmware verified.\r\n");
+		}
+		if (program_res == FW_IMAGE_PROGRAM_END_FAILED) {
+			cli_print(c, "Firmware programming or verification failed.\r\n");
+		}
 	}
 	if (res == XMODEM_RECV_CANCEL) {
 		cli_print(c, "XMODEM transfer cancelled.\r\n");
@@ -230,9 +244,26 @@ int32_t cli_cmd_program_xmodem(struct cli *c) {
 }
 
 
+/* Chunked firmware images are checked while they are being downloaded. */
+static struct chunk_stream cli_download_chunks;
+
+static int32_t cli_download_chunks_output(const uint8_t *data, uint32_t len, void *ctx) {
+	(void)data;
+	(void)len;
+	(void)ctx;
+
+	return CHUNK_STREAM_OUTPUT_OK;
+}
+
+
 static int32_t cli_xmodem_recv_to_file_cb(uint8_t *data, uint32_t len, uint32_t offset, void *ctx) {
 	(void)offset;
 
+	/* Stop the transfer at the first corrupted chunk. */
+	if (chunk_stream_feed(&cli_download_chunks, data, len) != CHUNK_STREAM_FEED_OK) {
+		return XMODEM_RECV_CB_TERMINATE;
+	}
+
 	struct sffs_file *f = (struct sffs_file *)ctx;
 	/* We are ignoring the offset. */
 	sffs_write(f, data, len);
@@ -251,8 +282,8 @@ int32_t cli_cmd_program_file(struct cli *c, char *file) {
 	char s[80];
 	snprintf(s, sizeof(s), "Flashing firmware %s\r\n", file);
 	cli_print(c, s);
-	fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)c);
-	fw_image_program_file(&main_fw, &flash_fs, file);
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	fw_image_program_file(main_fw, &flash_fs, file);
 
 	return CLI_CMD_PROGRAM_FILE_OK;
 }
@@ -265,6 +296,7 @@ int32_t cli_cmd_fs_download(struct cli *c, char *file) {
 	}
 
 
+	fw_catalogue_invalidate(&flash_fs, file);
 	struct sffs_file f;
 	if (sffs_open(&flash_fs, &f, file, SFFS_OVERWRITE) != SFFS_OPEN_OK) {
 		cli_print(c, "Cannot create file.\r\n");
@@ -276,14 +308,22 @@ int32_t cli_cmd_fs_download(struct cli *c, char *file) {
 	struct xmodem x;
 	xmodem_init(&x, c->console);
 	xmodem_set_recv_callback(&x, cli_xmodem_recv_to_file_cb, (void *)&f);
+	chunk_stream_init(&cli_download_chunks, FW_IMAGE_SECTION_MAGIC_CHUNKS, cli_download_chunks_output, NULL);
 	int32_t res = xmodem_recv(&x);
 
+	bool remove = false;
 	if (res == XMODEM_RECV_EOT) {
 		/* Clear the terminal after xmodem transfer. */
 		cli_print(c, "                   \r\n");
 		char s[40];
 		snprintf(s, sizeof(s), "%u bytes downloaded.\r\n", (unsigned int)(x.bytes_transferred));
 		cli_print(c, s);
+
+		if (chunk_stream_finish(&cli_download_chunks) != CHUNK_STREAM_FINISH_OK) {
+			snprintf(s, sizeof(s), "Chunk %u corrupted or missing.\r\n", (unsigned int)cli_download_chunks.chunk);
+			cli_print(c, s);
+			remove = true;
+		}
 	}
 	if (res == XMODEM_RECV_CANCEL) {
 		cli_print(c, "XMODEM transfer cancelled.\r\n");
@@ -294,6 +334,11 @@ int32_t cli_cmd_fs_download(struct cli *c, char *file) {
 	xmodem_free(&x);
 	sffs_close(&f);
 
+	if (remove) {
+		sffs_file_remove(&flash_fs, file);
+		cli_print(c, "File removed.\r\n");
+	}
+
 	return CLI_CMD_FS_DOWNLOAD_OK;
 }
 
@@ -312,6 +357,7 @@ int32_t cli_cmd_fs_delete(struct cli *c, char *file) {
 	}
 
 	if (sffs_file_remove(&flash_fs, file) == SFFS_FILE_REMOVE_OK) {
+		fw_catalogue_invalidate(&flash_fs, file);
 		cli_print(c, "File deleted successfully.\r\n");
 		return CLI_CMD_FS_DELETE_OK;
 	} else {
@@ -327,8 +373,8 @@ int32_t cli_cmd_erase(struct cli *c) {
 		return CLI_CMD_ERASE_FAILED;
 	}
 
-	fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)c);
-	fw_image_erase(&main_fw);
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	fw_image_erase(main_fw);
 	cli_print(c, "\r\n");
 
 	return CLI_CMD_ERASE_OK;
@@ -401,15 +447,15 @@ int32_t cli_cmd_dump_file(struct cli *c, const char *file) {
 
 	/* TODO: move to fw_image_get_size */
 	uint32_t size = 0;
-	if (fw_image_get_size(&main_fw, &size) != FW_IMAGE_GET_SIZE_OK) {
+	if (fw_image_get_size(main_fw, &size) != FW_IMAGE_GET_SIZE_OK) {
 		return CLI_CMD_DUMP_FILE_FAILED;
 	}
 	char s[80];
 	snprintf(s, sizeof(s), "Dumping firmware to file %s, size %u bytes\r\n", file, (unsigned int)(size));
 	cli_print(c, s);
 
-	fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)c);
-	fw_image_dump_file(&main_fw, &flash_fs, file);
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	fw_image_dump_file(main_fw, &flash_fs, file);
 
 	return CLI_CMD_DUMP_FILE_OK;
 }
@@ -420,8 +466,11 @@ int32_t cli_cmd_verify_flash(struct cli *c) {
 		return CLI_CMD_VERIFY_FLASH_FAILED;
 	}
 
-	fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)c);
-	fw_image_verify(&main_fw);
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	if (fw_image_verify(main_fw) != FW_IMAGE_VERIFY_OK) {
+		/* Do not trust any previous verification result. */
+		verify_cache_invalidate();
+	}
 
 	return CLI_CMD_VERIFY_FLASH_OK;
 }
@@ -432,13 +481,41 @@ int32_t cli_cmd_authenticate_flash(struct cli *c) {
 		return CLI_CMD_AUTHENTICATE_FLASH_FAILED;
 	}
 
-	fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)c);
-	fw_image_authenticate(&main_fw);
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	fw_image_authenticate(main_fw);
 
 	return CLI_CMD_AUTHENTICATE_FLASH_OK;
 }
 
 
+int32_t cli_cmd_verify_file(struct cli *c, const char *file) {
+	if (u_assert(c != NULL && file != NULL)) {
+		return CLI_CMD_VERIFY_FILE_FAILED;
+	}
+
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	if (fw_image_verify_file(main_fw, &flash_fs, file) != FW_IMAGE_VERIFY_FILE_OK) {
+		return CLI_CMD_VERIFY_FILE_FAILED;
+	}
+
+	return CLI_CMD_VERIFY_FILE_OK;
+}
+
+
+int32_t cli_cmd_authenticate_file(struct cli *c, const char *file) {
+	if (u_assert(c != NULL && file != NULL)) {
+		return CLI_CMD_AUTHENTICATE_FILE_FAILED;
+	}
+
+	fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)c);
+	if (fw_image_authenticate_file(main_fw, &flash_fs, file) != FW_IMAGE_AUTHENTICATE_FILE_OK) {
+		return CLI_CMD_AUTHENTICATE_FILE_FAILED;
+	}
+
+	return CLI_CMD_AUTHENTICATE_FILE_OK;
+}
+
+
 int32_t cli_cmd_log_print(struct cli *c) {
 	if (u_assert(c != NULL)) {
 		return CLI_CMD_LOG_PRINT_FAILED;
@@ -485,7 +562,7 @@ int32_t cli_cmd_config_print_key(struct cli *c, const char *key) {
 		return CLI_CMD_CONFIG_PRINT_KEY_FAILED;
 	}
 
-	char s[50] = {0};
+	char s[CONFIG_FIRMWARE_FALLBACK_LEN + 4] = {0};
 
 	if (!strcmp(key, "host")) {
 		snprintf(s, sizeof(s), "'%s'", running_config.host);
@@ -496,6 +573,18 @@ int32_t cli_cmd_config_print_key(struct cli *c, const char *key) {
 	if (!strcmp(key, "fw-request")) {
 		snprintf(s, sizeof(s), "'%s'", running_config.fw_request);
 	}
+	if (!strcmp(key, "verify-cache")) {
+		snprintf(s, sizeof(s), "%u", (unsigned int)running_config.verify_cache);
+	}
+	if (!strcmp(key, "fw-update-diff")) {
+		snprintf(s, sizeof(s), "%u", (unsigned int)running_config.fw_update_diff);
+	}
+	if (!strcmp(key, "fw-slot")) {
+		snprintf(s, sizeof(s), "%u", (unsigned int)running_config.fw_slot);
+	}
+	if (!strcmp(key, "fw-fallback")) {
+		snprintf(s, sizeof(s), "'%s'", running_config.fw_fallback);
+	}
 
 	if (s[0] != '\0') {
 		cli_print(c, key);
@@ -520,6 +609,10 @@ int32_t cli_cmd_config_print_all(struct cli *c) {
 	cli_cmd_config_print_key(c, "host");
 	cli_cmd_config_print_key(c, "fw-working");
 	cli_cmd_config_print_key(c, "fw-request");
+	cli_cmd_config_print_key(c, "verify-cache");
+	cli_cmd_config_print_key(c, "fw-update-diff");
+	cli_cmd_config_print_key(c, "fw-slot");
+	cli_cmd_config_print_key(c, "fw-fallback");
 
 	return CLI_CMD_CONFIG_PRINT_ALL_OK;
 }
@@ -542,6 +635,22 @@ int32_t cli_cmd_config_set(struct cli *c, const char *key, const char *value) {
 		strlcpy(running_config.fw_request, value, sizeof(running_config.fw_request));
 		return CLI_CMD_CONFIG_SET_OK;
 	}
+	if (!strcmp(key, "verify-cache")) {
+		running_config.verify_cache = (strtoul(value, NULL, 10) != 0);
+		return CLI_CMD_CONFIG_SET_OK;
+	}
+	if (!strcmp(key, "fw-update-diff")) {
+		running_config.fw_update_diff = (strtoul(value, NULL, 10) != 0);
+		return CLI_CMD_CONFIG_SET_OK;
+	}
+	if (!strcmp(key, "fw-slot")) {
+		running_config.fw_slot = (strtoul(value, NULL, 10) != 0);
+		return CLI_CMD_CONFIG_SET_OK;
+	}
+	if (!strcmp(key, "fw-fallback")) {
+		strlcpy(running_config.fw_fallback, value, sizeof(running_config.fw_fallback));
+		return CLI_CMD_CONFIG_SET_OK;
+	}
 
 	return CLI_CMD_CONFIG_SET_FAILED;
 }
@@ -611,9 +720,29 @@ int32_t cli_cmd_fs_list(struct cli *c) {
 		return CLI_CMD_FS_LIST_FAILED;
 	}
 
+	/* Firmware files are described using their catalogue records. */
 	char name[50];
 	while (sffs_directory_get_item(&dir, name, sizeof(name)) == SFFS_DIRECTORY_GET_ITEM_OK) {
 		cli_print(c, name);
+
+		struct fw_catalogue_record rec;
+		if (fw_catalogue_get(&flash_fs, name, &rec) == FW_CATALOGUE_GET_OK) {
+			const char *status = "invalid";
+			if (rec.status == FW_CATALOGUE_STATUS_VERIFIED) {
+				status = "verified";
+			}
+			if (rec.status == FW_CATALOGUE_STATUS_AUTHENTICATED) {
+				status = "authenticated";
+			}
+			char s[FW_IMAGE_VERSION_LEN + 60];
+			snprintf(s, sizeof(s), " (%u bytes, %s, version %s, gen %u)",
+				(unsigned int)rec.size,
+				status,
+				(rec.version[0] != '\0') ? rec.version : "unknown",
+				(unsigned int)rec.generation
+			);
+			cli_print(c, s);
+		}
 		cli_print(c, "\r\n");
 	}
 
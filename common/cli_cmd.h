@@ -91,6 +91,14 @@ int32_t cli_cmd_authenticate_flash(struct cli *c);
 #define CLI_CMD_AUTHENTICATE_FLASH_OK 0
 #define CLI_CMD_AUTHENTICATE_FLASH_FAILED -1
 
+int32_t cli_cmd_verify_file(struct cli *c, const char *file);
+#define CLI_CMD_VERIFY_FILE_OK 0
+#define CLI_CMD_VERIFY_FILE_FAILED -1
+
+int32_t cli_cmd_authenticate_file(struct cli *c, const char *file);
+#define CLI_CMD_AUTHENTICATE_FILE_OK 0
+#define CLI_CMD_AUTHENTICATE_FILE_FAILED -1
+
 int32_t cli_cmd_log_print(struct cli *c);
 #define CLI_CMD_LOG_PRINT_OK 0
 #define CLI_CMD_LOG_PRINT_FAILED -1
@@ -39,5 +39,9 @@ const struct ubload_config default_config = {
 	.xmodem_timeout = 1000,
 	.fw_working = "",
 	.fw_request = "",
+	.verify_cache = true,
+	.fw_update_diff = true,
+	.fw_slot = 0,
+	.fw_fallback = "",
 };
 
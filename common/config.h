@@ -26,6 +26,7 @@
 #include <stdbool.h>
 
 #define CONFIG_FIRMWARE_ID_LEN 32
+#define CONFIG_FIRMWARE_FALLBACK_LEN 64
 
 /**
  * This file contains all configuration variables which are supported by uBLoad.
@@ -93,6 +94,20 @@ struct ubload_config {
 
 	char fw_working[CONFIG_FIRMWARE_ID_LEN];
 	char fw_request[CONFIG_FIRMWARE_ID_LEN];
+
+	/* Skip the firmware signature check if the image was authenticated
+	 * before. Image integrity is still checked on every boot. */
+	bool verify_cache;
+
+	/* Program only the sectors changed by the firmware update. */
+	bool fw_update_diff;
+
+	/* Firmware slot to boot (the newest one) if the port has two slots. */
+	uint32_t fw_slot;
+
+	/* Ordered list of fallback firmware files separated by commas. They
+	 * are tried after the last working firmware, before the backup. */
+	char fw_fallback[CONFIG_FIRMWARE_FALLBACK_LEN];
 };
 
 
@@ -0,0 +1,109 @@
+/**
+ * uBLoad CRC32 computation
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u_assert.h"
+#include "config_port.h"
+#include "crc32.h"
+
+#if PORT_CRC == true
+	#include <libopencm3/stm32/crc.h>
+#endif
+
+
+/* Reads one little endian word, the tail is padded with zeroes. */
+static uint32_t crc32_get_word(const uint8_t *data, uint32_t len) {
+	uint32_t w = 0;
+	for (uint32_t i = 0; i < 4 && i < len; i++) {
+		w |= (uint32_t)data[i] << (i * 8);
+	}
+	return w;
+}
+
+
+#if PORT_CRC == true
+
+int32_t crc32_compute(const uint8_t *data, uint32_t len, uint32_t *crc) {
+	if (u_assert(data != NULL) ||
+	    u_assert(crc != NULL)) {
+		return CRC32_COMPUTE_FAILED;
+	}
+
+	crc_reset();
+	uint32_t c = 0xffffffff;
+
+	/* Aligned data (flash contents) are fed to the CRC unit directly. */
+	uint32_t words = len / 4;
+	if (((uintptr_t)data & 3) == 0 && words > 0) {
+		c = crc_calculate_block((uint32_t *)(uintptr_t)data, words);
+		data += words * 4;
+		len -= words * 4;
+	}
+	while (len > 0) {
+		c = crc_calculate(crc32_get_word(data, len));
+		if (len < 4) {
+			break;
+		}
+		data += 4;
+		len -= 4;
+	}
+
+	*crc = c;
+	return CRC32_COMPUTE_OK;
+}
+
+#else
+
+/* CRC32 table for one nibble. */
+static const uint32_t crc32_table[16] = {
+	0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9,
+	0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005,
+	0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61,
+	0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd,
+};
+
+int32_t crc32_compute(const uint8_t *data, uint32_t len, uint32_t *crc) {
+	if (u_assert(data != NULL) ||
+	    u_assert(crc != NULL)) {
+		return CRC32_COMPUTE_FAILED;
+	}
+
+	uint32_t c = 0xffffffff;
+	while (len > 0) {
+		c ^= crc32_get_word(data, len);
+		for (uint32_t i = 0; i < 8; i++) {
+			c = (c << 4) ^ crc32_table[c >> 28];
+		}
+		if (len < 4) {
+			break;
+		}
+		data += 4;
+		len -= 4;
+	}
+
+	*crc = c;
+	return CRC32_COMPUTE_OK;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * uBLoad CRC32 computation
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Compute CRC32 of a buffer the same way as the STM32 CRC unit does.
+ *
+ * The buffer is processed as a sequence of little endian 32bit words, each
+ * word is shifted in MSB first (polynomial 0x04c11db7, initial value
+ * 0xffffffff, no final xor). If the length is not a multiple of 4, the last
+ * word is padded with zeroes. The hardware CRC unit is used if the port
+ * has one (PORT_CRC), table driven software implementation otherwise.
+ *
+ * @param data Buffer with data.
+ * @param len Length of the @a data buffer.
+ * @param crc Computed CRC is returned here.
+ *
+ * @return CRC32_COMPUTE_OK if the CRC was computed or
+ *         CRC32_COMPUTE_FAILED otherwise.
+ */
+int32_t crc32_compute(const uint8_t *data, uint32_t len, uint32_t *crc);
+#define CRC32_COMPUTE_OK 0
+#define CRC32_COMPUTE_FAILED -1
+
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * uBLoad streaming delta (binary patch) decoder
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "u_assert.h"
+#include "sha512.h"
+#include "delta_stream.h"
+
+
+static uint32_t delta_stream_be32(const uint8_t *b) {
+	return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | (uint32_t)b[3];
+}
+
+
+/* Hash the whole base image and compare it with the hash from the header. */
+#define DELTA_STREAM_CHECK_BASE_OK 0
+#define DELTA_STREAM_CHECK_BASE_FAILED -1
+static int32_t delta_stream_check_base(struct delta_stream *s) {
+	struct sha512_state state;
+	uint8_t buf[DELTA_STREAM_BASE_BUFFER_SIZE];
+
+	s->base_len = delta_stream_be32(s->args);
+
+	sha512_init(&state);
+	uint32_t offset = 0;
+	while ((s->base_len - offset) >= SHA512_BLOCK_SIZE) {
+		if (s->base_read(offset, buf, SHA512_BLOCK_SIZE, s->base_ctx) != DELTA_STREAM_BASE_READ_OK) {
+			return DELTA_STREAM_CHECK_BASE_FAILED;
+		}
+		sha512_block(&state, buf);
+		offset += SHA512_BLOCK_SIZE;
+	}
+	if (offset < s->base_len &&
+	    s->base_read(offset, buf, s->base_len - offset, s->base_ctx) != DELTA_STREAM_BASE_READ_OK) {
+		return DELTA_STREAM_CHECK_BASE_FAILED;
+	}
+	sha512_final(&state, buf, s->base_len);
+
+	uint8_t hash[SHA512_HASH_SIZE];
+	sha512_get(&state, hash, 0, sizeof(hash));
+	if (memcmp(hash, s->args + 4, SHA512_HASH_SIZE)) {
+		return DELTA_STREAM_CHECK_BASE_FAILED;
+	}
+
+	return DELTA_STREAM_CHECK_BASE_OK;
+}
+
+
+#define DELTA_STREAM_COPY_OK 0
+#define DELTA_STREAM_COPY_FAILED -1
+static int32_t delta_stream_copy(struct delta_stream *s, uint32_t offset, uint32_t len) {
+	uint8_t buf[DELTA_STREAM_BASE_BUFFER_SIZE];
+
+	if (offset > s->base_len || len > s->base_len - offset) {
+		return DELTA_STREAM_COPY_FAILED;
+	}
+
+	while (len > 0) {
+		uint32_t n = (len > sizeof(buf)) ? sizeof(buf) : len;
+		if (s->base_read(offset, buf, n, s->base_ctx) != DELTA_STREAM_BASE_READ_OK ||
+		    s->output(buf, n, s->output_ctx) != DELTA_STREAM_OUTPUT_OK) {
+			return DELTA_STREAM_COPY_FAILED;
+		}
+		s->total += n;
+		offset += n;
+		len -= n;
+	}
+
+	return DELTA_STREAM_COPY_OK;
+}
+
+
+int32_t delta_stream_init(
+	struct delta_stream *s,
+	int32_t (*base_read)(uint32_t offset, uint8_t *data, uint32_t len, void *ctx),
+	void *base_ctx,
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx),
+	void *output_ctx
+) {
+	if (u_assert(s != NULL) ||
+	    u_assert(base_read != NULL) ||
+	    u_assert(output != NULL)) {
+		return DELTA_STREAM_INIT_FAILED;
+	}
+
+	s->state = DELTA_STREAM_STATE_HEADER;
+	s->args_len = 0;
+	s->op = 0;
+	s->base_len = 0;
+	s->insert_len = 0;
+	s->total = 0;
+	s->base_read = base_read;
+	s->base_ctx = base_ctx;
+	s->output = output;
+	s->output_ctx = output_ctx;
+
+	return DELTA_STREAM_INIT_OK;
+}
+
+
+int32_t delta_stream_feed(struct delta_stream *s, const uint8_t *data, uint32_t len) {
+	if (u_assert(s != NULL) ||
+	    u_assert(data != NULL)) {
+		return DELTA_STREAM_FEED_FAILED;
+	}
+
+	while (len > 0) {
+		switch (s->state) {
+			case DELTA_STREAM_STATE_HEADER: {
+				uint32_t n = DELTA_STREAM_HEADER_SIZE - s->args_len;
+				if (n > len) {
+					n = len;
+				}
+				memcpy(s->args + s->args_len, data, n);
+				s->args_len += n;
+				data += n;
+				len -= n;
+
+				if (s->args_len == DELTA_STREAM_HEADER_SIZE) {
+					if (delta_stream_check_base(s) != DELTA_STREAM_CHECK_BASE_OK) {
+						s->state = DELTA_STREAM_STATE_ERROR;
+						return DELTA_STREAM_FEED_FAILED;
+					}
+					s->state = DELTA_STREAM_STATE_OP;
+				}
+				break;
+			}
+
+			case DELTA_STREAM_STATE_OP:
+				s->op = *data;
+				if (s->op != DELTA_STREAM_OP_COPY && s->op != DELTA_STREAM_OP_INSERT) {
+					s->state = DELTA_STREAM_STATE_ERROR;
+					return DELTA_STREAM_FEED_FAILED;
+				}
+				s->args_len = 0;
+				s->state = DELTA_STREAM_STATE_ARGS;
+				data++;
+				len--;
+				break;
+
+			case DELTA_STREAM_STATE_ARGS: {
+				uint32_t args_size = (s->op == DELTA_STREAM_OP_COPY) ? 8 : 4;
+				uint32_t n = args_size - s->args_len;
+				if (n > len) {
+					n = len;
+				}
+				memcpy(s->args + s->args_len, data, n);
+				s->args_len += n;
+				data += n;
+				len -= n;
+
+				if (s->args_len < args_size) {
+					break;
+				}
+				if (s->op == DELTA_STREAM_OP_COPY) {
+					if (delta_stream_copy(s, delta_stream_be32(s->args), delta_stream_be32(s->args + 4)) != DELTA_STREAM_COPY_OK) {
+						s->state = DELTA_STREAM_STATE_ERROR;
+						return DELTA_STREAM_FEED_FAILED;
+					}
+					s->state = DELTA_STREAM_STATE_OP;
+				} else {
+					s->insert_len = delta_stream_be32(s->args);
+					s->state = (s->insert_len > 0) ? DELTA_STREAM_STATE_INSERT : DELTA_STREAM_STATE_OP;
+				}
+				break;
+			}
+
+			case DELTA_STREAM_STATE_INSERT: {
+				/* Inserted data are passed to the output directly. */
+				uint32_t n = s->insert_len;
+				if (n > len) {
+					n = len;
+				}
+				if (s->output(data, n, s->output_ctx) != DELTA_STREAM_OUTPUT_OK) {
+					s->state = DELTA_STREAM_STATE_ERROR;
+					return DELTA_STREAM_FEED_FAILED;
+				}
+				s->total += n;
+				s->insert_len -= n;
+				data += n;
+				len -= n;
+
+				if (s->insert_len == 0) {
+					s->state = DELTA_STREAM_STATE_OP;
+				}
+				break;
+			}
+
+			default:
+				return DELTA_STREAM_FEED_FAILED;
+		}
+	}
+
+	return DELTA_STREAM_FEED_OK;
+}
+
+
+int32_t delta_stream_finish(struct delta_stream *s) {
+	if (u_assert(s != NULL)) {
+		return DELTA_STREAM_FINISH_FAILED;
+	}
+
+	/* The delta must end between two operations. */
+	if (s->state != DELTA_STREAM_STATE_OP) {
+		return DELTA_STREAM_FINISH_FAILED;
+	}
+
+	return DELTA_STREAM_FINISH_OK;
+}
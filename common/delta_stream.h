@@ -0,0 +1,140 @@
+/**
+ * uBLoad streaming delta (binary patch) decoder
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DELTA_STREAM_H_
+#define _DELTA_STREAM_H_
+
+#include <stdint.h>
+
+#include "sha512.h"
+
+/**
+ * Delta starts with a header containing the length of the base image
+ * (32bit big endian) and its SHA512 hash. A sequence of operations follows,
+ * each of them starts with an opcode byte:
+ *   - COPY, 32bit offset and 32bit length (big endian). Data are copied
+ *     from the base image.
+ *   - INSERT, 32bit length (big endian) followed by the inserted data.
+ */
+#define DELTA_STREAM_HEADER_SIZE (4 + SHA512_HASH_SIZE)
+#define DELTA_STREAM_OP_COPY 0x01
+#define DELTA_STREAM_OP_INSERT 0x02
+
+/**
+ * Base image is read using this buffer (on the stack), it is also the
+ * maximum length of a single read callback request.
+ */
+#define DELTA_STREAM_BASE_BUFFER_SIZE SHA512_BLOCK_SIZE
+
+enum delta_stream_state {
+	DELTA_STREAM_STATE_HEADER,
+	DELTA_STREAM_STATE_OP,
+	DELTA_STREAM_STATE_ARGS,
+	DELTA_STREAM_STATE_INSERT,
+	DELTA_STREAM_STATE_ERROR,
+};
+
+/**
+ * Decoder of a delta applied to a base image which is read using a callback.
+ * Delta can be fed in chunks of arbitrary length, the resulting data are
+ * passed to the output callback. The base image hash is checked before the
+ * first operation is processed.
+ */
+struct delta_stream {
+	enum delta_stream_state state;
+
+	/* Header and operation arguments are collected here. */
+	uint8_t args[DELTA_STREAM_HEADER_SIZE];
+	uint32_t args_len;
+	uint8_t op;
+
+	uint32_t base_len;
+	uint32_t insert_len;
+
+	/**
+	 * Total number of bytes passed to the output callback.
+	 */
+	uint32_t total;
+
+	int32_t (*base_read)(uint32_t offset, uint8_t *data, uint32_t len, void *ctx);
+	void *base_ctx;
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx);
+	void *output_ctx;
+};
+#define DELTA_STREAM_BASE_READ_OK 0
+#define DELTA_STREAM_BASE_READ_FAILED -1
+#define DELTA_STREAM_OUTPUT_OK 0
+#define DELTA_STREAM_OUTPUT_FAILED -1
+
+/**
+ * @brief Initialize the decoder.
+ *
+ * @param s Decoder context.
+ * @param base_read Callback reading @a len bytes of the base image at
+ *                  @a offset. It must return DELTA_STREAM_BASE_READ_OK if
+ *                  the whole buffer was read.
+ * @param base_ctx Context passed to the @a base_read callback.
+ * @param output Callback receiving the resulting data. Decoding fails if it
+ *               returns anything other than DELTA_STREAM_OUTPUT_OK.
+ * @param output_ctx Context passed to the @a output callback.
+ *
+ * @return DELTA_STREAM_INIT_OK if the decoder was initialized or
+ *         DELTA_STREAM_INIT_FAILED otherwise.
+ */
+int32_t delta_stream_init(
+	struct delta_stream *s,
+	int32_t (*base_read)(uint32_t offset, uint8_t *data, uint32_t len, void *ctx),
+	void *base_ctx,
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx),
+	void *output_ctx
+);
+#define DELTA_STREAM_INIT_OK 0
+#define DELTA_STREAM_INIT_FAILED -1
+
+/**
+ * @brief Feed a chunk of the delta.
+ *
+ * @param s Decoder context.
+ * @param data Buffer with delta data.
+ * @param len Length of the @a data buffer.
+ *
+ * @return DELTA_STREAM_FEED_OK if the chunk was processed or
+ *         DELTA_STREAM_FEED_FAILED if the delta is malformed, it doesn't
+ *         match the base image or any of the callbacks failed.
+ */
+int32_t delta_stream_feed(struct delta_stream *s, const uint8_t *data, uint32_t len);
+#define DELTA_STREAM_FEED_OK 0
+#define DELTA_STREAM_FEED_FAILED -1
+
+/**
+ * @brief Finish the decoding.
+ *
+ * @param s Decoder context.
+ *
+ * @return DELTA_STREAM_FINISH_OK if the delta ended properly (after the
+ *         last operation) or DELTA_STREAM_FINISH_FAILED otherwise.
+ */
+int32_t delta_stream_finish(struct delta_stream *s);
+#define DELTA_STREAM_FINISH_OK 0
+#define DELTA_STREAM_FINISH_FAILED -1
+
+
+#endif
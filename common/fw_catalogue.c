@@ -0,0 +1,225 @@
+/**
+ * uBLoad firmware file catalogue
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u_assert.h"
+#include "u_log.h"
+#include "sffs.h"
+#include "fw_image.h"
+#include "fw_catalogue.h"
+
+
+/**
+ * The whole catalogue is small enough to be loaded at once. It is kept in
+ * a static buffer, it is too big for the stack.
+ */
+struct fw_catalogue {
+	uint32_t magic;
+	uint32_t generation;
+	struct fw_catalogue_record records[FW_CATALOGUE_RECORDS];
+};
+
+static struct fw_catalogue fw_catalogue;
+
+
+#define FW_CATALOGUE_LOAD_OK 0
+#define FW_CATALOGUE_LOAD_FAILED -1
+static int32_t fw_catalogue_load(struct sffs *fs) {
+	struct sffs_file f;
+	if (sffs_open(fs, &f, FW_CATALOGUE_FILE, SFFS_READ) == SFFS_OPEN_OK) {
+		int32_t len = sffs_read(&f, (uint8_t *)&fw_catalogue, sizeof(fw_catalogue));
+		sffs_close(&f);
+
+		if (len == sizeof(fw_catalogue) && fw_catalogue.magic == FW_CATALOGUE_MAGIC) {
+			return FW_CATALOGUE_LOAD_OK;
+		}
+	}
+
+	/* Start with an empty catalogue. */
+	memset(&fw_catalogue, 0, sizeof(fw_catalogue));
+	return FW_CATALOGUE_LOAD_FAILED;
+}
+
+
+#define FW_CATALOGUE_SAVE_OK 0
+#define FW_CATALOGUE_SAVE_FAILED -1
+static int32_t fw_catalogue_save(struct sffs *fs) {
+	fw_catalogue.magic = FW_CATALOGUE_MAGIC;
+
+	struct sffs_file f;
+	if (sffs_open(fs, &f, FW_CATALOGUE_FILE, SFFS_OVERWRITE) != SFFS_OPEN_OK) {
+		return FW_CATALOGUE_SAVE_FAILED;
+	}
+	if (sffs_write(&f, (uint8_t *)&fw_catalogue, sizeof(fw_catalogue)) != sizeof(fw_catalogue)) {
+		sffs_close(&f);
+		return FW_CATALOGUE_SAVE_FAILED;
+	}
+	sffs_close(&f);
+
+	return FW_CATALOGUE_SAVE_OK;
+}
+
+
+static struct fw_catalogue_record *fw_catalogue_find(const char *fname) {
+	for (uint32_t i = 0; i < FW_CATALOGUE_RECORDS; i++) {
+		if (fw_catalogue.records[i].name[0] != '\0' &&
+		    !strncmp(fw_catalogue.records[i].name, fname, SFFS_DIR_FILE_NAME_LENGTH)) {
+			return &fw_catalogue.records[i];
+		}
+	}
+	return NULL;
+}
+
+
+#define FW_CATALOGUE_FILE_SIZE_OK 0
+#define FW_CATALOGUE_FILE_SIZE_FAILED -1
+static int32_t fw_catalogue_file_size(struct sffs *fs, const char *fname, uint32_t *size) {
+	struct sffs_file f;
+	if (sffs_open(fs, &f, fname, SFFS_READ) != SFFS_OPEN_OK) {
+		return FW_CATALOGUE_FILE_SIZE_FAILED;
+	}
+	int32_t res = sffs_file_size(fs, &f, size);
+	sffs_close(&f);
+
+	if (res != SFFS_FILE_SIZE_OK) {
+		return FW_CATALOGUE_FILE_SIZE_FAILED;
+	}
+	return FW_CATALOGUE_FILE_SIZE_OK;
+}
+
+
+int32_t fw_catalogue_invalidate(struct sffs *fs, const char *fname) {
+	if (u_assert(fs != NULL && fname != NULL)) {
+		return FW_CATALOGUE_INVALIDATE_FAILED;
+	}
+
+	fw_catalogue_load(fs);
+	fw_catalogue.generation++;
+
+	struct fw_catalogue_record *rec = fw_catalogue_find(fname);
+	if (rec != NULL) {
+		memset(rec, 0, sizeof(struct fw_catalogue_record));
+	}
+
+	if (fw_catalogue_save(fs) != FW_CATALOGUE_SAVE_OK) {
+		/* A stale record must not survive, remove the catalogue. */
+		sffs_file_remove(fs, FW_CATALOGUE_FILE);
+		return FW_CATALOGUE_INVALIDATE_FAILED;
+	}
+
+	return FW_CATALOGUE_INVALIDATE_OK;
+}
+
+
+int32_t fw_catalogue_update(struct sffs *fs, const char *fname, struct fw_image *fw, enum fw_catalogue_status status) {
+	if (u_assert(fs != NULL && fname != NULL && fw != NULL)) {
+		return FW_CATALOGUE_UPDATE_FAILED;
+	}
+
+	uint32_t size = 0;
+	if (strlen(fname) >= SFFS_DIR_FILE_NAME_LENGTH ||
+	    fw_catalogue_file_size(fs, fname, &size) != FW_CATALOGUE_FILE_SIZE_OK) {
+		return FW_CATALOGUE_UPDATE_FAILED;
+	}
+
+	fw_catalogue_load(fs);
+
+	/* Reuse the record of the file, a free one or the oldest one. */
+	struct fw_catalogue_record *rec = fw_catalogue_find(fname);
+	if (rec == NULL) {
+		rec = &fw_catalogue.records[0];
+		for (uint32_t i = 0; i < FW_CATALOGUE_RECORDS; i++) {
+			if (fw_catalogue.records[i].name[0] == '\0') {
+				rec = &fw_catalogue.records[i];
+				break;
+			}
+			if (fw_catalogue.records[i].generation < rec->generation) {
+				rec = &fw_catalogue.records[i];
+			}
+		}
+	}
+
+	memset(rec, 0, sizeof(struct fw_catalogue_record));
+	strlcpy(rec->name, fname, sizeof(rec->name));
+	rec->size = size;
+	rec->generation = fw_catalogue.generation;
+	rec->status = status;
+	if (status != FW_CATALOGUE_STATUS_INVALID) {
+		if (fw->have_version) {
+			memcpy(rec->version, fw->version, sizeof(rec->version));
+		}
+		if (fw->have_hash && fw->hash_len <= sizeof(rec->hash)) {
+			rec->hash_len = fw->hash_len;
+			memcpy(rec->hash, fw->hash, fw->hash_len);
+		}
+		if (fw->have_pubkey_fp && fw->pubkey_fp_len <= sizeof(rec->pubkey_fp)) {
+			rec->pubkey_fp_len = fw->pubkey_fp_len;
+			memcpy(rec->pubkey_fp, fw->pubkey_fp, fw->pubkey_fp_len);
+		}
+	}
+
+	if (fw_catalogue_save(fs) != FW_CATALOGUE_SAVE_OK) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_catalogue: cannot save record of %s", fname);
+		return FW_CATALOGUE_UPDATE_FAILED;
+	}
+
+	return FW_CATALOGUE_UPDATE_OK;
+}
+
+
+int32_t fw_catalogue_get(struct sffs *fs, const char *fname, struct fw_catalogue_record *rec) {
+	if (u_assert(fs != NULL && fname != NULL && rec != NULL)) {
+		return FW_CATALOGUE_GET_FAILED;
+	}
+
+	if (fw_catalogue_load(fs) != FW_CATALOGUE_LOAD_OK) {
+		return FW_CATALOGUE_GET_FAILED;
+	}
+
+	struct fw_catalogue_record *r = fw_catalogue_find(fname);
+	uint32_t size = 0;
+	if (r == NULL ||
+	    fw_catalogue_file_size(fs, fname, &size) != FW_CATALOGUE_FILE_SIZE_OK ||
+	    size != r->size) {
+		return FW_CATALOGUE_GET_FAILED;
+	}
+	memcpy(rec, r, sizeof(struct fw_catalogue_record));
+
+	return FW_CATALOGUE_GET_OK;
+}
+
+
+bool fw_catalogue_known_invalid(struct sffs *fs, const char *fname) {
+	if (u_assert(fs != NULL && fname != NULL)) {
+		return false;
+	}
+
+	struct fw_catalogue_record rec;
+	if (fw_catalogue_get(fs, fname, &rec) != FW_CATALOGUE_GET_OK) {
+		return false;
+	}
+
+	/* The catalogue is still loaded. */
+	return rec.status == FW_CATALOGUE_STATUS_INVALID && rec.generation == fw_catalogue.generation;
+}
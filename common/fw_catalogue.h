@@ -0,0 +1,138 @@
+/**
+ * uBLoad firmware file catalogue
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FW_CATALOGUE_H_
+#define _FW_CATALOGUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sffs.h"
+#include "fw_image.h"
+
+#define FW_CATALOGUE_FILE "fw.cat"
+#define FW_CATALOGUE_MAGIC 0x3b8d52f6
+#define FW_CATALOGUE_RECORDS 8
+#define FW_CATALOGUE_FP_SIZE 4
+
+enum fw_catalogue_status {
+	FW_CATALOGUE_STATUS_INVALID,
+	FW_CATALOGUE_STATUS_VERIFIED,
+	FW_CATALOGUE_STATUS_AUTHENTICATED,
+};
+
+/**
+ * Catalogue record describes a firmware file as it was when it was last
+ * verified. It is only a hint used to avoid reading whole images (listing,
+ * fallback selection, update decisions), the image is always authenticated
+ * before it is programmed.
+ */
+struct fw_catalogue_record {
+	/**
+	 * Empty name marks a free record.
+	 */
+	char name[SFFS_DIR_FILE_NAME_LENGTH];
+
+	/**
+	 * The record is valid only if the file size did not change since.
+	 */
+	uint32_t size;
+
+	/**
+	 * Catalogue generation is incremented every time a firmware file is
+	 * written or removed, the record keeps the generation in which the
+	 * file was checked.
+	 */
+	uint32_t generation;
+	enum fw_catalogue_status status;
+
+	/**
+	 * Image description, empty if the image is invalid.
+	 */
+	char version[FW_IMAGE_VERSION_LEN];
+	uint32_t hash_len;
+	uint8_t hash[FW_IMAGE_HASH_MAX_SIZE];
+	uint32_t pubkey_fp_len;
+	uint8_t pubkey_fp[FW_CATALOGUE_FP_SIZE];
+};
+
+
+/**
+ * @brief Drop the record of a firmware file.
+ *
+ * It must be called every time a firmware file is written or removed.
+ * Catalogue generation is incremented.
+ *
+ * @param fs Filesystem containing the file and the catalogue.
+ * @param fname Name of the firmware file.
+ *
+ * @return FW_CATALOGUE_INVALIDATE_OK if the record was dropped or
+ *         FW_CATALOGUE_INVALIDATE_FAILED otherwise.
+ */
+int32_t fw_catalogue_invalidate(struct sffs *fs, const char *fname);
+#define FW_CATALOGUE_INVALIDATE_OK 0
+#define FW_CATALOGUE_INVALIDATE_FAILED -1
+
+/**
+ * @brief Save the result of a firmware file check.
+ *
+ * @param fs Filesystem containing the file and the catalogue.
+ * @param fname Name of the firmware file.
+ * @param fw Firmware image parsed from the file. Version, hash and
+ *           pubkey fingerprint are saved unless the status is invalid.
+ * @param status Result of the check.
+ *
+ * @return FW_CATALOGUE_UPDATE_OK if the record was saved or
+ *         FW_CATALOGUE_UPDATE_FAILED otherwise.
+ */
+int32_t fw_catalogue_update(struct sffs *fs, const char *fname, struct fw_image *fw, enum fw_catalogue_status status);
+#define FW_CATALOGUE_UPDATE_OK 0
+#define FW_CATALOGUE_UPDATE_FAILED -1
+
+/**
+ * @brief Get the record of a firmware file.
+ *
+ * @param fs Filesystem containing the file and the catalogue.
+ * @param fname Name of the firmware file.
+ * @param rec Record is copied here.
+ *
+ * @return FW_CATALOGUE_GET_OK if a record of the file was found and the file
+ *         size still matches or FW_CATALOGUE_GET_FAILED otherwise.
+ */
+int32_t fw_catalogue_get(struct sffs *fs, const char *fname, struct fw_catalogue_record *rec);
+#define FW_CATALOGUE_GET_OK 0
+#define FW_CATALOGUE_GET_FAILED -1
+
+/**
+ * @brief Check if a firmware file is known to be invalid.
+ *
+ * The check result is trusted only if no firmware file was written since
+ * (a delta image can become valid when its base image changes).
+ *
+ * @param fs Filesystem containing the file and the catalogue.
+ * @param fname Name of the firmware file.
+ *
+ * @return true if the file failed its last check in the current generation.
+ */
+bool fw_catalogue_known_invalid(struct sffs *fs, const char *fname);
+
+
+#endif
@@ -27,18 +27,35 @@
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/stm32/flash.h>
 #include <libopencm3/stm32/iwdg.h>
+#include <libopencm3/cm3/scb.h>
 
 #include "u_assert.h"
 #include "u_log.h"
 #include "config.h"
 #include "config_port.h"
 #include "fw_image.h"
-#include "cli.h"
 #include "sha512.h"
+#include "sha256.h"
+#include "blake2s.h"
 #include "edsign.h"
 #include "pubkey_storage.h"
 #include "sffs.h"
-
+#include "verify_cache.h"
+#include "fw_catalogue.h"
+#include "crc32.h"
+#include "lz4_stream.h"
+#include "delta_stream.h"
+#include "chunk_stream.h"
+#include "timer.h"
+
+/* Decoders used for compressed and delta images and the chunked image checker.
+ * They are too big for the stack. */
+static struct lz4_stream fw_image_lz4;
+static struct delta_stream fw_image_delta;
+static struct sffs_file fw_image_delta_base;
+static struct chunk_stream fw_image_chunks;
+
+static int32_t fw_image_program_stream_image(const uint8_t *data, uint32_t len, void *ctx);
 
 int32_t fw_image_init(struct fw_image *fw, void *base, uint8_t base_sector, uint8_t sectors) {
 	if (u_assert(fw != NULL)) {
@@ -73,6 +90,9 @@ int32_t fw_image_jump(struct fw_image *fw) {
 	/* load application entry point to app_entry function pointer */
 	t_app_entry app_entry = (t_app_entry)(vector_table[1]);
 
+	/* The image may run from any slot, relocate the vector table. */
+	SCB_VTOR = (uint32_t)vector_table;
+
 	/* set app stack pointer and jump to application */
 	msp = vector_table[0];
 	app_entry();
@@ -111,19 +131,183 @@ int32_t fw_image_watchdog_enable(struct fw_image *fw, uint32_t period) {
 }
 
 
+/**
+ * Sector sizes of the STM32F4 internal flash (single bank layout).
+ */
+static uint32_t fw_image_sector_size(uint32_t sector) {
+	if (sector < 4) {
+		return 0x4000;
+	}
+	if (sector == 4) {
+		return 0x10000;
+	}
+	return 0x20000;
+}
+
+
+/**
+ * Return index of the sector (relative to the base sector) containing
+ * @a offset of the image area, @a end is set to the end of the sector.
+ * The number of sectors is returned for offsets outside the area.
+ */
+static uint32_t fw_image_sector_index(struct fw_image *fw, uint32_t offset, uint32_t *end) {
+	uint32_t start = 0;
+	for (uint32_t i = 0; i < fw->sectors; i++) {
+		uint32_t size = fw_image_sector_size(fw->base_sector + i);
+		if (offset - start < size) {
+			*end = start + size;
+			return i;
+		}
+		start += size;
+	}
+	*end = UINT32_MAX;
+	return fw->sectors;
+}
+
+
+int32_t fw_image_check_location(struct fw_image *fw) {
+	if (u_assert(fw != NULL)) {
+		return FW_IMAGE_CHECK_LOCATION_FAILED;
+	}
+
+	if (fw->parsed == false) {
+		return FW_IMAGE_CHECK_LOCATION_FAILED;
+	}
+
+	const uint32_t *vector_table = (uint32_t *)((uint8_t *)fw->base + fw->offset);
+	uint32_t end;
+	if (fw_image_sector_index(fw, vector_table[1] - (uint32_t)fw->base, &end) >= fw->sectors) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: firmware is not linked for address 0x%08x", (unsigned int)fw->base);
+		return FW_IMAGE_CHECK_LOCATION_FAILED;
+	}
+
+	return FW_IMAGE_CHECK_LOCATION_OK;
+}
+
+
+/**
+ * Flash is kept unlocked for the whole programming session, it is unlocked
+ * and locked again for each operation otherwise. Unlocking must not be
+ * attempted if the flash is already unlocked.
+ */
+static void fw_image_flash_unlock(void) {
+	if (FLASH_CR & FLASH_CR_LOCK) {
+		flash_unlock();
+	}
+}
+
+
+static void fw_image_flash_lock(struct fw_image *fw) {
+	if (fw->program_session == false) {
+		flash_lock();
+	}
+}
+
+
+/**
+ * Program the internal flash using the widest parallelism allowed by
+ * FW_IMAGE_PROGRAM_SPEED, capped at x32 (x64 requires an external Vpp).
+ * The PG bit stays set for the whole run of aligned words and only the BSY
+ * flag is polled between them. Unaligned head and tail bytes are programmed
+ * one by one. Words which would not change the (erased) flash are skipped.
+ * Flash must be unlocked.
+ */
+static void fw_image_flash_program(uint32_t address, const uint8_t *data, uint32_t len) {
+#if FW_IMAGE_PROGRAM_SPEED >= FLASH_CR_PROGRAM_X32
+	while (len > 0 && (address & 3)) {
+		flash_program_byte(address, *data);
+		address++;
+		data++;
+		len--;
+	}
+
+	if (len >= 4) {
+		flash_wait_for_last_operation();
+		FLASH_CR &= ~(FLASH_CR_PROGRAM_MASK << FLASH_CR_PROGRAM_SHIFT);
+		FLASH_CR |= FLASH_CR_PROGRAM_X32 << FLASH_CR_PROGRAM_SHIFT;
+		FLASH_CR |= FLASH_CR_PG;
+
+		while (len >= 4) {
+			uint32_t word;
+			memcpy(&word, data, sizeof(word));
+			if (word != 0xffffffff) {
+				MMIO32(address) = word;
+				while (FLASH_SR & FLASH_SR_BSY) {
+					;
+				}
+			}
+			address += 4;
+			data += 4;
+			len -= 4;
+		}
+
+		FLASH_CR &= ~FLASH_CR_PG;
+	}
+
+	while (len > 0) {
+		flash_program_byte(address, *data);
+		address++;
+		data++;
+		len--;
+	}
+#else
+	flash_program(address, (uint8_t *)data, len);
+#endif
+}
+
+
+/**
+ * Erase a single sector of the image area starting at @a offset. Blank
+ * sectors are skipped, each erase takes a considerable amount of time
+ * (up to seconds for 128KB sectors) and it wears the flash.
+ */
+#define FW_IMAGE_ERASE_SECTOR_OK 0
+#define FW_IMAGE_ERASE_SECTOR_FAILED -1
+static int32_t fw_image_erase_sector(struct fw_image *fw, uint32_t sector, uint32_t offset) {
+	const uint32_t *data = (const uint32_t *)(fw->base + offset);
+	uint32_t words = fw_image_sector_size(sector) / sizeof(uint32_t);
+
+	uint32_t i = 0;
+	while (i < words && data[i] == 0xffffffff) {
+		i++;
+	}
+	if (i == words) {
+		return FW_IMAGE_ERASE_SECTOR_OK;
+	}
+
+	fw_image_flash_unlock();
+	flash_erase_sector(sector, FW_IMAGE_PROGRAM_SPEED);
+	fw_image_flash_lock(fw);
+
+	/* Check the result, there is no point in programming otherwise. */
+	for (i = 0; i < words; i++) {
+		if (data[i] != 0xffffffff) {
+			u_log(system_log, LOG_TYPE_ERROR, "fw_image: sector %u erase failed", sector);
+			return FW_IMAGE_ERASE_SECTOR_FAILED;
+		}
+	}
+
+	return FW_IMAGE_ERASE_SECTOR_OK;
+}
+
+
 int32_t fw_image_erase(struct fw_image *fw) {
 	if (u_assert(fw != NULL)) {
 		return FW_IMAGE_ERASE_FAILED;
 	}
 
-	/* TODO: erase progress callback */
+	/* Any previous verification record is not valid anymore. */
+	verify_cache_invalidate();
 
 	if (fw->progress_callback != NULL) {
 		fw->progress_callback(0, fw->sectors, fw->progress_callback_ctx);
 	}
-	flash_unlock();
+	uint32_t offset = 0;
 	for (uint32_t i = fw->base_sector; i < (fw->base_sector + fw->sectors); i++) {
-		flash_erase_sector(i, FW_IMAGE_PROGRAM_SPEED);
+		if (fw_image_erase_sector(fw, i, offset) != FW_IMAGE_ERASE_SECTOR_OK) {
+			return FW_IMAGE_ERASE_FAILED;
+		}
+		offset += fw_image_sector_size(i);
 
 		/* Handle erase progress and abort. */
 		if (fw->progress_callback != NULL) {
@@ -132,7 +316,6 @@ int32_t fw_image_erase(struct fw_image *fw) {
 			}
 		}
 	}
-	flash_lock();
 
 	fw_image_init(fw, fw->base, fw->base_sector, fw->sectors);
 
@@ -140,21 +323,451 @@ int32_t fw_image_erase(struct fw_image *fw) {
 }
 
 
-int32_t fw_image_program(struct fw_image *fw, uint32_t offset, uint8_t *data, uint32_t len) {
+/**
+ * Make sure the image area is erased up to @a end (offset from the base)
+ * before it is programmed. Only sectors not erased in the current
+ * programming session are considered.
+ */
+#define FW_IMAGE_PROGRAM_ERASE_OK 0
+#define FW_IMAGE_PROGRAM_ERASE_FAILED -1
+static int32_t fw_image_program_erase(struct fw_image *fw, uint32_t end) {
+	uint32_t offset = 0;
+	for (uint32_t i = fw->base_sector; i < (fw->base_sector + fw->sectors); i++) {
+		uint32_t size = fw_image_sector_size(i);
+		if (offset >= end) {
+			return FW_IMAGE_PROGRAM_ERASE_OK;
+		}
+		if (offset >= fw->program_erased) {
+			if ((fw->program_keep & (1UL << (i - fw->base_sector))) == 0 &&
+			    fw_image_erase_sector(fw, i, offset) != FW_IMAGE_ERASE_SECTOR_OK) {
+				return FW_IMAGE_PROGRAM_ERASE_FAILED;
+			}
+			fw->program_erased = offset + size;
+		}
+		offset += size;
+	}
+
+	if (offset < end) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: image doesn't fit in the firmware area (%u bytes)", offset);
+		return FW_IMAGE_PROGRAM_ERASE_FAILED;
+	}
+
+	return FW_IMAGE_PROGRAM_ERASE_OK;
+}
+
+
+int32_t fw_image_program(struct fw_image *fw, uint32_t offset, const uint8_t *data, uint32_t len) {
 	if (u_assert(fw != NULL) ||
 	    u_assert(data != NULL) ||
 	    u_assert(len > 0)) {
 		return FW_IMAGE_PROGRAM_FAILED;
 	}
 
-	flash_unlock();
-	flash_program((uint32_t)fw->base + offset, data, len);
-	flash_lock();
+	fw_image_flash_unlock();
+	fw_image_flash_program((uint32_t)fw->base + offset, data, len);
+	fw_image_flash_lock(fw);
 
 	return FW_IMAGE_PROGRAM_OK;
 }
 
 
+int32_t fw_image_program_begin(struct fw_image *fw, struct sffs *fs) {
+	if (u_assert(fw != NULL)) {
+		return FW_IMAGE_PROGRAM_BEGIN_FAILED;
+	}
+
+	/* Previous parsing results are not valid anymore. */
+	fw->parsed = false;
+	fw->verified = false;
+	fw->authenticated = false;
+	fw->have_hash = false;
+	fw->have_crc = false;
+	fw->crc = 0;
+
+	/* Neither is any previous verification record. */
+	verify_cache_invalidate();
+
+	fw->program_session = true;
+	fw_image_flash_unlock();
+	fw->program_failed = false;
+	fw->program_hash_valid = true;
+	fw->program_have_header = false;
+	fw->program_offset = 0;
+	fw->program_erased = 0;
+	fw->program_compare = false;
+	fw->program_changed = 0;
+	fw->program_keep = 0;
+	for (uint32_t i = 0; i < FW_IMAGE_HASH_TYPES; i++) {
+		fw_image_hash_init(&fw->program_hash[i], (enum fw_image_section_hash)i);
+	}
+
+	fw->program_fs = fs;
+	fw->program_stream_in = 0;
+	fw->program_stream_out = 0;
+	fw->program_stream_magic = 0;
+	fw->program_stream_len = 0;
+	chunk_stream_init(&fw_image_chunks, FW_IMAGE_SECTION_MAGIC_CHUNKS, fw_image_program_stream_image, (void *)fw);
+
+	return FW_IMAGE_PROGRAM_BEGIN_OK;
+}
+
+
+int32_t fw_image_program_chunk(struct fw_image *fw, uint32_t offset, const uint8_t *data, uint32_t len) {
+	if (u_assert(fw != NULL) ||
+	    u_assert(fw->program_session == true) ||
+	    u_assert(data != NULL) ||
+	    u_assert(len > 0)) {
+		return FW_IMAGE_PROGRAM_CHUNK_FAILED;
+	}
+
+	if (offset > UINT32_MAX - len) {
+		fw->program_failed = true;
+		return FW_IMAGE_PROGRAM_CHUNK_FAILED;
+	}
+
+	/* Compare the chunk with the flash contents sector by sector. */
+	if (fw->program_compare) {
+		uint32_t pos = offset;
+		while (pos < offset + len) {
+			uint32_t end;
+			uint32_t i = fw_image_sector_index(fw, pos, &end);
+			if (i >= fw->sectors) {
+				break;
+			}
+			uint32_t n = ((end < offset + len) ? end : (offset + len)) - pos;
+			if (memcmp(fw->base + pos, data + (pos - offset), n)) {
+				fw->program_changed |= 1UL << i;
+			}
+			pos += n;
+		}
+		return FW_IMAGE_PROGRAM_CHUNK_OK;
+	}
+
+	if (fw_image_program_erase(fw, offset + len) != FW_IMAGE_PROGRAM_ERASE_OK) {
+		fw->program_failed = true;
+		return FW_IMAGE_PROGRAM_CHUNK_FAILED;
+	}
+	if (fw->program_keep == 0) {
+		fw_image_program(fw, offset, data, len);
+	} else {
+		/* Skip parts of the chunk in sectors which are kept. */
+		uint32_t pos = offset;
+		while (pos < offset + len) {
+			uint32_t end;
+			uint32_t i = fw_image_sector_index(fw, pos, &end);
+			uint32_t n = ((end < offset + len) ? end : (offset + len)) - pos;
+			if ((fw->program_keep & (1UL << i)) == 0) {
+				fw_image_program(fw, pos, data + (pos - offset), n);
+			}
+			pos += n;
+		}
+	}
+
+	/* Read the chunk back. Data hashed below are then known to be
+	 * the same as the programmed ones. */
+	if (memcmp(fw->base + offset, data, len)) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: programmed data mismatch at offset 0x%08x", offset);
+		fw->program_failed = true;
+		return FW_IMAGE_PROGRAM_CHUNK_FAILED;
+	}
+
+	if (fw->program_hash_valid == false) {
+		return FW_IMAGE_PROGRAM_CHUNK_OK;
+	}
+	if (offset != fw->program_offset) {
+		u_log(system_log, LOG_TYPE_WARN, "fw_image: non-sequential programming, cannot hash the image");
+		fw->program_hash_valid = false;
+		return FW_IMAGE_PROGRAM_CHUNK_OK;
+	}
+	fw->program_offset += len;
+
+	/* Verified section length is known as soon as its header is programmed. */
+	if (fw->program_have_header == false && fw->program_offset >= 8) {
+		uint8_t *section_base = fw->base;
+		fw_image_parse_section(fw, &section_base, &fw->verified_section);
+		if (fw->verified_section.len > (UINT32_MAX - 8)) {
+			fw->program_hash_valid = false;
+			return FW_IMAGE_PROGRAM_CHUNK_OK;
+		}
+		fw->program_have_header = true;
+	}
+
+	if (fw->program_have_header) {
+		/* Hash only the part of the chunk overlapping the verified
+		 * section data. */
+		uint32_t start = 8;
+		uint32_t end = 8 + fw->verified_section.len;
+		uint32_t from = (offset > start) ? offset : start;
+		uint32_t to = fw->program_offset;
+		if (to > end) {
+			to = end;
+		}
+		if (from < to) {
+			for (uint32_t i = 0; i < FW_IMAGE_HASH_TYPES; i++) {
+				fw_image_hash_update(&fw->program_hash[i], data + (from - offset), to - from);
+			}
+		}
+	}
+
+	return FW_IMAGE_PROGRAM_CHUNK_OK;
+}
+
+
+static bool fw_image_stream_encoded(struct fw_image *fw) {
+	return fw->program_stream_magic == FW_IMAGE_SECTION_MAGIC_COMPRESSED ||
+	       fw->program_stream_magic == FW_IMAGE_SECTION_MAGIC_DELTA;
+}
+
+
+static int32_t fw_image_delta_base_read(uint32_t offset, uint8_t *data, uint32_t len, void *ctx) {
+	struct sffs_file *f = (struct sffs_file *)ctx;
+
+	if (sffs_seek(f, offset) != SFFS_SEEK_OK ||
+	    sffs_read(f, data, len) != (int32_t)len) {
+		return DELTA_STREAM_BASE_READ_FAILED;
+	}
+
+	return DELTA_STREAM_BASE_READ_OK;
+}
+
+
+/**
+ * Compressed and delta sections contain the verified section encoded. They
+ * are decoded on the fly, the verified section is passed to the @a output
+ * callback. It must return 0 on success (LZ4_STREAM_OUTPUT_OK and
+ * DELTA_STREAM_OUTPUT_OK are the same).
+ */
+#define FW_IMAGE_DECODE_BEGIN_OK 0
+#define FW_IMAGE_DECODE_BEGIN_FAILED -1
+static int32_t fw_image_decode_begin(uint32_t magic, struct sffs *fs, int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx), void *ctx) {
+	switch (magic) {
+		case FW_IMAGE_SECTION_MAGIC_COMPRESSED:
+			lz4_stream_init(&fw_image_lz4, output, ctx);
+			return FW_IMAGE_DECODE_BEGIN_OK;
+
+		case FW_IMAGE_SECTION_MAGIC_DELTA:
+			if (fs == NULL ||
+			    sffs_open(fs, &fw_image_delta_base, FW_IMAGE_DELTA_BASE_FILE, SFFS_READ) != SFFS_OPEN_OK) {
+				u_log(system_log, LOG_TYPE_ERROR, "fw_image: cannot open delta base image %s", FW_IMAGE_DELTA_BASE_FILE);
+				return FW_IMAGE_DECODE_BEGIN_FAILED;
+			}
+			delta_stream_init(&fw_image_delta, fw_image_delta_base_read, (void *)&fw_image_delta_base, output, ctx);
+			return FW_IMAGE_DECODE_BEGIN_OK;
+
+		default:
+			return FW_IMAGE_DECODE_BEGIN_FAILED;
+	}
+}
+
+
+#define FW_IMAGE_DECODE_FEED_OK 0
+#define FW_IMAGE_DECODE_FEED_FAILED -1
+static int32_t fw_image_decode_feed(uint32_t magic, const uint8_t *data, uint32_t len) {
+	if (magic == FW_IMAGE_SECTION_MAGIC_COMPRESSED) {
+		if (lz4_stream_feed(&fw_image_lz4, data, len) != LZ4_STREAM_FEED_OK) {
+			return FW_IMAGE_DECODE_FEED_FAILED;
+		}
+	} else {
+		if (delta_stream_feed(&fw_image_delta, data, len) != DELTA_STREAM_FEED_OK) {
+			sffs_close(&fw_image_delta_base);
+			return FW_IMAGE_DECODE_FEED_FAILED;
+		}
+	}
+
+	return FW_IMAGE_DECODE_FEED_OK;
+}
+
+
+#define FW_IMAGE_DECODE_FINISH_OK 0
+#define FW_IMAGE_DECODE_FINISH_FAILED -1
+static int32_t fw_image_decode_finish(uint32_t magic) {
+	if (magic == FW_IMAGE_SECTION_MAGIC_COMPRESSED) {
+		if (lz4_stream_finish(&fw_image_lz4) != LZ4_STREAM_FINISH_OK) {
+			return FW_IMAGE_DECODE_FINISH_FAILED;
+		}
+	} else {
+		sffs_close(&fw_image_delta_base);
+		if (delta_stream_finish(&fw_image_delta) != DELTA_STREAM_FINISH_OK) {
+			return FW_IMAGE_DECODE_FINISH_FAILED;
+		}
+	}
+
+	return FW_IMAGE_DECODE_FINISH_OK;
+}
+
+
+static int32_t fw_image_program_stream_output(const uint8_t *data, uint32_t len, void *ctx) {
+	struct fw_image *fw = (struct fw_image *)ctx;
+
+	if (fw_image_program_chunk(fw, fw->program_stream_out, data, len) != FW_IMAGE_PROGRAM_CHUNK_OK) {
+		return LZ4_STREAM_OUTPUT_FAILED;
+	}
+	fw->program_stream_out += len;
+
+	return LZ4_STREAM_OUTPUT_OK;
+}
+
+
+/**
+ * Program the image stream after the chunk table is removed (output callback
+ * of the chunk stream checker).
+ */
+static int32_t fw_image_program_stream_image(const uint8_t *data, uint32_t len, void *ctx) {
+	struct fw_image *fw = (struct fw_image *)ctx;
+
+	while (len > 0) {
+		/* Collect the first section header to find out if the image
+		 * is encoded. */
+		if (fw->program_stream_in < 8) {
+			uint32_t n = 8 - fw->program_stream_in;
+			if (n > len) {
+				n = len;
+			}
+			memcpy(fw->program_stream_header + fw->program_stream_in, data, n);
+			fw->program_stream_in += n;
+			data += n;
+			len -= n;
+
+			if (fw->program_stream_in == 8) {
+				struct fw_image_section section;
+				uint8_t *section_base = fw->program_stream_header;
+				fw_image_parse_section(fw, &section_base, &section);
+
+				fw->program_stream_magic = section.magic;
+				fw->program_stream_len = section.len;
+				if (fw_image_stream_encoded(fw)) {
+					u_log(system_log, LOG_TYPE_INFO, "fw_image: %s image, decoding",
+						(section.magic == FW_IMAGE_SECTION_MAGIC_DELTA) ? "delta" : "compressed");
+					if (fw_image_decode_begin(section.magic, fw->program_fs, fw_image_program_stream_output, (void *)fw) != FW_IMAGE_DECODE_BEGIN_OK) {
+						fw->program_failed = true;
+						return CHUNK_STREAM_OUTPUT_FAILED;
+					}
+				} else {
+					if (fw_image_program_stream_output(fw->program_stream_header, 8, (void *)fw) != LZ4_STREAM_OUTPUT_OK) {
+						return CHUNK_STREAM_OUTPUT_FAILED;
+					}
+				}
+			}
+			continue;
+		}
+
+		/* Decode the compressed or delta section. */
+		if (fw_image_stream_encoded(fw) &&
+		    fw->program_stream_in - 8 < fw->program_stream_len) {
+			uint32_t n = fw->program_stream_len - (fw->program_stream_in - 8);
+			if (n > len) {
+				n = len;
+			}
+			if (fw_image_decode_feed(fw->program_stream_magic, data, n) != FW_IMAGE_DECODE_FEED_OK) {
+				u_log(system_log, LOG_TYPE_ERROR, "fw_image: decoding failed");
+				fw->program_failed = true;
+				return CHUNK_STREAM_OUTPUT_FAILED;
+			}
+			fw->program_stream_in += n;
+			data += n;
+			len -= n;
+
+			if (fw->program_stream_in - 8 == fw->program_stream_len) {
+				if (fw_image_decode_finish(fw->program_stream_magic) != FW_IMAGE_DECODE_FINISH_OK) {
+					u_log(system_log, LOG_TYPE_ERROR, "fw_image: decoding failed");
+					fw->program_failed = true;
+					return CHUNK_STREAM_OUTPUT_FAILED;
+				}
+				u_log(system_log, LOG_TYPE_INFO, "fw_image: %u bytes decoded", fw->program_stream_out);
+			}
+			continue;
+		}
+
+		/* Everything else is programmed as it is. */
+		if (fw_image_program_stream_output(data, len, (void *)fw) != LZ4_STREAM_OUTPUT_OK) {
+			return CHUNK_STREAM_OUTPUT_FAILED;
+		}
+		fw->program_stream_in += len;
+		len = 0;
+	}
+
+	return CHUNK_STREAM_OUTPUT_OK;
+}
+
+
+int32_t fw_image_program_stream(struct fw_image *fw, const uint8_t *data, uint32_t len) {
+	if (u_assert(fw != NULL) ||
+	    u_assert(fw->program_session == true) ||
+	    u_assert(data != NULL)) {
+		return FW_IMAGE_PROGRAM_STREAM_FAILED;
+	}
+
+	/* If the image is chunked, each chunk is checked as soon as it
+	 * is complete. The rest is passed to the image programming. */
+	int32_t res = chunk_stream_feed(&fw_image_chunks, data, len);
+	if (res == CHUNK_STREAM_FEED_BAD_CHUNK) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: chunk %u corrupted", (unsigned int)fw_image_chunks.chunk);
+		fw->program_failed = true;
+		return FW_IMAGE_PROGRAM_STREAM_FAILED;
+	}
+	if (res != CHUNK_STREAM_FEED_OK) {
+		fw->program_failed = true;
+		return FW_IMAGE_PROGRAM_STREAM_FAILED;
+	}
+
+	return FW_IMAGE_PROGRAM_STREAM_OK;
+}
+
+
+int32_t fw_image_program_end(struct fw_image *fw) {
+	if (u_assert(fw != NULL) ||
+	    u_assert(fw->program_session == true)) {
+		return FW_IMAGE_PROGRAM_END_FAILED;
+	}
+
+	fw->program_session = false;
+	flash_lock();
+	if (fw->program_failed) {
+		return FW_IMAGE_PROGRAM_END_FAILED;
+	}
+
+	/* Compressed or delta image must be complete. */
+	if (fw_image_stream_encoded(fw) &&
+	    fw->program_stream_in - 8 < fw->program_stream_len) {
+		if (fw->program_stream_magic == FW_IMAGE_SECTION_MAGIC_DELTA) {
+			sffs_close(&fw_image_delta_base);
+		}
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: encoded image truncated");
+		return FW_IMAGE_PROGRAM_END_FAILED;
+	}
+
+	/* All chunks of a chunked image must be received and checked. */
+	if (chunk_stream_finish(&fw_image_chunks) != CHUNK_STREAM_FINISH_OK) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: chunked image incomplete or corrupted");
+		return FW_IMAGE_PROGRAM_END_FAILED;
+	}
+
+	if (fw_image_parse(fw) != FW_IMAGE_PARSE_OK) {
+		return FW_IMAGE_PROGRAM_END_FAILED;
+	}
+
+	if (fw->program_hash_valid == false ||
+	    fw->have_hash == false ||
+	    fw->program_hash[fw->hash_type].total != fw->verified_section.len) {
+		u_log(system_log, LOG_TYPE_WARN, "fw_image: firmware not verified during programming");
+		return FW_IMAGE_PROGRAM_END_UNVERIFIED;
+	}
+
+	uint8_t computed_hash[FW_IMAGE_HASH_MAX_SIZE];
+	fw_image_hash_final(&fw->program_hash[fw->hash_type], computed_hash, fw->hash_len);
+	if (memcmp(computed_hash, fw->hash, fw->hash_len)) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: firmware verification failed");
+		fw->verified = false;
+		return FW_IMAGE_PROGRAM_END_FAILED;
+	}
+
+	u_log(system_log, LOG_TYPE_INFO, "fw_image: firmware verification OK");
+	fw->verified = true;
+
+	return FW_IMAGE_PROGRAM_END_OK;
+}
+
+
 int32_t fw_image_set_progress_callback(
 	struct fw_image *fw,
 	int32_t (*progress_callback)(uint32_t progress, uint32_t total, void *ctx),
@@ -172,42 +785,39 @@ int32_t fw_image_set_progress_callback(
 }
 
 
-int32_t fw_image_hash_compare(struct fw_image *fw, uint8_t *data, uint32_t len, uint8_t *hash) {
+int32_t fw_image_hash_compare(struct fw_image *fw, const uint8_t *data, uint32_t len, const uint8_t *hash) {
 	if (u_assert(fw != NULL) ||
-	    u_assert(hash != NULL)) {
+	    u_assert(hash != NULL) ||
+	    u_assert(fw->hash_type < FW_IMAGE_HASH_TYPES)) {
 		return FW_IMAGE_HASH_COMPARE_FAILED;
 	}
 
-	struct sha512_state ctx;
-
-	sha512_init(&ctx);
+	/* Reuse the programming session hash state, it is too large for the
+	 * stack. The session hash is not valid anymore. */
+	struct fw_image_hash *ctx = &fw->program_hash[fw->hash_type];
+	fw->program_hash_valid = false;
+	fw_image_hash_init(ctx, fw->hash_type);
 
 	if (fw->progress_callback != NULL) {
 		fw->progress_callback(0, len, fw->progress_callback_ctx);
 	}
 
 	uint32_t rem = len;
-	uint32_t last_progress = 0;
-	while (rem >= SHA512_BLOCK_SIZE) {
-		sha512_block(&ctx, data);
+	while (rem > 0) {
+		uint32_t chunk = (rem > 4096) ? 4096 : rem;
+		fw_image_hash_update(ctx, data, chunk);
 
-		rem -= SHA512_BLOCK_SIZE;
-		data += SHA512_BLOCK_SIZE;
-		last_progress += SHA512_BLOCK_SIZE;
+		rem -= chunk;
+		data += chunk;
 
-		if ((fw->progress_callback != NULL) && (last_progress > 4096)) {
+		if (fw->progress_callback != NULL) {
 			fw->progress_callback(len - rem, len, fw->progress_callback_ctx);
-			last_progress = 0;
 		}
 	}
-	sha512_final(&ctx, data, len);
-	uint8_t computed_hash[SHA512_HASH_SIZE];
-	sha512_get(&ctx, computed_hash, 0, SHA512_HASH_SIZE);
-	if (fw->progress_callback != NULL) {
-		fw->progress_callback(len, len, fw->progress_callback_ctx);
-	}
+	uint8_t computed_hash[FW_IMAGE_HASH_MAX_SIZE];
+	fw_image_hash_final(ctx, computed_hash, fw->hash_len);
 
-	if (!memcmp(computed_hash, hash, sizeof(computed_hash))) {
+	if (!memcmp(computed_hash, hash, fw->hash_len)) {
 		return FW_IMAGE_HASH_COMPARE_OK;
 	}
 
@@ -215,6 +825,138 @@ int32_t fw_image_hash_compare(struct fw_image *fw, uint8_t *data, uint32_t len,
 }
 
 
+uint32_t fw_image_hash_size(enum fw_image_section_hash type) {
+	switch (type) {
+		case FW_IMAGE_SECTION_HASH_SHA512:
+			return SHA512_HASH_SIZE;
+		case FW_IMAGE_SECTION_HASH_SHA256:
+			return SHA256_HASH_SIZE;
+		case FW_IMAGE_SECTION_HASH_BLAKE2S:
+			return BLAKE2S_HASH_SIZE;
+		default:
+			return 0;
+	}
+}
+
+
+static void fw_image_hash_block(struct fw_image_hash *h, const uint8_t *blk) {
+	switch (h->type) {
+		case FW_IMAGE_SECTION_HASH_SHA512:
+			sha512_block(&h->state.sha512, blk);
+			break;
+		case FW_IMAGE_SECTION_HASH_SHA256:
+			sha256_block(&h->state.sha256, blk);
+			break;
+		case FW_IMAGE_SECTION_HASH_BLAKE2S:
+			blake2s_block(&h->state.blake2s, blk);
+			break;
+		default:
+			break;
+	}
+}
+
+
+int32_t fw_image_hash_init(struct fw_image_hash *h, enum fw_image_section_hash type) {
+	if (u_assert(h != NULL)) {
+		return FW_IMAGE_HASH_INIT_FAILED;
+	}
+
+	h->type = type;
+	switch (type) {
+		case FW_IMAGE_SECTION_HASH_SHA512:
+			sha512_init(&h->state.sha512);
+			h->block_size = SHA512_BLOCK_SIZE;
+			break;
+		case FW_IMAGE_SECTION_HASH_SHA256:
+			sha256_init(&h->state.sha256);
+			h->block_size = SHA256_BLOCK_SIZE;
+			break;
+		case FW_IMAGE_SECTION_HASH_BLAKE2S:
+			blake2s_init(&h->state.blake2s);
+			h->block_size = BLAKE2S_BLOCK_SIZE;
+			break;
+		default:
+			return FW_IMAGE_HASH_INIT_FAILED;
+	}
+	h->block_len = 0;
+	h->total = 0;
+
+	return FW_IMAGE_HASH_INIT_OK;
+}
+
+
+int32_t fw_image_hash_update(struct fw_image_hash *h, const uint8_t *data, uint32_t len) {
+	if (u_assert(h != NULL) ||
+	    u_assert(data != NULL)) {
+		return FW_IMAGE_HASH_UPDATE_FAILED;
+	}
+
+	h->total += len;
+	while (len > 0) {
+		/* A full buffered block is not the last one anymore. */
+		if (h->block_len == h->block_size) {
+			fw_image_hash_block(h, h->block);
+			h->block_len = 0;
+		}
+
+		/* Whole blocks are hashed directly without copying if more
+		 * data follow. */
+		if (h->block_len == 0 && len > h->block_size) {
+			fw_image_hash_block(h, data);
+			data += h->block_size;
+			len -= h->block_size;
+			continue;
+		}
+
+		uint32_t n = h->block_size - h->block_len;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(h->block + h->block_len, data, n);
+		h->block_len += n;
+		data += n;
+		len -= n;
+	}
+
+	return FW_IMAGE_HASH_UPDATE_OK;
+}
+
+
+int32_t fw_image_hash_final(struct fw_image_hash *h, uint8_t *hash, uint32_t len) {
+	if (u_assert(h != NULL) ||
+	    u_assert(hash != NULL) ||
+	    u_assert(len <= fw_image_hash_size(h->type))) {
+		return FW_IMAGE_HASH_FINAL_FAILED;
+	}
+
+	switch (h->type) {
+		case FW_IMAGE_SECTION_HASH_SHA512:
+			/* SHA512 expects only the partial block. */
+			if (h->block_len == h->block_size) {
+				sha512_block(&h->state.sha512, h->block);
+			}
+			sha512_final(&h->state.sha512, h->block, h->total);
+			sha512_get(&h->state.sha512, hash, 0, len);
+			break;
+		case FW_IMAGE_SECTION_HASH_SHA256:
+			if (h->block_len == h->block_size) {
+				sha256_block(&h->state.sha256, h->block);
+			}
+			sha256_final(&h->state.sha256, h->block, h->total);
+			sha256_get(&h->state.sha256, hash, 0, len);
+			break;
+		case FW_IMAGE_SECTION_HASH_BLAKE2S:
+			blake2s_final(&h->state.blake2s, h->block, h->total);
+			blake2s_get(&h->state.blake2s, hash, 0, len);
+			break;
+		default:
+			return FW_IMAGE_HASH_FINAL_FAILED;
+	}
+
+	return FW_IMAGE_HASH_FINAL_OK;
+}
+
+
 int32_t fw_image_parse_section(struct fw_image *fw, uint8_t **section_base, struct fw_image_section *section) {
 	if (u_assert(fw != NULL) ||
 	    u_assert(section != NULL)) {
@@ -240,7 +982,96 @@ int32_t fw_image_parse_section(struct fw_image *fw, uint8_t **section_base, stru
 	/* Advance to the next section */
 	*section_base += 8 + len;
 
-	return FW_IMAGE_PARSE_SECTION_OK;
+	return FW_IMAGE_PARSE_SECTION_OK;
+}
+
+
+/**
+ * Parse all subsections of an already parsed verification section. It is
+ * used for images in the flash and for images loaded from files.
+ */
+#define FW_IMAGE_PARSE_VERIFICATION_OK 0
+#define FW_IMAGE_PARSE_VERIFICATION_FAILED -1
+static int32_t fw_image_parse_verification(struct fw_image *fw) {
+	uint8_t *section_base = NULL;
+	uint8_t *section_end = NULL;
+
+	fw->have_hash = false;
+	fw->have_crc = false;
+	fw->crc = 0;
+	section_base = fw->verification_section.data;
+	section_end = section_base + fw->verification_section.len;
+	while (section_base < section_end) {
+		struct fw_image_section subsection;
+		/* Subsections must not exceed the verification section. */
+		if ((uint32_t)(section_end - section_base) < 8 ||
+		    fw_image_parse_section(fw, &section_base, &subsection) != FW_IMAGE_PARSE_SECTION_OK ||
+		    subsection.len > (uint32_t)(section_end - subsection.data)) {
+			return FW_IMAGE_PARSE_VERIFICATION_FAILED;
+		}
+		switch (subsection.magic) {
+			case FW_IMAGE_SECTION_MAGIC_DUMMY:
+				break;
+			case FW_IMAGE_SECTION_MAGIC_SHA512:
+				/* SHA512 hash must be exactly 64 bytes long. */
+				if (subsection.len == 64) {
+					fw->have_hash = true;
+					fw->hash = subsection.data;
+					fw->hash_len = subsection.len;
+					fw->hash_type = FW_IMAGE_SECTION_HASH_SHA512;
+				}
+				break;
+			case FW_IMAGE_SECTION_MAGIC_SHA256:
+				/* SHA256 hash must be exactly 32 bytes long. */
+				if (subsection.len == 32) {
+					fw->have_hash = true;
+					fw->hash = subsection.data;
+					fw->hash_len = subsection.len;
+					fw->hash_type = FW_IMAGE_SECTION_HASH_SHA256;
+				}
+				break;
+			case FW_IMAGE_SECTION_MAGIC_BLAKE2S:
+				/* BLAKE2s-256 hash must be exactly 32 bytes long. */
+				if (subsection.len == 32) {
+					fw->have_hash = true;
+					fw->hash = subsection.data;
+					fw->hash_len = subsection.len;
+					fw->hash_type = FW_IMAGE_SECTION_HASH_BLAKE2S;
+				}
+				break;
+			case FW_IMAGE_SECTION_MAGIC_CRC32:
+				/* CRC32 is saved as a 4 byte big endian value. */
+				if (subsection.len == 4) {
+					fw->have_crc = true;
+					fw->crc = (uint32_t)subsection.data[0] << 24 |
+						(uint32_t)subsection.data[1] << 16 |
+						(uint32_t)subsection.data[2] << 8 |
+						(uint32_t)subsection.data[3];
+				}
+				break;
+			case FW_IMAGE_SECTION_MAGIC_ED25519:
+				/* Ed25519 signature must be exactly 64 bytes long,
+				 * it is invalid itherwise. */
+				if (subsection.len == 64) {
+					fw->have_signature = true;
+					fw->signature = subsection.data;
+				}
+				break;
+			case FW_IMAGE_SECTION_MAGIC_FP:
+				/* Public key fingerprint must be at least 4 bytes long */
+				if (subsection.len >= 4) {
+					fw->have_pubkey_fp = true;
+					fw->pubkey_fp = subsection.data;
+					fw->pubkey_fp_len = subsection.len;
+				}
+				break;
+			default:
+				/* Do nothing for unknown (but otherwise valid) sections. */
+				break;
+		}
+	}
+
+	return FW_IMAGE_PARSE_VERIFICATION_OK;
 }
 
 
@@ -269,6 +1100,7 @@ int32_t fw_image_parse(struct fw_image *fw) {
 
 	/* Parse all subsections in the verified section. */
 	fw->have_firmware = false;
+	fw->have_version = false;
 	section_base = fw->verified_section.data;
 	section_end = section_base + fw->verified_section.len;
 	while (section_base < section_end) {
@@ -285,6 +1117,17 @@ int32_t fw_image_parse(struct fw_image *fw) {
 				fw->offset = subsection.data - fw->base;
 				u_log(system_log, LOG_TYPE_INFO, "fw_image: firmware vector table found at 0x%08x", subsection.data);
 				break;
+			case FW_IMAGE_SECTION_MAGIC_METADATA: {
+				uint32_t len = subsection.len;
+				if (len > FW_IMAGE_VERSION_LEN - 1) {
+					len = FW_IMAGE_VERSION_LEN - 1;
+				}
+				memcpy(fw->version, subsection.data, len);
+				fw->version[len] = '\0';
+				fw->have_version = true;
+				u_log(system_log, LOG_TYPE_INFO, "fw_image: firmware version %s", fw->version);
+				break;
+			}
 			default:
 				/* Do nothing for unknown (but otherwise valid) sections. */
 				break;
@@ -293,46 +1136,9 @@ int32_t fw_image_parse(struct fw_image *fw) {
 	}
 
 	/* Parse all subsections in the verification section. */
-	fw->have_hash = false;
-	section_base = fw->verification_section.data;
-	section_end = section_base + fw->verification_section.len;
-	while (section_base < section_end) {
-		struct fw_image_section subsection;
-		if (fw_image_parse_section(fw, &section_base, &subsection) != FW_IMAGE_PARSE_SECTION_OK) {
-			parse_ok = false;
-			goto end;
-		}
-		switch (subsection.magic) {
-			case FW_IMAGE_SECTION_MAGIC_DUMMY:
-				break;
-			case FW_IMAGE_SECTION_MAGIC_SHA512:
-				/* SHA512 hash must be exactly 64 bytes long. */
-				if (subsection.len == 64) {
-					fw->have_hash = true;
-					fw->hash = subsection.data;
-					fw->hash_type = FW_IMAGE_SECTION_HASH_SHA512;
-				}
-				break;
-			case FW_IMAGE_SECTION_MAGIC_ED25519:
-				/* Ed25519 signature must be exactly 64 bytes long,
-				 * it is invalid itherwise. */
-				if (subsection.len == 64) {
-					fw->have_signature = true;
-					fw->signature = subsection.data;
-				}
-				break;
-			case FW_IMAGE_SECTION_MAGIC_FP:
-				/* Public key fingerprint must be at least 4 bytes long */
-				if (subsection.len >= 4) {
-					fw->have_pubkey_fp = true;
-					fw->pubkey_fp = subsection.data;
-					fw->pubkey_fp_len = subsection.len;
-				}
-				break;
-			default:
-				/* Do nothing for unknown (but otherwise valid) sections. */
-				break;
-		}
+	if (fw_image_parse_verification(fw) != FW_IMAGE_PARSE_VERIFICATION_OK) {
+		parse_ok = false;
+		goto end;
 	}
 
 end:
@@ -348,6 +1154,27 @@ end:
 }
 
 
+int32_t fw_image_crc_check(struct fw_image *fw) {
+	if (u_assert(fw != NULL) ||
+	    u_assert(fw->parsed == true)) {
+		return FW_IMAGE_CRC_CHECK_FAILED;
+	}
+
+	if (fw->have_crc == false) {
+		return FW_IMAGE_CRC_CHECK_MISSING;
+	}
+
+	uint32_t crc = 0;
+	crc32_compute(fw->verified_section.data, fw->verified_section.len, &crc);
+	if (crc != fw->crc) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: firmware CRC mismatch (0x%08x, expected 0x%08x)", crc, fw->crc);
+		return FW_IMAGE_CRC_CHECK_FAILED;
+	}
+
+	return FW_IMAGE_CRC_CHECK_OK;
+}
+
+
 int32_t fw_image_verify(struct fw_image *fw) {
 	if (u_assert(fw != NULL)) {
 		return FW_IMAGE_VERIFY_FAILED;
@@ -366,9 +1193,21 @@ int32_t fw_image_verify(struct fw_image *fw) {
 		return FW_IMAGE_VERIFY_FAILED;
 	}
 
+	/* Reject corrupted images quickly if a CRC is available. */
+	if (fw_image_crc_check(fw) == FW_IMAGE_CRC_CHECK_FAILED) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: firmware verification failed");
+		fw->verified = false;
+		return FW_IMAGE_VERIFY_FAILED;
+	}
+
 	u_log(system_log, LOG_TYPE_INFO, "fw_image: verifying firmware integrity...");
-	if (fw_image_hash_compare(&main_fw, fw->verified_section.data, fw->verified_section.len, fw->hash) == FW_IMAGE_HASH_COMPARE_OK) {
-		u_log(system_log, LOG_TYPE_INFO, "fw_image: firmware verification OK");
+	uint32_t start = systick_counter;
+	if (fw_image_hash_compare(fw, fw->verified_section.data, fw->verified_section.len, fw->hash) == FW_IMAGE_HASH_COMPARE_OK) {
+		u_log(system_log, LOG_TYPE_INFO,
+			"fw_image: firmware verification OK (%u bytes in %u ms)",
+			fw->verified_section.len,
+			systick_counter - start
+		);
 		fw->verified = true;
 		return FW_IMAGE_VERIFY_OK;
 	} else {
@@ -421,7 +1260,8 @@ int32_t fw_image_authenticate(struct fw_image *fw) {
 	/* TODO: handle fingerprint conflict. */
 	/* TODO: check if the key is valid for this type of signature. */
 	uint8_t pubkey[PUBKEY_STORAGE_SLOT_SIZE];
-	if (pubkey_storage_get_slot_key_by_fp(fw->pubkey_fp, pubkey, sizeof(pubkey)) != PUBKEY_STORAGE_GET_SLOT_KEY_BY_FP_OK) {
+	struct ed25519_pt point;
+	if (pubkey_storage_get_slot_point_by_fp(fw->pubkey_fp, pubkey, &point) != PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_OK) {
 		u_log(system_log, LOG_TYPE_CRIT,
 			"fw_image: no matching public key found for fingerprint 0x%02x%02x%02x%02x",
 			fw->pubkey_fp[0],
@@ -433,8 +1273,8 @@ int32_t fw_image_authenticate(struct fw_image *fw) {
 		return FW_IMAGE_AUTHENTICATE_FAILED;
 	}
 
-	/* TODO: determine hash size by its type */
-	if (edsign_verify(fw->signature, pubkey, fw->hash, 64)) {
+	/* The signature is made over the image hash. The key is already unpacked. */
+	if (edsign_verify_point(fw->signature, pubkey, &point, fw->hash, fw->hash_len)) {
 		u_log(system_log, LOG_TYPE_INFO, "fw_image: firmware authentication OK");
 		fw->authenticated = true;
 		return FW_IMAGE_AUTHENTICATE_OK;
@@ -452,8 +1292,8 @@ int32_t fw_image_get_size(struct fw_image *fw, uint32_t *size) {
 	}
 
 	/* Firmware image must be parsed first. */
-	if (main_fw.parsed == false) {
-		if (fw_image_parse(&main_fw) != FW_IMAGE_PARSE_OK) {
+	if (fw->parsed == false) {
+		if (fw_image_parse(fw) != FW_IMAGE_PARSE_OK) {
 			return FW_IMAGE_GET_SIZE_FAILED;
 		}
 	}
@@ -463,21 +1303,75 @@ int32_t fw_image_get_size(struct fw_image *fw, uint32_t *size) {
 }
 
 
+/**
+ * Check if the file already contains the image of size @a size. The file
+ * size and the verification section (holding the hash of the verified
+ * section) are compared first. If they match, the file is verified to
+ * detect corrupted contents of the verified section.
+ */
+static bool fw_image_file_matches(struct fw_image *fw, struct sffs *fs, const char *fname, uint32_t size) {
+	if (fw->have_hash == false) {
+		return false;
+	}
+
+	struct sffs_file f;
+	if (sffs_open(fs, &f, fname, SFFS_READ) != SFFS_OPEN_OK) {
+		return false;
+	}
+
+	bool match = false;
+	uint32_t file_size = 0;
+	uint32_t offset = fw->verified_section.len + 8;
+	if (sffs_file_size(fs, &f, &file_size) == SFFS_FILE_SIZE_OK && file_size == size &&
+	    sffs_seek(&f, offset) == SFFS_SEEK_OK) {
+		match = true;
+		uint8_t buf[64];
+		while (offset < size) {
+			uint32_t len = sizeof(buf);
+			if ((size - offset) < len) {
+				len = size - offset;
+			}
+			if (sffs_read(&f, buf, len) != (int32_t)len || memcmp(buf, (uint8_t *)fw->base + offset, len)) {
+				match = false;
+				break;
+			}
+			offset += len;
+		}
+	}
+	sffs_close(&f);
+
+	if (match && fw_image_verify_file(fw, fs, fname) != FW_IMAGE_VERIFY_FILE_OK) {
+		u_log(system_log, LOG_TYPE_WARN, "fw_image: file %s is corrupted", fname);
+		match = false;
+	}
+
+	return match;
+}
+
+
 int32_t fw_image_dump_file(struct fw_image *fw, struct sffs *fs, const char *fname) {
 	if (u_assert(fw != NULL && fs != NULL && fname != NULL)) {
 		return FW_IMAGE_DUMP_FILE_FAILED;
 	}
 
 	/* Firmware image must be parsed first. */
-	if (main_fw.parsed == false) {
-		if (fw_image_parse(&main_fw) != FW_IMAGE_PARSE_OK) {
+	if (fw->parsed == false) {
+		if (fw_image_parse(fw) != FW_IMAGE_PARSE_OK) {
 			return FW_IMAGE_DUMP_FILE_FAILED;
 		}
 	}
 	uint32_t size = 0;
-	fw_image_get_size(&main_fw, &size);
+	fw_image_get_size(fw, &size);
+
+	/* Rewriting the file is slow, skip it if it is up to date already
+	 * (eg. after a failed update). */
+	if (fw_image_file_matches(fw, fs, fname, size)) {
+		u_log(system_log, LOG_TYPE_INFO, "fw_image: file %s already contains the current firmware", fname);
+		return FW_IMAGE_DUMP_FILE_OK;
+	}
 
 	/* Prepare the output file. */
+	fw_catalogue_invalidate(fs, fname);
 	struct sffs_file f;
 	if (sffs_open(fs, &f, fname, SFFS_OVERWRITE) != SFFS_OPEN_OK) {
 		return FW_IMAGE_DUMP_FILE_FAILED;
@@ -519,14 +1413,79 @@ int32_t fw_image_dump_file(struct fw_image *fw, struct sffs *fs, const char *fna
 }
 
 
-int32_t fw_image_program_file(struct fw_image *fw, struct sffs *fs, const char *fname) {
-	if (u_assert(fw != NULL && fs != NULL && fname != NULL)) {
-		return FW_IMAGE_PROGRAM_FILE_FAILED;
+/**
+ * Double buffered file reader. The next block is being transferred from the
+ * SPI flash (using DMA) while the current one is hashed or programmed.
+ * Buffers are shared, only one reader can be used at a time.
+ */
+#define FW_IMAGE_FILE_BLOCK_SIZE 256
+static uint8_t fw_image_file_reader_buf[2][FW_IMAGE_FILE_BLOCK_SIZE];
+
+struct fw_image_file_reader {
+	struct sffs_file *f;
+	uint32_t cur;
+	int32_t next;
+	uint32_t rem;
+};
+static struct fw_image_file_reader fw_image_file_reader;
+
+static void fw_image_file_reader_start(struct fw_image_file_reader *r, struct sffs_file *f, uint32_t len) {
+	r->f = f;
+	r->cur = 0;
+	r->rem = len;
+	r->next = 0;
+	if (len > 0) {
+		r->next = sffs_read_start(f, fw_image_file_reader_buf[0], (len > FW_IMAGE_FILE_BLOCK_SIZE) ? FW_IMAGE_FILE_BLOCK_SIZE : len);
+	}
+}
+
+
+/**
+ * Get the next block of data. It is valid until the next call. Returns the
+ * block length, 0 if all requested data were read or -1 on error.
+ */
+static int32_t fw_image_file_reader_get(struct fw_image_file_reader *r, uint8_t **data) {
+	if (r->rem == 0) {
+		return 0;
+	}
+	if (r->next <= 0 || sffs_read_wait(r->f) != SFFS_READ_WAIT_OK) {
+		return -1;
+	}
+
+	int32_t len = r->next;
+	*data = fw_image_file_reader_buf[r->cur];
+	r->rem -= len;
+
+	/* Start the next transfer to the other buffer. */
+	r->cur ^= 1;
+	r->next = 0;
+	if (r->rem > 0) {
+		r->next = sffs_read_start(r->f, fw_image_file_reader_buf[r->cur], (r->rem > FW_IMAGE_FILE_BLOCK_SIZE) ? FW_IMAGE_FILE_BLOCK_SIZE : r->rem);
 	}
 
+	return len;
+}
+
+
+/**
+ * The reader must be stopped before the file is closed or another reader is
+ * started, a transfer may still be running.
+ */
+static void fw_image_file_reader_stop(struct fw_image_file_reader *r) {
+	sffs_read_wait(r->f);
+}
+
+
+/**
+ * Stream the file through a programming session. In the compare mode the
+ * session is only used to compare the image with the flash contents.
+ */
+#define FW_IMAGE_PROGRAM_FILE_PASS_OK 0
+#define FW_IMAGE_PROGRAM_FILE_PASS_FAILED -1
+static int32_t fw_image_program_file_pass(struct fw_image *fw, struct sffs *fs, const char *fname, bool compare, uint32_t keep) {
 	struct sffs_file f;
 	if (sffs_open(fs, &f, fname, SFFS_READ) != SFFS_OPEN_OK) {
-		return FW_IMAGE_PROGRAM_FILE_FAILED;
+		return FW_IMAGE_PROGRAM_FILE_PASS_FAILED;
 	}
 
 	uint32_t size = 0;
@@ -535,30 +1494,429 @@ int32_t fw_image_program_file(struct fw_image *fw, struct sffs *fs, const char *
 	if (fw->progress_callback != NULL) {
 		fw->progress_callback(0, size, fw->progress_callback_ctx);
 	}
-	u_assert(fw->progress_callback != NULL);
+	fw_image_program_begin(fw, fs);
+	fw->program_compare = compare;
+	fw->program_keep = keep;
 	int32_t len = 0;
 	uint32_t offset = 0;
 	uint32_t update = 0;
-	uint8_t buf[128];
-	while ((len = sffs_read(&f, buf, sizeof(buf))) > 0) {
-		fw_image_program(fw, offset, buf, len);
+	struct fw_image_file_reader *reader = &fw_image_file_reader;
+	fw_image_file_reader_start(reader, &f, size);
+	uint8_t *buf = NULL;
+	while ((len = fw_image_file_reader_get(reader, &buf)) > 0) {
+		if (fw_image_program_stream(fw, buf, len) != FW_IMAGE_PROGRAM_STREAM_OK) {
+			break;
+		}
 		offset += len;
 		update += len;
 
 		if (update >= 1024) {
-			u_assert(fw->progress_callback != NULL);
 			if (fw->progress_callback != NULL) {
 				fw->progress_callback(offset, size, fw->progress_callback_ctx);
 			}
 			update = 0;
 		}
 	}
+	fw_image_file_reader_stop(reader);
 	if (fw->progress_callback != NULL) {
 		fw->progress_callback(size, size, fw->progress_callback_ctx);
 	}
 	sffs_close(&f);
-	fw_image_init(fw, fw->base, fw->base_sector, fw->sectors);
+
+	if (compare) {
+		fw->program_session = false;
+		flash_lock();
+		if (fw->program_failed || offset != size) {
+			return FW_IMAGE_PROGRAM_FILE_PASS_FAILED;
+		}
+		return FW_IMAGE_PROGRAM_FILE_PASS_OK;
+	}
+
+	if (fw_image_program_end(fw) == FW_IMAGE_PROGRAM_END_FAILED) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: programming firmware from file %s failed", fname);
+		return FW_IMAGE_PROGRAM_FILE_PASS_FAILED;
+	}
 	u_log(system_log, LOG_TYPE_INFO, "fw_image: programmed firmware from file %s (size %u bytes)", fname, size);
 
+	return FW_IMAGE_PROGRAM_FILE_PASS_OK;
+}
+
+
+int32_t fw_image_program_file(struct fw_image *fw, struct sffs *fs, const char *fname) {
+	if (u_assert(fw != NULL && fs != NULL && fname != NULL)) {
+		return FW_IMAGE_PROGRAM_FILE_FAILED;
+	}
+
+	if (fw_image_program_file_pass(fw, fs, fname, false, 0) != FW_IMAGE_PROGRAM_FILE_PASS_OK) {
+		return FW_IMAGE_PROGRAM_FILE_FAILED;
+	}
+
 	return FW_IMAGE_PROGRAM_FILE_OK;
 }
+
+
+int32_t fw_image_program_file_diff(struct fw_image *fw, struct sffs *fs, const char *fname) {
+	if (u_assert(fw != NULL && fs != NULL && fname != NULL)) {
+		return FW_IMAGE_PROGRAM_FILE_DIFF_FAILED;
+	}
+
+	/* Find sectors with changed contents first. If the comparison
+	 * fails, all sectors are programmed. */
+	uint32_t keep = 0;
+	u_log(system_log, LOG_TYPE_INFO, "fw_image: comparing firmware file %s with the current image", fname);
+	if (fw_image_program_file_pass(fw, fs, fname, true, 0) == FW_IMAGE_PROGRAM_FILE_PASS_OK) {
+		keep = ~fw->program_changed;
+		uint32_t changed = 0;
+		for (uint32_t i = 0; i < fw->sectors; i++) {
+			if (fw->program_changed & (1UL << i)) {
+				changed++;
+			}
+		}
+		u_log(system_log, LOG_TYPE_INFO, "fw_image: %u of %u sectors changed", changed, fw->sectors);
+	}
+
+	if (fw_image_program_file_pass(fw, fs, fname, false, keep) != FW_IMAGE_PROGRAM_FILE_PASS_OK) {
+		return FW_IMAGE_PROGRAM_FILE_DIFF_FAILED;
+	}
+
+	return FW_IMAGE_PROGRAM_FILE_DIFF_OK;
+}
+
+
+/**
+ * Maximum size of the verification section of a firmware image loaded from
+ * a file. It is read to the memory as a whole.
+ */
+#define FW_IMAGE_FILE_VERIFICATION_MAX 512
+
+/* Firmware files are checked using a scratch image, they are too big for
+ * the stack. Only one file can be checked at a time. */
+static struct fw_image fw_image_file_fw;
+static uint8_t fw_image_file_verification[FW_IMAGE_FILE_VERIFICATION_MAX];
+
+#define FW_IMAGE_FILE_READ_HEADER_OK 0
+#define FW_IMAGE_FILE_READ_HEADER_FAILED -1
+static int32_t fw_image_file_read_header(struct fw_image *fw, struct sffs_file *f, uint32_t pos, struct fw_image_section *section) {
+	uint8_t header[8];
+	uint8_t *section_base = header;
+
+	if (sffs_seek(f, pos) != SFFS_SEEK_OK ||
+	    sffs_read(f, header, sizeof(header)) != sizeof(header)) {
+		return FW_IMAGE_FILE_READ_HEADER_FAILED;
+	}
+	fw_image_parse_section(fw, &section_base, section);
+	section->data = NULL;
+
+	return FW_IMAGE_FILE_READ_HEADER_OK;
+}
+
+
+/**
+ * The verified section of a firmware file is streamed through this sink
+ * (directly or from the decompressor). Section headers are parsed on the
+ * fly and the section data is hashed.
+ */
+struct fw_image_file_sink {
+	struct fw_image *fw;
+	struct fw_image_hash hash;
+
+	/* Number of bytes received so far. */
+	uint32_t pos;
+
+	/* Position and buffer of the next section header. */
+	uint32_t header_pos;
+	uint8_t header[8];
+
+	bool have_section;
+	uint32_t end;
+
+	/* Part of the metadata section data copied to the image version. */
+	uint32_t version_pos;
+	uint32_t version_end;
+};
+static struct fw_image_file_sink fw_image_file_sink;
+
+static int32_t fw_image_file_sink_output(const uint8_t *data, uint32_t len, void *ctx) {
+	struct fw_image_file_sink *sink = (struct fw_image_file_sink *)ctx;
+	struct fw_image *fw = sink->fw;
+
+	while (len > 0) {
+		/* Nothing is allowed after the verified section. */
+		if (sink->have_section && sink->pos >= sink->end) {
+			return LZ4_STREAM_OUTPUT_FAILED;
+		}
+
+		uint32_t n = len;
+		if (sink->have_section && n > sink->end - sink->pos) {
+			n = sink->end - sink->pos;
+		}
+		if (sink->pos < sink->header_pos && n > sink->header_pos - sink->pos) {
+			n = sink->header_pos - sink->pos;
+		}
+
+		/* Collect the next section header if it is there. */
+		if (sink->pos >= sink->header_pos && sink->pos < sink->header_pos + 8) {
+			uint32_t h = sink->header_pos + 8 - sink->pos;
+			if (n > h) {
+				n = h;
+			}
+			memcpy(sink->header + (sink->pos - sink->header_pos), data, n);
+
+			if (sink->pos + n == sink->header_pos + 8) {
+				struct fw_image_section section;
+				uint8_t *section_base = sink->header;
+				fw_image_parse_section(fw, &section_base, &section);
+
+				if (sink->have_section == false) {
+					/* The top level verified section header. */
+					if (section.magic != FW_IMAGE_SECTION_MAGIC_VERIFIED ||
+					    section.len > UINT32_MAX - 8) {
+						return LZ4_STREAM_OUTPUT_FAILED;
+					}
+					fw->verified_section.magic = section.magic;
+					fw->verified_section.len = section.len;
+					sink->have_section = true;
+					sink->end = 8 + section.len;
+					sink->header_pos = 8;
+				} else {
+					/* A subsection of the verified section. */
+					if (section.len > sink->end - sink->header_pos - 8) {
+						return LZ4_STREAM_OUTPUT_FAILED;
+					}
+					if (section.magic == FW_IMAGE_SECTION_MAGIC_FIRMWARE) {
+						fw->have_firmware = true;
+						fw->offset = sink->header_pos + 8;
+					}
+					if (section.magic == FW_IMAGE_SECTION_MAGIC_METADATA) {
+						uint32_t v = section.len;
+						if (v > FW_IMAGE_VERSION_LEN - 1) {
+							v = FW_IMAGE_VERSION_LEN - 1;
+						}
+						memset(fw->version, 0, sizeof(fw->version));
+						fw->have_version = true;
+						sink->version_pos = sink->header_pos + 8;
+						sink->version_end = sink->version_pos + v;
+					}
+					sink->header_pos += 8 + section.len;
+				}
+			}
+		}
+
+		if (sink->pos >= sink->version_pos && sink->pos < sink->version_end) {
+			uint32_t v = sink->version_end - sink->pos;
+			if (v > n) {
+				v = n;
+			}
+			memcpy(fw->version + (sink->pos - sink->version_pos), data, v);
+		}
+
+		/* Everything after the top level header is hashed. */
+		if (sink->pos >= 8) {
+			fw_image_hash_update(&sink->hash, data, n);
+		}
+
+		sink->pos += n;
+		data += n;
+		len -= n;
+	}
+
+	return LZ4_STREAM_OUTPUT_OK;
+}
+
+
+/**
+ * Parse and verify a firmware image saved in a file. Only the verification
+ * section is loaded to the fw_image_file_verification buffer, the verified
+ * section is hashed directly from the file (and decoded if required).
+ * Pointers in @a fw (hash, signature, fingerprint) point to the buffer.
+ */
+#define FW_IMAGE_FILE_CHECK_OK 0
+#define FW_IMAGE_FILE_CHECK_FAILED -1
+static int32_t fw_image_file_check(struct fw_image *fw, struct sffs *fs, const char *fname) {
+	uint8_t *verification = fw_image_file_verification;
+
+	struct sffs_file f;
+	if (sffs_open(fs, &f, fname, SFFS_READ) != SFFS_OPEN_OK) {
+		u_log(system_log, LOG_TYPE_ERROR, "fw_image: cannot open firmware file %s", fname);
+		return FW_IMAGE_FILE_CHECK_FAILED;
+	}
+	uint32_t size = 0;
+	sffs_file_size(fs, &f, &size);
+
+	u_log(system_log, LOG_TYPE_INFO, "fw_image: parsing firmware file %s...", fname);
+
+	/* Chunk table of a chunked image is skipped, the whole image is
+	 * hashed here anyway. */
+	struct fw_image_section first;
+	uint32_t start = 0;
+	if (size >= 8 &&
+	    fw_image_file_read_header(fw, &f, 0, &first) == FW_IMAGE_FILE_READ_HEADER_OK &&
+	    first.magic == FW_IMAGE_SECTION_MAGIC_CHUNKS &&
+	    first.len <= size - 8) {
+		start = 8 + first.len;
+	}
+
+	/* The first section is either the verified section or its compressed
+	 * or delta version. The verification section follows. */
+	if (size - start < 16 ||
+	    fw_image_file_read_header(fw, &f, start, &first) != FW_IMAGE_FILE_READ_HEADER_OK ||
+	    (first.magic != FW_IMAGE_SECTION_MAGIC_VERIFIED &&
+	     first.magic != FW_IMAGE_SECTION_MAGIC_COMPRESSED &&
+	     first.magic != FW_IMAGE_SECTION_MAGIC_DELTA) ||
+	    first.len > size - start - 16 ||
+	    fw_image_file_read_header(fw, &f, start + 8 + first.len, &fw->verification_section) != FW_IMAGE_FILE_READ_HEADER_OK ||
+	    fw->verification_section.magic != FW_IMAGE_SECTION_MAGIC_VERIFICATION ||
+	    fw->verification_section.len > FW_IMAGE_FILE_VERIFICATION_MAX ||
+	    fw->verification_section.len > size - start - 16 - first.len) {
+		goto parse_failed;
+	}
+
+	/* Load and parse the verification section. */
+	fw->verification_section.data = verification;
+	if (sffs_seek(&f, start + 16 + first.len) != SFFS_SEEK_OK ||
+	    sffs_read(&f, verification, fw->verification_section.len) != (int32_t)fw->verification_section.len ||
+	    fw_image_parse_verification(fw) != FW_IMAGE_PARSE_VERIFICATION_OK) {
+		goto parse_failed;
+	}
+
+	if (fw->have_hash == false) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: verify: no known firmware hash available");
+		sffs_close(&f);
+		return FW_IMAGE_FILE_CHECK_FAILED;
+	}
+
+	/* Stream the verified section through the sink-> */
+	u_log(system_log, LOG_TYPE_INFO, "fw_image: verifying firmware file integrity...");
+	struct fw_image_file_sink *sink = &fw_image_file_sink;
+	memset(sink, 0, sizeof(struct fw_image_file_sink));
+	sink->fw = fw;
+	fw_image_hash_init(&sink->hash, fw->hash_type);
+
+	bool encoded = (first.magic != FW_IMAGE_SECTION_MAGIC_VERIFIED);
+	uint32_t len = encoded ? first.len : (8 + first.len);
+	if (encoded && fw_image_decode_begin(first.magic, fs, fw_image_file_sink_output, (void *)sink) != FW_IMAGE_DECODE_BEGIN_OK) {
+		goto parse_failed;
+	}
+	sffs_seek(&f, start + (encoded ? 8 : 0));
+
+	if (fw->progress_callback != NULL) {
+		fw->progress_callback(0, len, fw->progress_callback_ctx);
+	}
+	uint32_t rem = len;
+	uint32_t update = 0;
+	struct fw_image_file_reader *reader = &fw_image_file_reader;
+	fw_image_file_reader_start(reader, &f, len);
+	while (rem > 0) {
+		uint8_t *buf = NULL;
+		int32_t chunk = fw_image_file_reader_get(reader, &buf);
+		if (chunk <= 0) {
+			if (encoded) {
+				fw_image_decode_finish(first.magic);
+			}
+			goto parse_failed;
+		}
+		if (encoded) {
+			if (fw_image_decode_feed(first.magic, buf, chunk) != FW_IMAGE_DECODE_FEED_OK) {
+				goto parse_failed;
+			}
+		} else {
+			if (fw_image_file_sink_output(buf, chunk, (void *)sink) != LZ4_STREAM_OUTPUT_OK) {
+				goto parse_failed;
+			}
+		}
+		rem -= chunk;
+
+		update += chunk;
+		if (update >= 4096 && fw->progress_callback != NULL) {
+			fw->progress_callback(len - rem, len, fw->progress_callback_ctx);
+			update = 0;
+		}
+	}
+	if (encoded && fw_image_decode_finish(first.magic) != FW_IMAGE_DECODE_FINISH_OK) {
+		goto parse_failed;
+	}
+	if (fw->progress_callback != NULL) {
+		fw->progress_callback(len, len, fw->progress_callback_ctx);
+	}
+	fw_image_file_reader_stop(reader);
+	sffs_close(&f);
+
+	/* The whole verified section must be there and its subsections
+	 * must end exactly at its end. */
+	if (sink->have_section == false || sink->pos != sink->end || sink->header_pos != sink->end) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: firmware file structure check & parsing failed");
+		return FW_IMAGE_FILE_CHECK_FAILED;
+	}
+	fw->parsed = true;
+
+	uint8_t computed_hash[FW_IMAGE_HASH_MAX_SIZE];
+	fw_image_hash_final(&sink->hash, computed_hash, fw->hash_len);
+	if (memcmp(computed_hash, fw->hash, fw->hash_len)) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: firmware file verification failed");
+		return FW_IMAGE_FILE_CHECK_FAILED;
+	}
+
+	u_log(system_log, LOG_TYPE_INFO, "fw_image: firmware file verification OK");
+	fw->verified = true;
+	return FW_IMAGE_FILE_CHECK_OK;
+
+parse_failed:
+	u_log(system_log, LOG_TYPE_CRIT, "fw_image: firmware file structure check & parsing failed");
+	/* A read to the reader buffers may still be running. */
+	sffs_read_wait(&f);
+	sffs_close(&f);
+	return FW_IMAGE_FILE_CHECK_FAILED;
+}
+
+
+int32_t fw_image_verify_file(struct fw_image *fw, struct sffs *fs, const char *fname) {
+	if (u_assert(fw != NULL && fs != NULL && fname != NULL)) {
+		return FW_IMAGE_VERIFY_FILE_FAILED;
+	}
+
+	/* Use a scratch image, @a fw is used only for the progress callback. */
+	struct fw_image *file_fw = &fw_image_file_fw;
+	fw_image_init(file_fw, NULL, 0, 0);
+	file_fw->progress_callback = fw->progress_callback;
+	file_fw->progress_callback_ctx = fw->progress_callback_ctx;
+
+	if (fw_image_file_check(file_fw, fs, fname) != FW_IMAGE_FILE_CHECK_OK) {
+		fw_catalogue_update(fs, fname, file_fw, FW_CATALOGUE_STATUS_INVALID);
+		return FW_IMAGE_VERIFY_FILE_FAILED;
+	}
+	fw_catalogue_update(fs, fname, file_fw, FW_CATALOGUE_STATUS_VERIFIED);
+
+	return FW_IMAGE_VERIFY_FILE_OK;
+}
+
+
+int32_t fw_image_authenticate_file(struct fw_image *fw, struct sffs *fs, const char *fname) {
+	if (u_assert(fw != NULL && fs != NULL && fname != NULL)) {
+		return FW_IMAGE_AUTHENTICATE_FILE_FAILED;
+	}
+
+	struct fw_image *file_fw = &fw_image_file_fw;
+	fw_image_init(file_fw, NULL, 0, 0);
+	file_fw->progress_callback = fw->progress_callback;
+	file_fw->progress_callback_ctx = fw->progress_callback_ctx;
+
+	if (fw_image_file_check(file_fw, fs, fname) != FW_IMAGE_FILE_CHECK_OK) {
+		fw_catalogue_update(fs, fname, file_fw, FW_CATALOGUE_STATUS_INVALID);
+		return FW_IMAGE_AUTHENTICATE_FILE_FAILED;
+	}
+
+	/* The image is parsed and verified, only the signature is checked. */
+	if (fw_image_authenticate(file_fw) != FW_IMAGE_AUTHENTICATE_OK) {
+		fw_catalogue_update(fs, fname, file_fw, FW_CATALOGUE_STATUS_VERIFIED);
+		return FW_IMAGE_AUTHENTICATE_FILE_FAILED;
+	}
+
+	if (file_fw->have_firmware == false) {
+		u_log(system_log, LOG_TYPE_CRIT, "fw_image: no firmware section found in file %s", fname);
+		fw_catalogue_update(fs, fname, file_fw, FW_CATALOGUE_STATUS_INVALID);
+		return FW_IMAGE_AUTHENTICATE_FILE_FAILED;
+	}
+	fw_catalogue_update(fs, fname, file_fw, FW_CATALOGUE_STATUS_AUTHENTICATED);
+
+	return FW_IMAGE_AUTHENTICATE_FILE_OK;
+}
@@ -25,6 +25,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "sha512.h"
+#include "sha256.h"
+#include "blake2s.h"
+
 /**
  * Section magic numbers (tag) as they appear in the firmware conversion
  * tool (createfw.py). They were chosen randomly.
@@ -36,12 +40,70 @@
 #define FW_IMAGE_SECTION_MAGIC_SHA512 0xb6eb9721
 #define FW_IMAGE_SECTION_MAGIC_ED25519 0x9d6b1a99
 #define FW_IMAGE_SECTION_MAGIC_FP 0x5bf0aa39
+#define FW_IMAGE_SECTION_MAGIC_CRC32 0x2c4a7d13
+#define FW_IMAGE_SECTION_MAGIC_SHA256 0x3f5e2a81
+#define FW_IMAGE_SECTION_MAGIC_BLAKE2S 0x71c6d0e4
+
+/**
+ * Metadata section can be placed in the verified section before the
+ * firmware section. It contains the image version (build ID) as a string
+ * without the terminating zero, longer strings are truncated.
+ */
+#define FW_IMAGE_SECTION_MAGIC_METADATA 0x6a19c3e2
+#define FW_IMAGE_VERSION_LEN 32
+
+/**
+ * Compressed section can replace the verified section in firmware files and
+ * transfers. It contains the whole verified section (including its header)
+ * compressed as a LZ4 block, it is decompressed during programming.
+ */
+#define FW_IMAGE_SECTION_MAGIC_COMPRESSED 0x8c2f5b61
+
+/**
+ * Delta section can replace the verified section too. It contains a binary
+ * patch which recreates the whole verified section (including its header)
+ * from a base image saved in the FW_IMAGE_DELTA_BASE_FILE (the backup of
+ * the current firmware). See delta_stream.h for the format.
+ */
+#define FW_IMAGE_SECTION_MAGIC_DELTA 0x5d3e8a27
+#define FW_IMAGE_DELTA_BASE_FILE "backup.fw"
+
+/**
+ * Chunks section can precede the image in firmware files and transfers. It
+ * contains hashes of fixed size chunks of the rest of the image which are
+ * checked as soon as each chunk is received (see chunk_stream.h). It is not
+ * programmed, the image is still verified and authenticated as a whole.
+ */
+#define FW_IMAGE_SECTION_MAGIC_CHUNKS 0x27c4e9b5
 
 /**
  * Type of hash digest available in the firmware image.
  */
 enum fw_image_section_hash {
 	FW_IMAGE_SECTION_HASH_SHA512,
+	FW_IMAGE_SECTION_HASH_SHA256,
+	FW_IMAGE_SECTION_HASH_BLAKE2S,
+};
+#define FW_IMAGE_HASH_TYPES 3
+#define FW_IMAGE_HASH_MAX_SIZE SHA512_HASH_SIZE
+
+/**
+ * Incremental hash context. Data can be fed in chunks of arbitrary length,
+ * they are collected in the block buffer until a whole hash block is
+ * available. The last block is always kept in the buffer until more data
+ * arrive (BLAKE2s needs to know which block is the last one).
+ */
+struct fw_image_hash {
+	enum fw_image_section_hash type;
+	union {
+		struct sha512_state sha512;
+		struct sha256_state sha256;
+		struct blake2s_state blake2s;
+	} state;
+	uint8_t block[SHA512_BLOCK_SIZE];
+	uint32_t block_size;
+	uint32_t block_len;
+	uint32_t total;
 };
 
 /**
@@ -77,6 +139,13 @@ struct fw_image {
 	bool have_firmware;
 	uint32_t offset;
 
+	/**
+	 * Set if a metadata section was found. Version is always zero
+	 * terminated.
+	 */
+	bool have_version;
+	char version[FW_IMAGE_VERSION_LEN];
+
 	/**
 	 * Progress callback is used for all actions on the firmware image which
 	 * can take longer time (erase, program, verify, etc.). If set, it is
@@ -114,8 +183,16 @@ struct fw_image {
 	 */
 	bool have_hash;
 	uint8_t *hash;
+	uint32_t hash_len;
 	enum fw_image_section_hash hash_type;
 
+	/**
+	 * CRC32 of the verified section can be used as a fast integrity
+	 * precheck before the hash is computed.
+	 */
+	bool have_crc;
+	uint32_t crc;
+
 	/**
 	 * Set to true if valid signature section was found.
 	 */
@@ -129,6 +206,50 @@ struct fw_image {
 	bool have_pubkey_fp;
 	uint8_t *pubkey_fp;
 	uint32_t pubkey_fp_len;
+
+	/**
+	 * Programming session state. The verified section is hashed while it
+	 * is being programmed, the image can be verified without reading it
+	 * back again. The hash type is not known until the verification
+	 * section is programmed, all supported hashes are computed (it is
+	 * still much faster than the flash programming itself).
+	 * Program_offset is the offset of the next chunk expected.
+	 * If the chunks are not programmed sequentially, program_hash_valid
+	 * is cleared and the image must be verified the usual way. The hash
+	 * state is also reused by fw_image_hash_compare.
+	 * Sectors are erased on demand during the session, program_erased
+	 * is the length of the area (from the base) erased so far.
+	 * In the compare mode (program_compare) nothing is programmed, chunks
+	 * are compared with the flash contents instead and sectors which
+	 * differ are marked in the program_changed bitmask (bit 0 is the
+	 * base sector). Sectors marked in program_keep are neither erased
+	 * nor programmed, their contents must already be correct.
+	 */
+	bool program_session;
+	bool program_failed;
+	bool program_hash_valid;
+	bool program_have_header;
+	uint32_t program_offset;
+	uint32_t program_erased;
+	bool program_compare;
+	uint32_t program_changed;
+	uint32_t program_keep;
+	struct fw_image_hash program_hash[FW_IMAGE_HASH_TYPES];
+
+	/**
+	 * Stream programming state (fw_image_program_stream). Input data
+	 * are either programmed as they are or decoded first if the image
+	 * starts with a compressed or delta section. Magic and len describe
+	 * this first section. Stream_in counts input bytes, stream_out is
+	 * the offset of the next byte programmed. The delta base image is
+	 * read from the program_fs filesystem.
+	 */
+	struct sffs *program_fs;
+	uint8_t program_stream_header[8];
+	uint32_t program_stream_in;
+	uint32_t program_stream_out;
+	uint32_t program_stream_magic;
+	uint32_t program_stream_len;
 };
 
 
@@ -145,6 +266,21 @@ int32_t fw_image_jump(struct fw_image *fw);
 #define FW_IMAGE_JUMP_OK 0
 #define FW_IMAGE_JUMP_FAILED -1
 
+/**
+ * @brief Check if the firmware is linked for its firmware image area.
+ *
+ * Images are executed in place, an image linked for a different slot would
+ * crash. The reset vector must point inside the image area.
+ *
+ * @param fw A parsed firmware image to check.
+ *
+ * @return FW_IMAGE_CHECK_LOCATION_OK if the image can be executed or
+ *         FW_IMAGE_CHECK_LOCATION_FAILED otherwise.
+ */
+int32_t fw_image_check_location(struct fw_image *fw);
+#define FW_IMAGE_CHECK_LOCATION_OK 0
+#define FW_IMAGE_CHECK_LOCATION_FAILED -1
+
 int32_t fw_image_reset(struct fw_image *fw);
 #define FW_IMAGE_RESET_OK 0
 #define FW_IMAGE_RESET_FAILED -1
@@ -153,6 +289,17 @@ int32_t fw_image_watchdog_enable(struct fw_image *fw, uint32_t period);
 #define FW_IMAGE_WATCHDOG_ENABLE_OK 0
 #define FW_IMAGE_WATCHDOG_ENABLE_FAILED -1
 
+/**
+ * @brief Erase the whole firmware image area.
+ *
+ * Sectors which are already blank are skipped. It is not required before
+ * programming, sectors are erased on demand during the programming session.
+ *
+ * @param fw A firmware image to erase.
+ *
+ * @return FW_IMAGE_ERASE_OK if the area was erased or
+ *         FW_IMAGE_ERASE_FAILED otherwise.
+ */
 int32_t fw_image_erase(struct fw_image *fw);
 #define FW_IMAGE_ERASE_OK 0
 #define FW_IMAGE_ERASE_FAILED -1
@@ -171,10 +318,88 @@ int32_t fw_image_erase(struct fw_image *fw);
  * @return FW_IMAGE_PROGRAM_OK if the page was written successfully or
  *         FW_IMAGE_PROGRAM_FAILED otherwise.
  */
-int32_t fw_image_program(struct fw_image *fw, uint32_t offset, uint8_t *data, uint32_t len);
+int32_t fw_image_program(struct fw_image *fw, uint32_t offset, const uint8_t *data, uint32_t len);
 #define FW_IMAGE_PROGRAM_OK 0
 #define FW_IMAGE_PROGRAM_FAILED -1
 
+/**
+ * @brief Start a firmware image programming session.
+ *
+ * All subsequent chunks must be programmed using fw_image_program_chunk.
+ * The image need not be erased first, sectors are erased (unless already
+ * blank) as soon as they are needed. Sectors after the end of the new image
+ * are left untouched.
+ *
+ * @param fw A firmware image to overwrite.
+ * @param fs Filesystem with the delta base image used if a delta image is
+ *           streamed using fw_image_program_stream. Delta images are refused
+ *           if it is NULL.
+ *
+ * @return FW_IMAGE_PROGRAM_BEGIN_OK if the session was started or
+ *         FW_IMAGE_PROGRAM_BEGIN_FAILED otherwise.
+ */
+int32_t fw_image_program_begin(struct fw_image *fw, struct sffs *fs);
+#define FW_IMAGE_PROGRAM_BEGIN_OK 0
+#define FW_IMAGE_PROGRAM_BEGIN_FAILED -1
+
+/**
+ * @brief Program a chunk of the firmware image within a programming session.
+ *
+ * The chunk is programmed, read back and compared with the source data.
+ * Chunks not fitting in the firmware image area are refused.
+ * If it is part of the verified section, it is fed to the image hash.
+ *
+ * @param fw A firmware image to overwrite.
+ * @param offset Offset of the chunk from the beginning of the image.
+ * @param data Buffer with data.
+ * @param len Length of @a data buffer.
+ *
+ * @return FW_IMAGE_PROGRAM_CHUNK_OK if the chunk was programmed and read back
+ *         successfully or FW_IMAGE_PROGRAM_CHUNK_FAILED otherwise.
+ */
+int32_t fw_image_program_chunk(struct fw_image *fw, uint32_t offset, const uint8_t *data, uint32_t len);
+#define FW_IMAGE_PROGRAM_CHUNK_OK 0
+#define FW_IMAGE_PROGRAM_CHUNK_FAILED -1
+
+/**
+ * @brief Program the next part of a firmware image stream within a programming session.
+ *
+ * Data must be passed sequentially from the beginning of the image. If the
+ * image starts with a compressed or delta section, it is decoded and the
+ * resulting verified section is programmed. Otherwise the data is
+ * programmed as it is. Data passed after the end of the encoded section
+ * (verification section) are programmed right after the decoded data.
+ *
+ * @param fw A firmware image to overwrite.
+ * @param data Buffer with data.
+ * @param len Length of @a data buffer.
+ *
+ * @return FW_IMAGE_PROGRAM_STREAM_OK if the data was processed successfully or
+ *         FW_IMAGE_PROGRAM_STREAM_FAILED otherwise.
+ */
+int32_t fw_image_program_stream(struct fw_image *fw, const uint8_t *data, uint32_t len);
+#define FW_IMAGE_PROGRAM_STREAM_OK 0
+#define FW_IMAGE_PROGRAM_STREAM_FAILED -1
+
+/**
+ * @brief Finish the programming session.
+ *
+ * The programmed image is parsed and the hash computed during the session
+ * is compared with the one contained in the image. The image is marked as
+ * verified if they match.
+ *
+ * @param fw A firmware image.
+ *
+ * @return FW_IMAGE_PROGRAM_END_OK if the image was programmed and verified,
+ *         FW_IMAGE_PROGRAM_END_UNVERIFIED if it was programmed correctly but
+ *         it could not be verified during the session or
+ *         FW_IMAGE_PROGRAM_END_FAILED otherwise.
+ */
+int32_t fw_image_program_end(struct fw_image *fw);
+#define FW_IMAGE_PROGRAM_END_OK 0
+#define FW_IMAGE_PROGRAM_END_FAILED -1
+#define FW_IMAGE_PROGRAM_END_UNVERIFIED -2
+
 int32_t fw_image_set_progress_callback(
 	struct fw_image *fw,
 	int32_t (*progress_callback)(uint32_t progress, uint32_t total, void *ctx),
@@ -186,10 +411,24 @@ int32_t fw_image_set_progress_callback(
 #define FW_IMAGE_PROGRESS_CALLBACK_FAILED -1
 #define FW_IMAGE_PROGRESS_CALLBACK_CANCEL -2
 
-int32_t fw_image_hash_compare(struct fw_image *fw, uint8_t *data, uint32_t len, uint8_t *hash);
+int32_t fw_image_hash_compare(struct fw_image *fw, const uint8_t *data, uint32_t len, const uint8_t *hash);
 #define FW_IMAGE_HASH_COMPARE_OK 0
 #define FW_IMAGE_HASH_COMPARE_FAILED -1
 
+uint32_t fw_image_hash_size(enum fw_image_section_hash type);
+
+int32_t fw_image_hash_init(struct fw_image_hash *h, enum fw_image_section_hash type);
+#define FW_IMAGE_HASH_INIT_OK 0
+#define FW_IMAGE_HASH_INIT_FAILED -1
+
+int32_t fw_image_hash_update(struct fw_image_hash *h, const uint8_t *data, uint32_t len);
+#define FW_IMAGE_HASH_UPDATE_OK 0
+#define FW_IMAGE_HASH_UPDATE_FAILED -1
+
+int32_t fw_image_hash_final(struct fw_image_hash *h, uint8_t *hash, uint32_t len);
+#define FW_IMAGE_HASH_FINAL_OK 0
+#define FW_IMAGE_HASH_FINAL_FAILED -1
+
 int32_t fw_image_parse_section(struct fw_image *fw, uint8_t **section_base, struct fw_image_section *section);
 #define FW_IMAGE_PARSE_SECTION_OK 0
 #define FW_IMAGE_PARSE_SECTION_FAILED -1
@@ -198,6 +437,20 @@ int32_t fw_image_parse(struct fw_image *fw);
 #define FW_IMAGE_PARSE_OK 0
 #define FW_IMAGE_PARSE_FAILED -1
 
+/**
+ * @brief Check the CRC32 of the verified section.
+ *
+ * @param fw A parsed firmware image.
+ *
+ * @return FW_IMAGE_CRC_CHECK_OK if the CRC matches,
+ *         FW_IMAGE_CRC_CHECK_MISSING if the image contains no CRC section or
+ *         FW_IMAGE_CRC_CHECK_FAILED otherwise.
+ */
+int32_t fw_image_crc_check(struct fw_image *fw);
+#define FW_IMAGE_CRC_CHECK_OK 0
+#define FW_IMAGE_CRC_CHECK_FAILED -1
+#define FW_IMAGE_CRC_CHECK_MISSING -2
+
 int32_t fw_image_verify(struct fw_image *fw);
 #define FW_IMAGE_VERIFY_OK 0
 #define FW_IMAGE_VERIFY_FAILED -1
@@ -210,6 +463,19 @@ int32_t fw_image_get_size(struct fw_image *fw, uint32_t *size);
 #define FW_IMAGE_GET_SIZE_OK 0
 #define FW_IMAGE_GET_SIZE_FAILED -1
 
+/**
+ * @brief Save the firmware image to a file.
+ *
+ * If the file already contains the same image (the size and the
+ * verification section match), it is not rewritten.
+ *
+ * @param fw A firmware image to save.
+ * @param fs A filesystem to save the file to.
+ * @param fname Name of the output file.
+ *
+ * @return FW_IMAGE_DUMP_FILE_OK if the file contains the image or
+ *         FW_IMAGE_DUMP_FILE_FAILED otherwise.
+ */
 int32_t fw_image_dump_file(struct fw_image *fw, struct sffs *fs, const char *fname);
 #define FW_IMAGE_DUMP_FILE_OK 0
 #define FW_IMAGE_DUMP_FILE_FAILED -1
@@ -218,6 +484,64 @@ int32_t fw_image_program_file(struct fw_image *fw, struct sffs *fs, const char *
 #define FW_IMAGE_PROGRAM_FILE_OK 0
 #define FW_IMAGE_PROGRAM_FILE_FAILED -1
 
+/**
+ * @brief Program a firmware image from a file touching only changed sectors.
+ *
+ * The file is read twice. The (decoded) image is compared with the current
+ * flash contents first, then only the sectors which differ are erased and
+ * programmed. The whole resulting image is hashed and verified as usual.
+ *
+ * @param fw A firmware image to overwrite.
+ * @param fs Filesystem containing the file.
+ * @param fname Name of the firmware image file.
+ *
+ * @return FW_IMAGE_PROGRAM_FILE_DIFF_OK if the image was programmed or
+ *         FW_IMAGE_PROGRAM_FILE_DIFF_FAILED otherwise.
+ */
+int32_t fw_image_program_file_diff(struct fw_image *fw, struct sffs *fs, const char *fname);
+#define FW_IMAGE_PROGRAM_FILE_DIFF_OK 0
+#define FW_IMAGE_PROGRAM_FILE_DIFF_FAILED -1
+
+/**
+ * @brief Verify integrity of a firmware image saved in a file.
+ *
+ * The image is parsed and hashed directly from the file, it is not
+ * programmed. Compressed and delta images are decoded on the fly. Maximum size
+ * of the verification section is limited. The result is recorded in the
+ * firmware catalogue (see fw_catalogue.h).
+ *
+ * @param fw Firmware image the file is intended for. It is not modified,
+ *           only its progress callback is used.
+ * @param fs Filesystem containing the file.
+ * @param fname Name of the file.
+ *
+ * @return FW_IMAGE_VERIFY_FILE_OK if the image was verified successfully or
+ *         FW_IMAGE_VERIFY_FILE_FAILED otherwise.
+ */
+int32_t fw_image_verify_file(struct fw_image *fw, struct sffs *fs, const char *fname);
+#define FW_IMAGE_VERIFY_FILE_OK 0
+#define FW_IMAGE_VERIFY_FILE_FAILED -1
+
+/**
+ * @brief Verify and authenticate a firmware image saved in a file.
+ *
+ * It can be used to check a requested firmware before the current one is
+ * erased. The image must contain a firmware section. The result is recorded
+ * in the firmware catalogue.
+ *
+ * @param fw Firmware image the file is intended for. It is not modified,
+ *           only its progress callback is used.
+ * @param fs Filesystem containing the file.
+ * @param fname Name of the file.
+ *
+ * @return FW_IMAGE_AUTHENTICATE_FILE_OK if the image was verified and
+ *         authenticated successfully or
+ *         FW_IMAGE_AUTHENTICATE_FILE_FAILED otherwise.
+ */
+int32_t fw_image_authenticate_file(struct fw_image *fw, struct sffs *fs, const char *fname);
+#define FW_IMAGE_AUTHENTICATE_FILE_OK 0
+#define FW_IMAGE_AUTHENTICATE_FILE_FAILED -1
+
 
 #endif
 
@@ -0,0 +1,211 @@
+/**
+ * uBLoad streaming LZ4 decompressor
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u_assert.h"
+#include "lz4_stream.h"
+
+
+#define LZ4_STREAM_WINDOW_MASK (LZ4_STREAM_WINDOW_SIZE - 1)
+#define LZ4_STREAM_MIN_MATCH 4
+
+
+/* Pass all decompressed data not flushed yet to the output callback. */
+#define LZ4_STREAM_FLUSH_OK 0
+#define LZ4_STREAM_FLUSH_FAILED -1
+static int32_t lz4_stream_flush(struct lz4_stream *s) {
+	while (s->flushed < s->total) {
+		uint32_t start = s->flushed & LZ4_STREAM_WINDOW_MASK;
+		uint32_t len = s->total - s->flushed;
+
+		/* Window wraps around, do it in two steps. */
+		if (len > LZ4_STREAM_WINDOW_SIZE - start) {
+			len = LZ4_STREAM_WINDOW_SIZE - start;
+		}
+		if (s->output(&s->window[start], len, s->output_ctx) != LZ4_STREAM_OUTPUT_OK) {
+			return LZ4_STREAM_FLUSH_FAILED;
+		}
+		s->flushed += len;
+	}
+
+	return LZ4_STREAM_FLUSH_OK;
+}
+
+
+#define LZ4_STREAM_PUT_OK 0
+#define LZ4_STREAM_PUT_FAILED -1
+static int32_t lz4_stream_put(struct lz4_stream *s, uint8_t c) {
+	s->window[s->total & LZ4_STREAM_WINDOW_MASK] = c;
+	s->total++;
+
+	/* The window is full, flush it before it is overwritten. */
+	if (s->total - s->flushed == LZ4_STREAM_WINDOW_SIZE) {
+		if (lz4_stream_flush(s) != LZ4_STREAM_FLUSH_OK) {
+			return LZ4_STREAM_PUT_FAILED;
+		}
+	}
+
+	return LZ4_STREAM_PUT_OK;
+}
+
+
+#define LZ4_STREAM_COPY_MATCH_OK 0
+#define LZ4_STREAM_COPY_MATCH_FAILED -1
+static int32_t lz4_stream_copy_match(struct lz4_stream *s) {
+	/* Match must be inside the window and the data decompressed so far. */
+	if (s->match_offset == 0 ||
+	    s->match_offset > LZ4_STREAM_WINDOW_SIZE ||
+	    s->match_offset > s->total) {
+		return LZ4_STREAM_COPY_MATCH_FAILED;
+	}
+
+	/* Copy byte by byte, the match can overlap itself. */
+	for (uint32_t i = 0; i < s->match_len; i++) {
+		uint8_t c = s->window[(s->total - s->match_offset) & LZ4_STREAM_WINDOW_MASK];
+		if (lz4_stream_put(s, c) != LZ4_STREAM_PUT_OK) {
+			return LZ4_STREAM_COPY_MATCH_FAILED;
+		}
+	}
+
+	return LZ4_STREAM_COPY_MATCH_OK;
+}
+
+
+int32_t lz4_stream_init(struct lz4_stream *s, int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx), void *ctx) {
+	if (u_assert(s != NULL) ||
+	    u_assert(output != NULL)) {
+		return LZ4_STREAM_INIT_FAILED;
+	}
+
+	s->state = LZ4_STREAM_STATE_TOKEN;
+	s->literal_len = 0;
+	s->match_len = 0;
+	s->match_offset = 0;
+	s->total = 0;
+	s->flushed = 0;
+	s->output = output;
+	s->output_ctx = ctx;
+
+	return LZ4_STREAM_INIT_OK;
+}
+
+
+int32_t lz4_stream_feed(struct lz4_stream *s, const uint8_t *data, uint32_t len) {
+	if (u_assert(s != NULL) ||
+	    u_assert(data != NULL)) {
+		return LZ4_STREAM_FEED_FAILED;
+	}
+
+	for (uint32_t i = 0; i < len; i++) {
+		uint8_t b = data[i];
+
+		switch (s->state) {
+			case LZ4_STREAM_STATE_TOKEN:
+				/* Each sequence starts with a token containing
+				 * literal length and match length (minus 4). */
+				s->literal_len = b >> 4;
+				s->match_len = (b & 0x0f) + LZ4_STREAM_MIN_MATCH;
+				if (s->literal_len == 15) {
+					s->state = LZ4_STREAM_STATE_LITERAL_LEN;
+				} else if (s->literal_len > 0) {
+					s->state = LZ4_STREAM_STATE_LITERALS;
+				} else {
+					s->state = LZ4_STREAM_STATE_OFFSET_LO;
+				}
+				break;
+
+			case LZ4_STREAM_STATE_LITERAL_LEN:
+				s->literal_len += b;
+				if (b != 255) {
+					s->state = LZ4_STREAM_STATE_LITERALS;
+				}
+				break;
+
+			case LZ4_STREAM_STATE_LITERALS:
+				if (lz4_stream_put(s, b) != LZ4_STREAM_PUT_OK) {
+					s->state = LZ4_STREAM_STATE_ERROR;
+					return LZ4_STREAM_FEED_FAILED;
+				}
+				s->literal_len--;
+				if (s->literal_len == 0) {
+					/* The last sequence ends here. */
+					s->state = LZ4_STREAM_STATE_OFFSET_LO;
+				}
+				break;
+
+			case LZ4_STREAM_STATE_OFFSET_LO:
+				s->match_offset = b;
+				s->state = LZ4_STREAM_STATE_OFFSET_HI;
+				break;
+
+			case LZ4_STREAM_STATE_OFFSET_HI:
+				s->match_offset |= (uint32_t)b << 8;
+				if (s->match_len == 15 + LZ4_STREAM_MIN_MATCH) {
+					s->state = LZ4_STREAM_STATE_MATCH_LEN;
+					break;
+				}
+				if (lz4_stream_copy_match(s) != LZ4_STREAM_COPY_MATCH_OK) {
+					s->state = LZ4_STREAM_STATE_ERROR;
+					return LZ4_STREAM_FEED_FAILED;
+				}
+				s->state = LZ4_STREAM_STATE_TOKEN;
+				break;
+
+			case LZ4_STREAM_STATE_MATCH_LEN:
+				s->match_len += b;
+				if (b != 255) {
+					if (lz4_stream_copy_match(s) != LZ4_STREAM_COPY_MATCH_OK) {
+						s->state = LZ4_STREAM_STATE_ERROR;
+						return LZ4_STREAM_FEED_FAILED;
+					}
+					s->state = LZ4_STREAM_STATE_TOKEN;
+				}
+				break;
+
+			default:
+				return LZ4_STREAM_FEED_FAILED;
+		}
+	}
+
+	return LZ4_STREAM_FEED_OK;
+}
+
+
+int32_t lz4_stream_finish(struct lz4_stream *s) {
+	if (u_assert(s != NULL)) {
+		return LZ4_STREAM_FINISH_FAILED;
+	}
+
+	/* A block must end with the literals of the last sequence. */
+	if (s->state != LZ4_STREAM_STATE_OFFSET_LO &&
+	    s->state != LZ4_STREAM_STATE_TOKEN) {
+		return LZ4_STREAM_FINISH_FAILED;
+	}
+
+	if (lz4_stream_flush(s) != LZ4_STREAM_FLUSH_OK) {
+		return LZ4_STREAM_FINISH_FAILED;
+	}
+
+	return LZ4_STREAM_FINISH_OK;
+}
@@ -0,0 +1,116 @@
+/**
+ * uBLoad streaming LZ4 decompressor
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LZ4_STREAM_H_
+#define _LZ4_STREAM_H_
+
+#include <stdint.h>
+
+/**
+ * Size of the decompression window (history buffer). Match offsets greater
+ * than this are refused, the compressor must limit them accordingly
+ * (tools/lz4.py). It must be a power of 2.
+ */
+#define LZ4_STREAM_WINDOW_SIZE 4096
+
+enum lz4_stream_state {
+	LZ4_STREAM_STATE_TOKEN,
+	LZ4_STREAM_STATE_LITERAL_LEN,
+	LZ4_STREAM_STATE_LITERALS,
+	LZ4_STREAM_STATE_OFFSET_LO,
+	LZ4_STREAM_STATE_OFFSET_HI,
+	LZ4_STREAM_STATE_MATCH_LEN,
+	LZ4_STREAM_STATE_ERROR,
+};
+
+/**
+ * Decompressor of a LZ4 block (raw LZ4 block format without the frame
+ * header). Compressed data can be fed in chunks of arbitrary length,
+ * decompressed data are passed to the output callback in chunks of at
+ * most LZ4_STREAM_WINDOW_SIZE bytes.
+ */
+struct lz4_stream {
+	enum lz4_stream_state state;
+	uint32_t literal_len;
+	uint32_t match_len;
+	uint32_t match_offset;
+
+	/**
+	 * Total number of decompressed bytes and number of bytes already
+	 * passed to the output callback.
+	 */
+	uint32_t total;
+	uint32_t flushed;
+
+	int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx);
+	void *output_ctx;
+
+	uint8_t window[LZ4_STREAM_WINDOW_SIZE];
+};
+#define LZ4_STREAM_OUTPUT_OK 0
+#define LZ4_STREAM_OUTPUT_FAILED -1
+
+/**
+ * @brief Initialize the decompressor.
+ *
+ * @param s Decompressor context.
+ * @param output Callback receiving decompressed data. Decompression fails
+ *               if it returns anything other than LZ4_STREAM_OUTPUT_OK.
+ * @param ctx Context passed to the @a output callback.
+ *
+ * @return LZ4_STREAM_INIT_OK if the decompressor was initialized or
+ *         LZ4_STREAM_INIT_FAILED otherwise.
+ */
+int32_t lz4_stream_init(struct lz4_stream *s, int32_t (*output)(const uint8_t *data, uint32_t len, void *ctx), void *ctx);
+#define LZ4_STREAM_INIT_OK 0
+#define LZ4_STREAM_INIT_FAILED -1
+
+/**
+ * @brief Feed a chunk of compressed data.
+ *
+ * @param s Decompressor context.
+ * @param data Buffer with compressed data.
+ * @param len Length of the @a data buffer.
+ *
+ * @return LZ4_STREAM_FEED_OK if the chunk was processed or
+ *         LZ4_STREAM_FEED_FAILED if the data are malformed or the output
+ *         callback failed.
+ */
+int32_t lz4_stream_feed(struct lz4_stream *s, const uint8_t *data, uint32_t len);
+#define LZ4_STREAM_FEED_OK 0
+#define LZ4_STREAM_FEED_FAILED -1
+
+/**
+ * @brief Finish the decompression.
+ *
+ * All remaining decompressed data are passed to the output callback.
+ *
+ * @param s Decompressor context.
+ *
+ * @return LZ4_STREAM_FINISH_OK if the compressed block ended properly or
+ *         LZ4_STREAM_FINISH_FAILED otherwise.
+ */
+int32_t lz4_stream_finish(struct lz4_stream *s);
+#define LZ4_STREAM_FINISH_OK 0
+#define LZ4_STREAM_FINISH_FAILED -1
+
+
+#endif
@@ -28,6 +28,8 @@
 #include "u_assert.h"
 #include "u_log.h"
 #include "sha512.h"
+#include "ed25519.h"
+#include "crc32.h"
 #include "pubkey_storage.h"
 
 
@@ -37,6 +39,13 @@
 const struct pubkey_storage_slot pubkey_storage_slots[PUBKEY_STORAGE_SLOT_COUNT] = {
 	[0 ... PUBKEY_STORAGE_SLOT_COUNT - 1] = {
 		.pubkey = { [0 ... PUBKEY_STORAGE_SLOT_SIZE - 1] = 0xff },
+		.pubkey_point = {
+			.x = { [0 ... F25519_SIZE - 1] = 0xff },
+			.y = { [0 ... F25519_SIZE - 1] = 0xff },
+			.t = { [0 ... F25519_SIZE - 1] = 0xff },
+			.z = { [0 ... F25519_SIZE - 1] = 0xff },
+		},
+		.pubkey_point_tag = { [0 ... PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE - 1] = 0xff },
 		.pubkey_hash = { [0 ... PUBKEY_STORAGE_SLOT_HASH_SIZE - 1] = 0xff },
 		.pubkey_fp = { [0 ... PUBKEY_STORAGE_SLOT_FP_SIZE - 1] = 0xff },
 	}
@@ -45,6 +54,24 @@ uint8_t const pubkey_storage_salt[PUBKEY_STORAGE_SALT_SIZE] = { [0 ... PUBKEY_ST
 #pragma GCC diagnostic pop
 
 
+/**
+ * Compute the unpacked key tag, it is a CRC32 of the padded public key
+ * followed by the unpacked point. The data buffer is static, it is too
+ * large for the stack.
+ */
+static void pubkey_storage_point_tag(const uint8_t *pubkey, const struct ed25519_pt *point, uint8_t *tag) {
+	static uint8_t data[PUBKEY_STORAGE_SLOT_SIZE + sizeof(struct ed25519_pt)];
+	memcpy(data, pubkey, PUBKEY_STORAGE_SLOT_SIZE);
+	memcpy(data + PUBKEY_STORAGE_SLOT_SIZE, point, sizeof(struct ed25519_pt));
+
+	uint32_t crc = 0;
+	crc32_compute(data, sizeof(data), &crc);
+	for (uint32_t i = 0; i < PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE; i++) {
+		tag[i] = crc >> (i * 8);
+	}
+}
+
+
 int32_t pubkey_storage_set_slot_key(const struct pubkey_storage_slot *slot, const uint8_t *key, uint8_t size) {
 	if (u_assert(slot != NULL) ||
 	    u_assert(key != NULL) ||
@@ -71,23 +98,41 @@ int32_t pubkey_storage_set_slot_key(const struct pubkey_storage_slot *slot, cons
 	sha512_final(&s, key, size);
 	sha512_get(&s, fp, 0, PUBKEY_STORAGE_SLOT_FP_SIZE);
 
-	/* Prepare slot data with salt. Fill the remaining bytes with 0. */
-	uint8_t data[PUBKEY_STORAGE_SLOT_SIZE + PUBKEY_STORAGE_SALT_SIZE];
+	/* Prepare slot data with salt. Fill the remaining bytes with 0. Slot
+	 * data, its hash and the unpacked key are too large for the stack. */
+	static uint8_t data[PUBKEY_STORAGE_SLOT_SIZE + PUBKEY_STORAGE_SALT_SIZE];
 	memset(data, 0, sizeof(data));
 	memcpy(data, key, size);
 	memcpy(data + PUBKEY_STORAGE_SLOT_SIZE, pubkey_storage_salt, PUBKEY_STORAGE_SALT_SIZE);
 
 	/* Prepare public key hash. We are hashing with the salt now. */
-	uint8_t hash[PUBKEY_STORAGE_SLOT_HASH_SIZE];
+	static uint8_t hash[PUBKEY_STORAGE_SLOT_HASH_SIZE];
 	sha512_init(&s);
 	sha512_final(&s, data, sizeof(data));
 	sha512_get(&s, hash, 0, PUBKEY_STORAGE_SLOT_HASH_SIZE);
 
+	/* Unpack the key now, invalid keys are refused. */
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
+	static struct ed25519_pt point;
+	if (!ed25519_try_unpack(x, y, data)) {
+		u_log(system_log, LOG_TYPE_ERROR, "pubkey_storage: the key is not a valid curve point");
+		return PUBKEY_STORAGE_SET_SLOT_KEY_FAILED;
+	}
+	ed25519_project(&point, x, y);
+	f25519_normalize(point.t);
+
+	uint8_t tag[PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE];
+	pubkey_storage_point_tag(data, &point, tag);
+
 	flash_unlock();
 	/* Save the pubkey from the data variable - it is padded with 0x00. */
 	flash_program((uint32_t)slot->pubkey, data, PUBKEY_STORAGE_SLOT_SIZE);
 	/* Save the hash of the salted and padded public key. */
 	flash_program((uint32_t)slot->pubkey_hash, hash, PUBKEY_STORAGE_SLOT_HASH_SIZE);
+	/* Save the unpacked key and its tag. */
+	flash_program((uint32_t)&slot->pubkey_point, (uint8_t *)&point, sizeof(struct ed25519_pt));
+	flash_program((uint32_t)slot->pubkey_point_tag, tag, PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE);
 	/* And finally save the pubkey fingerprint for faster lookup. */
 	flash_program((uint32_t)slot->pubkey_fp, fp, PUBKEY_STORAGE_SLOT_FP_SIZE);
 	flash_lock();
@@ -115,6 +160,15 @@ int32_t pubkey_storage_check_if_slot_empty(const struct pubkey_storage_slot *slo
 		val_free &= slot->pubkey_fp[i];
 		val_locked |= slot->pubkey_fp[i];
 	}
+	const uint8_t *point = (const uint8_t *)&slot->pubkey_point;
+	for (uint32_t i = 0; i < sizeof(struct ed25519_pt); i++) {
+		val_free &= point[i];
+		val_locked |= point[i];
+	}
+	for (uint32_t i = 0; i < PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE; i++) {
+		val_free &= slot->pubkey_point_tag[i];
+		val_locked |= slot->pubkey_point_tag[i];
+	}
 
 	if (0xff == val_free) {
 		return PUBKEY_STORAGE_CHECK_IF_SLOT_EMPTY_EMPTY;
@@ -173,6 +227,11 @@ int32_t pubkey_storage_verify_slot(const struct pubkey_storage_slot *slot) {
 		return PUBKEY_STORAGE_VERIFY_SLOT_FAILED;
 	}
 
+	/* The unpacked key must be valid too. */
+	if (pubkey_storage_verify_slot_point(slot) != PUBKEY_STORAGE_VERIFY_SLOT_POINT_OK) {
+		return PUBKEY_STORAGE_VERIFY_SLOT_FAILED;
+	}
+
 	return PUBKEY_STORAGE_VERIFY_SLOT_OK;
 }
 
@@ -238,6 +297,9 @@ int32_t pubkey_storage_lock_slot(const struct pubkey_storage_slot *slot) {
 	if (PUBKEY_STORAGE_SLOT_FP_SIZE > zerolen) {
 		zerolen = PUBKEY_STORAGE_SLOT_FP_SIZE;
 	}
+	if (sizeof(struct ed25519_pt) > zerolen) {
+		zerolen = sizeof(struct ed25519_pt);
+	}
 	uint8_t zero[zerolen];
 	memset(zero, 0, zerolen);
 
@@ -245,6 +307,8 @@ int32_t pubkey_storage_lock_slot(const struct pubkey_storage_slot *slot) {
 	flash_program((uint32_t)slot->pubkey, zero, PUBKEY_STORAGE_SLOT_SIZE);
 	flash_program((uint32_t)slot->pubkey_hash, zero, PUBKEY_STORAGE_SLOT_HASH_SIZE);
 	flash_program((uint32_t)slot->pubkey_fp, zero, PUBKEY_STORAGE_SLOT_FP_SIZE);
+	flash_program((uint32_t)&slot->pubkey_point, zero, sizeof(struct ed25519_pt));
+	flash_program((uint32_t)slot->pubkey_point_tag, zero, PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE);
 	flash_lock();
 
 	return PUBKEY_STORAGE_LOCK_SLOT_OK;
@@ -259,7 +323,9 @@ int32_t pubkey_storage_get_slot_key_by_fp(uint8_t *fp, uint8_t *key, uint8_t siz
 
 	for (uint32_t i = 0; i < PUBKEY_STORAGE_SLOT_COUNT; i++) {
 		if (!memcmp(pubkey_storage_slots[i].pubkey_fp, fp, PUBKEY_STORAGE_SLOT_FP_SIZE)) {
-			pubkey_storage_get_slot_key(&(pubkey_storage_slots[i]), key, size);
+			if (pubkey_storage_get_slot_key(&(pubkey_storage_slots[i]), key, size) != PUBKEY_STORAGE_GET_SLOT_KEY_OK) {
+				return PUBKEY_STORAGE_GET_SLOT_KEY_BY_FP_FAILED;
+			}
 			return PUBKEY_STORAGE_GET_SLOT_KEY_BY_FP_OK;
 		}
 	}
@@ -267,3 +333,47 @@ int32_t pubkey_storage_get_slot_key_by_fp(uint8_t *fp, uint8_t *key, uint8_t siz
 	/* No key matched. */
 	return PUBKEY_STORAGE_GET_SLOT_KEY_BY_FP_FAILED;
 }
+
+
+int32_t pubkey_storage_verify_slot_point(const struct pubkey_storage_slot *slot) {
+	if (u_assert(slot != NULL)) {
+		return PUBKEY_STORAGE_VERIFY_SLOT_POINT_FAILED;
+	}
+
+	uint8_t tag[PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE];
+	pubkey_storage_point_tag(slot->pubkey, &slot->pubkey_point, tag);
+	if (memcmp(tag, slot->pubkey_point_tag, PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE)) {
+		return PUBKEY_STORAGE_VERIFY_SLOT_POINT_FAILED;
+	}
+
+	return PUBKEY_STORAGE_VERIFY_SLOT_POINT_OK;
+}
+
+
+int32_t pubkey_storage_get_slot_point_by_fp(uint8_t *fp, uint8_t *key, struct ed25519_pt *point) {
+	if (u_assert(fp != NULL) ||
+	    u_assert(key != NULL) ||
+	    u_assert(point != NULL)) {
+		return PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED;
+	}
+
+	for (uint32_t i = 0; i < PUBKEY_STORAGE_SLOT_COUNT; i++) {
+		const struct pubkey_storage_slot *slot = &(pubkey_storage_slots[i]);
+
+		if (memcmp(slot->pubkey_fp, fp, PUBKEY_STORAGE_SLOT_FP_SIZE)) {
+			continue;
+		}
+
+		/* The key is checked against the salted slot hash (a single
+		 * SHA512 block), the unpacked key is checked by its tag. */
+		if (pubkey_storage_get_slot_key(slot, key, PUBKEY_STORAGE_SLOT_SIZE) != PUBKEY_STORAGE_GET_SLOT_KEY_OK) {
+			return PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED;
+		}
+
+		memcpy(point, &slot->pubkey_point, sizeof(struct ed25519_pt));
+		return PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_OK;
+	}
+
+	/* No key matched. */
+	return PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED;
+}
@@ -22,11 +22,16 @@
 #ifndef _PUBKEY_STORAGE_H_
 #define _PUBKEY_STORAGE_H_
 
+#include <stdint.h>
+
+#include "ed25519.h"
+
 #define PUBKEY_STORAGE_SLOT_SIZE 32
 #define PUBKEY_STORAGE_SLOT_FP_SIZE 4
 #define PUBKEY_STORAGE_SLOT_HASH_SIZE 64
 #define PUBKEY_STORAGE_SLOT_COUNT 4
 #define PUBKEY_STORAGE_SALT_SIZE 32
+#define PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE 4
 
 /* TODO: hash salt */
 
@@ -37,6 +42,20 @@ struct pubkey_storage_slot {
 	 */
 	const uint8_t pubkey[PUBKEY_STORAGE_SLOT_SIZE];
 
+	/**
+	 * Unpacked public key (extended Edwards point with z = 1). It is
+	 * computed and validated when the key is set to avoid the point
+	 * decompression during every signature verification.
+	 */
+	const struct ed25519_pt pubkey_point;
+
+	/**
+	 * CRC32 of the pubkey and pubkey_point members (little endian). The
+	 * packed key is authenticated by the salted pubkey_hash, the tag only
+	 * guards the unpacked key against corruption.
+	 */
+	const uint8_t pubkey_point_tag[PUBKEY_STORAGE_SLOT_POINT_TAG_SIZE];
+
 	/**
 	 * SHA512 hash of the public key. It is updated when the public key is
 	 * overwritten. Public key is considered valid if its hash is also valid.
@@ -150,4 +169,35 @@ int32_t pubkey_storage_get_slot_key_by_fp(uint8_t *fp, uint8_t *key, uint8_t siz
 #define PUBKEY_STORAGE_GET_SLOT_KEY_BY_FP_OK 0
 #define PUBKEY_STORAGE_GET_SLOT_KEY_BY_FP_FAILED -1
 
+/**
+ * @brief Check integrity of the unpacked public key saved in the slot.
+ *
+ * Only the pubkey_point_tag CRC is checked, the slot hash is checked by
+ * pubkey_storage_verify_slot.
+ *
+ * @param slot Pubkey slot to check.
+ *
+ * @return PUBKEY_STORAGE_VERIFY_SLOT_POINT_OK if the unpacked key is valid or
+ *         PUBKEY_STORAGE_VERIFY_SLOT_POINT_FAILED otherwise.
+ */
+int32_t pubkey_storage_verify_slot_point(const struct pubkey_storage_slot *slot);
+#define PUBKEY_STORAGE_VERIFY_SLOT_POINT_OK 0
+#define PUBKEY_STORAGE_VERIFY_SLOT_POINT_FAILED -1
+
+/**
+ * @brief Find a slot by the key fingerprint and retrieve its unpacked key.
+ *
+ * @param fp Fingerprint of the requested key.
+ * @param key A buffer of PUBKEY_STORAGE_SLOT_SIZE bytes where the packed
+ *            key will be placed.
+ * @param point The unpacked key is placed here.
+ *
+ * @return PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_OK if the key was found and
+ *                                               retrieved successfully or
+ *         PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED otherwise.
+ */
+int32_t pubkey_storage_get_slot_point_by_fp(uint8_t *fp, uint8_t *key, struct ed25519_pt *point);
+#define PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_OK 0
+#define PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED -1
+
 #endif
@@ -59,6 +59,7 @@ int32_t sffs_mount(struct sffs *fs, struct flash_dev *flash) {
 	}
 
 	fs->flash = flash;
+	fs->format_pending = false;
 	fs->page_size = info.page_size;
 	fs->sector_size = info.sector_size;
 	fs->sector_count = info.capacity / info.sector_size;
@@ -67,7 +68,12 @@ int32_t sffs_mount(struct sffs *fs, struct flash_dev *flash) {
 		(sizeof(struct sffs_metadata_item) + info.page_size);
 	fs->first_data_page = info.sector_size / info.page_size - fs->data_pages_per_sector;
 
-	/* TODO: check flash geometry and computed values */
+	if (fs->page_size > SFFS_PAGE_SIZE_MAX ||
+	    fs->data_pages_per_sector == 0 ||
+	    fs->data_pages_per_sector > SFFS_DATA_PAGES_PER_SECTOR_MAX) {
+		u_log(system_log, LOG_TYPE_ERROR, "sffs: unsupported flash geometry");
+		return SFFS_MOUNT_FAILED;
+	}
 
 	if (sffs_cache_clear(fs) != SFFS_CACHE_CLEAR_OK) {
 		return SFFS_MOUNT_FAILED;
@@ -132,6 +138,7 @@ int32_t sffs_format(struct flash_dev *flash) {
 	for (uint32_t sector = 0; sector < fs.sector_count; sector++) {
 		sffs_sector_format(&fs, sector);
 	}
+	sffs_sector_format_complete(&fs);
 	/* TODO: write master page */
 
 	return SFFS_FORMAT_OK;
@@ -210,7 +217,16 @@ int32_t sffs_cached_read(struct sffs *fs, uint32_t addr, uint8_t *data, uint32_t
 		return SFFS_CACHED_READ_FAILED;
 	}
 
-	if (flash_page_read(fs->flash, addr, data, len) != FLASH_PAGE_READ_OK) {
+	/* Reads of other sectors are served while the erase is running (the
+	 * flash driver suspends it if possible). Only the sector being
+	 * formatted must be finished first. */
+	if (fs->format_pending && (addr / fs->sector_size) == fs->format_sector) {
+		if (sffs_sector_format_complete(fs) != SFFS_SECTOR_FORMAT_COMPLETE_OK) {
+			return SFFS_CACHED_READ_FAILED;
+		}
+	}
+
+	if (flash_read(fs->flash, addr, data, len) != FLASH_READ_OK) {
 		return SFFS_CACHED_READ_FAILED;
 	}
 
@@ -218,13 +234,55 @@ int32_t sffs_cached_read(struct sffs *fs, uint32_t addr, uint8_t *data, uint32_t
 }
 
 
+int32_t sffs_get_sector_metadata(struct sffs *fs, uint32_t sector, struct sffs_metadata_header *header, struct sffs_metadata_item *items) {
+	if (u_assert(fs != NULL) ||
+	    u_assert(header != NULL) ||
+	    u_assert(items != NULL) ||
+	    u_assert(sector < fs->sector_count)) {
+		return SFFS_GET_SECTOR_METADATA_FAILED;
+	}
+
+	/* Do not wait for the sector being formatted in the background, return
+	 * metadata which are going to be written instead. */
+	if (fs->format_pending && fs->format_sector == sector) {
+		header->magic = SFFS_METADATA_MAGIC;
+		header->state = SFFS_SECTOR_STATE_ERASED;
+		for (uint32_t i = 0; i < fs->data_pages_per_sector; i++) {
+			items[i].file_id = 0xffff;
+			items[i].block = 0xffff;
+			items[i].state = SFFS_PAGE_STATE_ERASED;
+			items[i].size = 0xffff;
+		}
+		return SFFS_GET_SECTOR_METADATA_OK;
+	}
+
+	uint32_t header_pos = sector * fs->sector_size;
+	if (sffs_cached_read(fs, header_pos, (uint8_t *)header, sizeof(struct sffs_metadata_header)) != SFFS_CACHED_READ_OK) {
+		return SFFS_GET_SECTOR_METADATA_FAILED;
+	}
+
+	uint32_t items_pos = header_pos + sizeof(struct sffs_metadata_header);
+	if (sffs_cached_read(fs, items_pos, (uint8_t *)items, fs->data_pages_per_sector * sizeof(struct sffs_metadata_item)) != SFFS_CACHED_READ_OK) {
+		return SFFS_GET_SECTOR_METADATA_FAILED;
+	}
+
+	return SFFS_GET_SECTOR_METADATA_OK;
+}
+
+
 int32_t sffs_cached_write(struct sffs *fs, uint32_t addr, uint8_t *data, uint32_t len) {
 	if (u_assert(fs != NULL) ||
 	    u_assert(data != NULL)) {
 		return SFFS_CACHED_WRITE_FAILED;
 	}
 
-	if (flash_page_write(fs->flash, addr, data, len) != FLASH_PAGE_WRITE_OK) {
+	if (sffs_sector_format_complete(fs) != SFFS_SECTOR_FORMAT_COMPLETE_OK) {
+		return SFFS_CACHED_WRITE_FAILED;
+	}
+
+	/* Do not wait for the page program to finish. Flash driver waits before
+	 * the next operation, the caller can do something useful meanwhile. */
+	if (flash_page_write_start(fs->flash, addr, data, len) != FLASH_PAGE_WRITE_START_OK) {
 		return SFFS_CACHED_WRITE_FAILED;
 	}
 
@@ -241,19 +299,20 @@ int32_t sffs_find_page(struct sffs *fs, uint32_t file_id, uint32_t block, struct
 	/* first we need to iterate over all sectors in the flash */
 	for (uint32_t sector = 0; sector < fs->sector_count; sector++) {
 		struct sffs_metadata_header header;
-		/* TODO: check return value */
-		sffs_cached_read(fs, sector * fs->sector_size, (uint8_t *)&header, sizeof(header));
+		struct sffs_metadata_item items[SFFS_DATA_PAGES_PER_SECTOR_MAX];
+		if (sffs_get_sector_metadata(fs, sector, &header, items) != SFFS_GET_SECTOR_METADATA_OK) {
+			return SFFS_FIND_PAGE_FAILED;
+		}
 
 		if (header.state == SFFS_SECTOR_STATE_ERASED) {
 			continue;
 		}
 
 		for (uint32_t i = 0; i < fs->data_pages_per_sector; i++) {
-			struct sffs_metadata_item item;
-			sffs_get_page_metadata(fs, &(struct sffs_page){ .sector = sector, .page = i }, &item);
+			struct sffs_metadata_item *item = &(items[i]);
 
 			/* check if page contains valid data for requested file */
-			if (item.file_id == file_id && item.block == block && (item.state == SFFS_PAGE_STATE_USED || item.state == SFFS_PAGE_STATE_MOVING)) {
+			if (item->file_id == file_id && item->block == block && (item->state == SFFS_PAGE_STATE_USED || item->state == SFFS_PAGE_STATE_MOVING)) {
 				page->sector = sector;
 				page->page = i;
 				return SFFS_FIND_PAGE_OK;
@@ -274,20 +333,17 @@ int32_t sffs_find_erased_page(struct sffs *fs, struct sffs_page *page) {
 	/* first we need to iterate over all sectors in the flash */
 	for (uint32_t sector = 0; sector < fs->sector_count; sector++) {
 		struct sffs_metadata_header header;
-		/* TODO: check return value */
-		sffs_cached_read(fs, sector * fs->sector_size, (uint8_t *)&header, sizeof(header));
+		struct sffs_metadata_item items[SFFS_DATA_PAGES_PER_SECTOR_MAX];
+		if (sffs_get_sector_metadata(fs, sector, &header, items) != SFFS_GET_SECTOR_METADATA_OK) {
+			return SFFS_FIND_ERASED_PAGE_FAILED;
+		}
 
 		if (header.state == SFFS_SECTOR_STATE_DIRTY || header.state == SFFS_SECTOR_STATE_FULL) {
 			continue;
 		}
 
 		for (uint32_t i = 0; i < fs->data_pages_per_sector; i++) {
-			uint32_t item_pos = sector * fs->sector_size + sizeof(struct sffs_metadata_header) + i * sizeof(struct sffs_metadata_item);
-			struct sffs_metadata_item item;
-			/* TODO: check return value */
-			sffs_cached_read(fs, item_pos, (uint8_t *)&item, sizeof(struct sffs_metadata_item));
-
-			if (item.state == SFFS_PAGE_STATE_ERASED) {
+			if (items[i].state == SFFS_PAGE_STATE_ERASED) {
 				page->sector = sector;
 				page->page = i;
 				return SFFS_FIND_ERASED_PAGE_OK;
@@ -317,14 +373,40 @@ int32_t sffs_sector_format(struct sffs *fs, uint32_t sector) {
 		return SFFS_SECTOR_FORMAT_FAILED;
 	}
 
-	flash_sector_erase(fs->flash, sector * fs->sector_size);
+	/* Only one sector format can be pending. */
+	if (sffs_sector_format_complete(fs) != SFFS_SECTOR_FORMAT_COMPLETE_OK) {
+		return SFFS_SECTOR_FORMAT_FAILED;
+	}
+
+	if (flash_sector_erase_start(fs->flash, sector * fs->sector_size) != FLASH_SECTOR_ERASE_START_OK) {
+		return SFFS_SECTOR_FORMAT_FAILED;
+	}
+	fs->format_pending = true;
+	fs->format_sector = sector;
 
-	/* prepare and write sector header */
+	return SFFS_SECTOR_FORMAT_OK;
+}
+
+
+int32_t sffs_sector_format_complete(struct sffs *fs) {
+	if (u_assert(fs != NULL)) {
+		return SFFS_SECTOR_FORMAT_COMPLETE_FAILED;
+	}
+
+	if (fs->format_pending == false) {
+		return SFFS_SECTOR_FORMAT_COMPLETE_OK;
+	}
+	fs->format_pending = false;
+	uint32_t sector = fs->format_sector;
+
+	/* prepare and write sector header, wait for the erase to finish first */
 	struct sffs_metadata_header header;
 	header.magic = SFFS_METADATA_MAGIC;
 	header.state = SFFS_SECTOR_STATE_ERASED;
 	/* TODO: fill other fields */
-	flash_page_write(fs->flash, fs->sector_size * sector, (uint8_t *)&header, sizeof(header));
+	if (flash_page_write_start(fs->flash, fs->sector_size * sector, (uint8_t *)&header, sizeof(header)) != FLASH_PAGE_WRITE_START_OK) {
+		return SFFS_SECTOR_FORMAT_COMPLETE_FAILED;
+	}
 
 	/* prepare and write sector metadata items */
 	for (uint32_t i = 0; i < fs->data_pages_per_sector; i++) {
@@ -337,10 +419,12 @@ int32_t sffs_sector_format(struct sffs *fs, uint32_t sector) {
 		/* sffs_set_page_metadata cannot be used here as the remaining sector
 		 * metadata are not complete yet and function will fail during sector
 		 * metadata update */
-		flash_page_write(fs->flash, fs->sector_size * sector + sizeof(header) + i * sizeof(item), (uint8_t *)&item, sizeof(item));
+		if (flash_page_write_start(fs->flash, fs->sector_size * sector + sizeof(header) + i * sizeof(item), (uint8_t *)&item, sizeof(item)) != FLASH_PAGE_WRITE_START_OK) {
+			return SFFS_SECTOR_FORMAT_COMPLETE_FAILED;
+		}
 	}
 
-	return SFFS_SECTOR_FORMAT_OK;
+	return SFFS_SECTOR_FORMAT_COMPLETE_OK;
 }
 
 
@@ -374,7 +458,8 @@ int32_t sffs_update_sector_metadata(struct sffs *fs, uint32_t sector) {
 	}
 
 	struct sffs_metadata_header header;
-	if (sffs_cached_read(fs, sector * fs->sector_size, (uint8_t *)&header, sizeof(header)) != SFFS_CACHED_READ_OK) {
+	struct sffs_metadata_item items[SFFS_DATA_PAGES_PER_SECTOR_MAX];
+	if (sffs_get_sector_metadata(fs, sector, &header, items) != SFFS_GET_SECTOR_METADATA_OK) {
 		return SFFS_UPDATE_SECTOR_METADATA_FAILED;
 	}
 
@@ -392,14 +477,13 @@ int32_t sffs_update_sector_metadata(struct sffs *fs, uint32_t sector) {
 
 
 	for (uint32_t i = 0; i < fs->data_pages_per_sector; i++) {
-		struct sffs_metadata_item item;
-		sffs_get_page_metadata(fs, &(struct sffs_page){ .sector = sector, .page = i }, &item);
+		uint8_t state = items[i].state;
 
-		if (item.state == SFFS_PAGE_STATE_ERASED) p_erased++;
-		if (item.state == SFFS_PAGE_STATE_RESERVED) p_reserved++;
-		if (item.state == SFFS_PAGE_STATE_USED) p_used++;
-		if (item.state == SFFS_PAGE_STATE_MOVING) p_moving++;
-		if (item.state == SFFS_PAGE_STATE_OLD) p_old++;
+		if (state == SFFS_PAGE_STATE_ERASED) p_erased++;
+		if (state == SFFS_PAGE_STATE_RESERVED) p_reserved++;
+		if (state == SFFS_PAGE_STATE_USED) p_used++;
+		if (state == SFFS_PAGE_STATE_MOVING) p_moving++;
+		if (state == SFFS_PAGE_STATE_OLD) p_old++;
 	}
 
 	int update_ok = 0;
@@ -585,7 +669,7 @@ int32_t sffs_write(struct sffs_file *f, unsigned char *buf, uint32_t len) {
 	/* now we can iterate over all flash pages which need to be modified */
 	for (uint32_t i = b_start; i <= b_end; i++) {
 
-		uint8_t page_data[f->fs->page_size];
+		uint8_t page_data[SFFS_PAGE_SIZE_MAX];
 		struct sffs_page page;
 		uint32_t loaded_old = 0;
 		uint32_t old_len = 0;
@@ -699,16 +783,12 @@ int32_t sffs_read(struct sffs_file *f, unsigned char *buf, uint32_t len) {
 	for (uint32_t i = b_start; i <= b_end; i++) {
 
 
-		uint8_t page_data[f->fs->page_size];
 		struct sffs_page page;
 		uint32_t dest_len;
 
 		if (sffs_find_page(f->fs, f->file_id, i, &page) == SFFS_FIND_PAGE_OK) {
 			uint32_t addr;
 			sffs_page_addr(f->fs, &page, &addr);
-			if (sffs_cached_read(f->fs, addr, page_data, sizeof(page_data)) != SFFS_CACHED_READ_OK) {
-				return -1;
-			}
 
 			struct sffs_metadata_item item;
 			sffs_get_page_metadata(f->fs, &page, &item);
@@ -738,8 +818,11 @@ int32_t sffs_read(struct sffs_file *f, unsigned char *buf, uint32_t len) {
 				return -1;
 			}
 
-			//~ printf("reading from page %d, offset %d, length %d to  to buf[%d-%d]\n", i, dest_offset, dest_len, source_offset, source_offset + dest_len);
-			memcpy(&(buf[source_offset]), &(page_data[dest_offset]), dest_len);
+			/* Read only the requested part of the page directly to the
+			 * destination buffer. */
+			if (sffs_cached_read(f->fs, addr + dest_offset, &(buf[source_offset]), dest_len) != SFFS_CACHED_READ_OK) {
+				return -1;
+			}
 		} else {
 			/* no more bytes to read */
 			break;
@@ -754,6 +837,63 @@ int32_t sffs_read(struct sffs_file *f, unsigned char *buf, uint32_t len) {
 }
 
 
+int32_t sffs_read_start(struct sffs_file *f, unsigned char *buf, uint32_t len) {
+	if (u_assert(f != NULL) ||
+	    u_assert(buf != NULL) ||
+	    u_assert(len > 0)) {
+		return -1;
+	}
+
+	if (sffs_check_file_opened(f) != SFFS_CHECK_FILE_OPENED_OK) {
+		return -1;
+	}
+
+	/* Page lookup reads the metadata synchronously, only the data
+	 * transfer is left running. */
+	struct sffs_page page;
+	if (sffs_find_page(f->fs, f->file_id, f->pos / f->fs->page_size, &page) != SFFS_FIND_PAGE_OK) {
+		return 0;
+	}
+	uint32_t addr;
+	sffs_page_addr(f->fs, &page, &addr);
+
+	struct sffs_metadata_item item;
+	sffs_get_page_metadata(f->fs, &page, &item);
+
+	uint32_t offset = f->pos % f->fs->page_size;
+	if (offset >= item.size) {
+		return 0;
+	}
+	len = MIN(len, item.size - offset);
+
+	if (f->fs->format_pending && ((addr + offset) / f->fs->sector_size) == f->fs->format_sector) {
+		if (sffs_sector_format_complete(f->fs) != SFFS_SECTOR_FORMAT_COMPLETE_OK) {
+			return -1;
+		}
+	}
+
+	if (flash_page_read_start(f->fs->flash, addr + offset, buf, len) != FLASH_PAGE_READ_START_OK) {
+		return -1;
+	}
+	f->pos += len;
+
+	return len;
+}
+
+
+int32_t sffs_read_wait(struct sffs_file *f) {
+	if (u_assert(f != NULL)) {
+		return SFFS_READ_WAIT_FAILED;
+	}
+
+	if (flash_transfer_wait(f->fs->flash) != FLASH_TRANSFER_WAIT_OK) {
+		return SFFS_READ_WAIT_FAILED;
+	}
+
+	return SFFS_READ_WAIT_OK;
+}
+
+
 int32_t sffs_seek(struct sffs_file *f, uint32_t pos) {
 	if (u_assert(f != NULL)) {
 		return SFFS_SEEK_OK;
@@ -828,7 +968,10 @@ int32_t sffs_get_info(struct sffs *fs, struct sffs_info *info) {
 	info->sectors_total = fs->sector_count;
 	for (uint32_t sector = 0; sector < fs->sector_count; sector++) {
 		struct sffs_metadata_header header;
-		sffs_cached_read(fs, sector * fs->sector_size, (uint8_t *)&header, sizeof(header));
+		struct sffs_metadata_item items[SFFS_DATA_PAGES_PER_SECTOR_MAX];
+		if (sffs_get_sector_metadata(fs, sector, &header, items) != SFFS_GET_SECTOR_METADATA_OK) {
+			return SFFS_GET_INFO_FAILED;
+		}
 
 		switch (header.state) {
 			case SFFS_SECTOR_STATE_ERASED:
@@ -851,12 +994,7 @@ int32_t sffs_get_info(struct sffs *fs, struct sffs_info *info) {
 		}
 
 		for (uint32_t i = 0; i < fs->data_pages_per_sector; i++) {
-			uint32_t item_pos = sector * fs->sector_size + sizeof(struct sffs_metadata_header) + i * sizeof(struct sffs_metadata_item);
-			struct sffs_metadata_item item;
-			/* TODO: check return value */
-			sffs_cached_read(fs, item_pos, (uint8_t *)&item, sizeof(struct sffs_metadata_item));
-
-			switch (item.state) {
+			switch (items[i].state) {
 				case SFFS_PAGE_STATE_ERASED:
 					info->pages_erased++;
 					break;
@@ -34,6 +34,12 @@
 #define SFFS_LABEL_SIZE 8
 #define SFFS_DIR_FILE_NAME_LENGTH 32
 
+/* Page data and sector metadata are kept on the stack, flash geometry is
+ * limited to avoid unbounded stack usage. 4KB sectors with 256B pages have
+ * 15 data pages per sector. */
+#define SFFS_PAGE_SIZE_MAX 256
+#define SFFS_DATA_PAGES_PER_SECTOR_MAX 15
+
 struct sffs;
 
 struct sffs_file {
@@ -70,6 +76,11 @@ struct sffs {
 	struct flash_dev *flash;
 
 	char label[SFFS_LABEL_SIZE];
+
+	/* Sector erase is running in the background, metadata of the sector
+	 * are written before the next write or read of the sector. */
+	bool format_pending;
+	uint32_t format_sector;
 };
 
 struct sffs_page {
@@ -307,6 +318,22 @@ int32_t sffs_cached_read(struct sffs *fs, uint32_t addr, uint8_t *data, uint32_t
 #define SFFS_CACHED_READ_OK 0
 #define SFFS_CACHED_READ_FAILED -1
 
+/**
+ * Read sector metadata header and all metadata items of the sector. Both are
+ * read using a single flash read transaction each.
+ *
+ * @param fs A SFFS filesystem.
+ * @param sector Sector to read metadata from.
+ * @param header Pointer to header structure which will be filled.
+ * @param items Array of fs->data_pages_per_sector metadata items.
+ *
+ * @return SFFS_GET_SECTOR_METADATA_OK on success or
+ *         SFFS_GET_SECTOR_METADATA_FAILED otherwise.
+ */
+int32_t sffs_get_sector_metadata(struct sffs *fs, uint32_t sector, struct sffs_metadata_header *header, struct sffs_metadata_item *items);
+#define SFFS_GET_SECTOR_METADATA_OK 0
+#define SFFS_GET_SECTOR_METADATA_FAILED -1
+
 /**
  * Write one page to cache.
  *
@@ -368,10 +395,36 @@ int32_t sffs_page_addr(struct sffs *fs, struct sffs_page *page, uint32_t *addr);
 #define SFFS_PAGE_ADDR_OK 0
 #define SFFS_PAGE_ADDR_FAILED -1
 
+/**
+ * Start formatting a sector. The sector erase is only started and the function
+ * returns without waiting for it. Sector metadata are written by
+ * sffs_sector_format_complete which is called automatically before the next
+ * write or before reading the sector. Reads of other sectors suspend the
+ * running erase on parts supporting it.
+ *
+ * @param fs A SFFS filesystem.
+ * @param sector A sector to format.
+ *
+ * @return SFFS_SECTOR_FORMAT_OK on success or
+ *         SFFS_SECTOR_FORMAT_FAILED otherwise.
+ */
 int32_t sffs_sector_format(struct sffs *fs, uint32_t sector);
 #define SFFS_SECTOR_FORMAT_OK 0
 #define SFFS_SECTOR_FORMAT_FAILED -1
 
+/**
+ * Finish pending sector format (if any) by writing its metadata header and
+ * metadata items.
+ *
+ * @param fs A SFFS filesystem.
+ *
+ * @return SFFS_SECTOR_FORMAT_COMPLETE_OK on success or
+ *         SFFS_SECTOR_FORMAT_COMPLETE_FAILED otherwise.
+ */
+int32_t sffs_sector_format_complete(struct sffs *fs);
+#define SFFS_SECTOR_FORMAT_COMPLETE_OK 0
+#define SFFS_SECTOR_FORMAT_COMPLETE_FAILED -1
+
 /**
  * Initiate garbage collection for a given sector. If the sector is marked as old,
  * it is being erased automatically. If the sector is dirty, garbage collector
@@ -486,6 +539,35 @@ int32_t sffs_write(struct sffs_file *f, unsigned char *buf, uint32_t len);
  */
 int32_t sffs_read(struct sffs_file *f, unsigned char *buf, uint32_t len);
 
+/**
+ * Start reading up to len bytes from the actual position without waiting for
+ * the data. The read is limited to the current file page, the data transfer
+ * runs in the background if the flash driver uses DMA. The buffer must
+ * remain valid and must not be used until sffs_read_wait returns. Position
+ * in the file is updated immediately.
+ *
+ * @param f A SFFS File.
+ * @param buf A buffer for read data.
+ * @param len Maximum length of data to be read from the file.
+ *
+ * @return -1 on error,
+ *         0 if no more data can be read or
+ *         number of bytes being read.
+ */
+int32_t sffs_read_start(struct sffs_file *f, unsigned char *buf, uint32_t len);
+
+/**
+ * Wait for the read started by sffs_read_start to complete.
+ *
+ * @param f A SFFS File.
+ *
+ * @return SFFS_READ_WAIT_OK if the data are available or
+ *         SFFS_READ_WAIT_FAILED otherwise.
+ */
+int32_t sffs_read_wait(struct sffs_file *f);
+#define SFFS_READ_WAIT_OK 0
+#define SFFS_READ_WAIT_FAILED -1
+
 /**
  * Update write/read position within an opened file.
  *
@@ -27,12 +27,258 @@
 #include <libopencm3/stm32/spi.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/dma.h>
 
 #include "u_assert.h"
 #include "u_log.h"
 #include "spi_flash.h"
 #include "timer.h"
 
+/* Maximum number of data items a single DMA transfer can handle. */
+#define FLASH_DMA_MAX_LEN 65535
+
+/* DMA source and sink used for the direction with no data. */
+static const uint8_t flash_dma_tx_dummy = 0x00;
+static uint8_t flash_dma_rx_dummy;
+
+
+static void flash_select(struct flash_dev *flash) {
+	/* Finish the pending asynchronous transfer before issuing a new command. */
+	if (flash->transfer_busy) {
+		flash_transfer_wait(flash);
+	}
+	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
+}
+
+
+static void flash_deselect(struct flash_dev *flash) {
+	gpio_set(flash->cs_port, 1 << flash->cs_pin);
+}
+
+
+/**
+ * Send a command followed by a 24 bit address.
+ */
+static void flash_send_addr(struct flash_dev *flash, uint8_t cmd, uint32_t addr) {
+	spi_xfer(flash->spi, cmd);
+	spi_xfer(flash->spi, (addr >> 16) & 0xff);
+	spi_xfer(flash->spi, (addr >> 8) & 0xff);
+	spi_xfer(flash->spi, addr & 0xff);
+}
+
+
+/**
+ * Send the read command selected for the part, its address and dummy bytes.
+ */
+static void flash_send_read(struct flash_dev *flash, uint32_t addr) {
+	flash_send_addr(flash, flash->read_cmd, addr);
+	for (uint8_t i = 0; i < flash->read_dummy; i++) {
+		spi_xfer(flash->spi, 0x00);
+	}
+}
+
+
+/**
+ * Remember the operation which has just been started. Maximum operation time
+ * is used to detect a stuck or disconnected chip.
+ */
+static void flash_op_started(struct flash_dev *flash, uint32_t timeout, bool erase) {
+	flash->op_pending = true;
+	flash->op_timeout = timeout;
+	flash->op_erase = erase;
+	timer_timeout_start(&(flash->op_start));
+}
+
+
+/**
+ * Suspend the pending erase if the part supports it. Returns true if the
+ * chip can be read now.
+ */
+static bool flash_suspend(struct flash_dev *flash) {
+	if (flash->op_erase == false || (flash->info.caps & FLASH_CAP_SUSPEND) == 0) {
+		return false;
+	}
+
+	/* Give the erase at least a millisecond to progress since it was
+	 * resumed, suspending it repeatedly would stall it completely. */
+	while (timer_timeout_check(flash->resume_time, 2)) {
+		;
+	}
+
+	flash_select(flash);
+	spi_xfer(flash->spi, 0x75);
+	flash_deselect(flash);
+	flash->op_suspended = true;
+
+	/* The chip needs some tens of microseconds to suspend. */
+	uint32_t start;
+	timer_timeout_start(&start);
+	uint8_t sr;
+	do {
+		flash_get_status(flash, &sr);
+		if (!timer_timeout_check(start, 2)) {
+			return false;
+		}
+	} while (sr & 0x01);
+
+	return true;
+}
+
+
+static void flash_resume(struct flash_dev *flash) {
+	flash_select(flash);
+	spi_xfer(flash->spi, 0x7a);
+	flash_deselect(flash);
+	flash->op_suspended = false;
+
+	/* Suspended time is not counted in the maximum operation time. */
+	timer_timeout_start(&(flash->resume_time));
+	timer_timeout_start(&(flash->op_start));
+}
+
+
+/**
+ * Make the chip ready to be read. Pending erase is suspended if possible,
+ * otherwise the pending operation must complete first.
+ */
+#define FLASH_READ_PREPARE_OK 0
+#define FLASH_READ_PREPARE_FAILED -1
+static int32_t flash_read_prepare(struct flash_dev *flash) {
+	if (flash->op_suspended) {
+		return FLASH_READ_PREPARE_OK;
+	}
+
+	int32_t ret = flash_poll(flash);
+	if (ret == FLASH_POLL_BUSY) {
+		if (flash_suspend(flash)) {
+			return FLASH_READ_PREPARE_OK;
+		}
+		if (flash_wait_complete(flash) == FLASH_WAIT_COMPLETE_OK) {
+			ret = FLASH_POLL_DONE;
+		}
+	}
+
+	if (ret != FLASH_POLL_DONE) {
+		return FLASH_READ_PREPARE_FAILED;
+	}
+
+	return FLASH_READ_PREPARE_OK;
+}
+
+
+static void flash_dma_stream_setup(struct flash_dev *flash, uint8_t stream, uint32_t direction, uint32_t mem, bool increment, uint32_t len) {
+	dma_stream_reset(flash->dma, stream);
+	dma_channel_select(flash->dma, stream, flash->dma_channel);
+	dma_set_priority(flash->dma, stream, DMA_SxCR_PL_HIGH);
+	dma_set_memory_size(flash->dma, stream, DMA_SxCR_MSIZE_8BIT);
+	dma_set_peripheral_size(flash->dma, stream, DMA_SxCR_PSIZE_8BIT);
+	if (increment) {
+		dma_enable_memory_increment_mode(flash->dma, stream);
+	} else {
+		dma_disable_memory_increment_mode(flash->dma, stream);
+	}
+	dma_set_transfer_mode(flash->dma, stream, direction);
+	dma_set_peripheral_address(flash->dma, stream, (uint32_t)&SPI_DR(flash->spi));
+	dma_set_memory_address(flash->dma, stream, mem);
+	dma_set_number_of_data(flash->dma, stream, len);
+}
+
+
+static void flash_dma_start(struct flash_dev *flash, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+	if (rx != NULL) {
+		flash_dma_stream_setup(flash, flash->dma_rx_stream, DMA_SxCR_DIR_PERIPHERAL_TO_MEM, (uint32_t)rx, true, len);
+	} else {
+		flash_dma_stream_setup(flash, flash->dma_rx_stream, DMA_SxCR_DIR_PERIPHERAL_TO_MEM, (uint32_t)&flash_dma_rx_dummy, false, len);
+	}
+	if (tx != NULL) {
+		flash_dma_stream_setup(flash, flash->dma_tx_stream, DMA_SxCR_DIR_MEM_TO_PERIPHERAL, (uint32_t)tx, true, len);
+	} else {
+		flash_dma_stream_setup(flash, flash->dma_tx_stream, DMA_SxCR_DIR_MEM_TO_PERIPHERAL, (uint32_t)&flash_dma_tx_dummy, false, len);
+	}
+
+	/* RX stream must be ready before the first byte is clocked out. */
+	dma_enable_stream(flash->dma, flash->dma_rx_stream);
+	dma_enable_stream(flash->dma, flash->dma_tx_stream);
+	spi_enable_rx_dma(flash->spi);
+	spi_enable_tx_dma(flash->spi);
+}
+
+
+static void flash_dma_stop(struct flash_dev *flash) {
+	spi_disable_tx_dma(flash->spi);
+	spi_disable_rx_dma(flash->spi);
+	dma_disable_stream(flash->dma, flash->dma_tx_stream);
+	dma_disable_stream(flash->dma, flash->dma_rx_stream);
+	dma_clear_interrupt_flags(flash->dma, flash->dma_tx_stream, DMA_TCIF | DMA_HTIF | DMA_TEIF | DMA_DMEIF | DMA_FEIF);
+	dma_clear_interrupt_flags(flash->dma, flash->dma_rx_stream, DMA_TCIF | DMA_HTIF | DMA_TEIF | DMA_DMEIF | DMA_FEIF);
+}
+
+
+/**
+ * Check the state of a running DMA transfer. The transfer is complete when
+ * the RX stream has received the last byte, the SPI is idle at that point.
+ */
+static int32_t flash_dma_check(struct flash_dev *flash) {
+	if (dma_get_interrupt_flag(flash->dma, flash->dma_rx_stream, DMA_TEIF) ||
+	    dma_get_interrupt_flag(flash->dma, flash->dma_tx_stream, DMA_TEIF)) {
+		flash_dma_stop(flash);
+		return FLASH_TRANSFER_POLL_FAILED;
+	}
+
+	if (!dma_get_interrupt_flag(flash->dma, flash->dma_rx_stream, DMA_TCIF)) {
+		return FLASH_TRANSFER_POLL_BUSY;
+	}
+
+	flash_dma_stop(flash);
+	return FLASH_TRANSFER_POLL_DONE;
+}
+
+
+/**
+ * Transfer a block of data with the chip already selected. Either tx or rx
+ * can be NULL, zeroes are sent or received data are discarded respectively.
+ */
+#define FLASH_XFER_OK 0
+#define FLASH_XFER_FAILED -1
+static int32_t flash_xfer(struct flash_dev *flash, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+	if (flash->dma == 0 || len < FLASH_DMA_MIN_LEN) {
+		for (uint32_t i = 0; i < len; i++) {
+			uint8_t b = spi_xfer(flash->spi, (tx != NULL) ? tx[i] : 0x00);
+			if (rx != NULL) {
+				rx[i] = b;
+			}
+		}
+		return FLASH_XFER_OK;
+	}
+
+	while (len > 0) {
+		uint32_t chunk = len;
+		if (chunk > FLASH_DMA_MAX_LEN) {
+			chunk = FLASH_DMA_MAX_LEN;
+		}
+
+		flash_dma_start(flash, tx, rx, chunk);
+		int32_t ret;
+		do {
+			ret = flash_dma_check(flash);
+		} while (ret == FLASH_TRANSFER_POLL_BUSY);
+
+		if (ret != FLASH_TRANSFER_POLL_DONE) {
+			return FLASH_XFER_FAILED;
+		}
+
+		if (tx != NULL) {
+			tx += chunk;
+		}
+		if (rx != NULL) {
+			rx += chunk;
+		}
+		len -= chunk;
+	}
+
+	return FLASH_XFER_OK;
+}
+
 
 int32_t flash_init(struct flash_dev *flash, uint32_t spi, uint32_t cs_port, uint8_t cs_pin) {
 	if (u_assert(flash != NULL)) {
@@ -42,6 +288,18 @@ int32_t flash_init(struct flash_dev *flash, uint32_t spi, uint32_t cs_port, uint
 	flash->spi = spi;
 	flash->cs_port = cs_port;
 	flash->cs_pin = cs_pin;
+	flash->dma = 0;
+	flash->transfer_busy = false;
+	flash->transfer_callback = NULL;
+	flash->transfer_callback_ctx = NULL;
+	flash->op_pending = false;
+	flash->complete_callback = NULL;
+	flash->complete_callback_ctx = NULL;
+	flash->read_cmd = 0x03;
+	flash->read_dummy = 0;
+	flash->op_erase = false;
+	flash->op_suspended = false;
+	flash->resume_time = 0;
 
 	/* Setup SPI peripheral */
 	spi_set_master_mode(flash->spi);
@@ -56,23 +314,53 @@ int32_t flash_init(struct flash_dev *flash, uint32_t spi, uint32_t cs_port, uint
 	spi_enable(flash->spi);
 
 	/* Try to communicate and detect flash memory. */
-	struct flash_info info;
-	if (flash_get_info(flash, &info) != FLASH_GET_INFO_OK) {
+	if (flash_get_info(flash, &(flash->info)) != FLASH_GET_INFO_OK) {
 		/* Communication failed or unknown flash memory detected. */
 		return FLASH_INIT_FAILED;
 	}
 
 	u_log(system_log, LOG_TYPE_INFO,
 		"spi_flash: flash detected %s %s, size %u bytes",
-		info.manufacturer,
-		info.part,
-		info.capacity
+		flash->info.manufacturer,
+		flash->info.part,
+		flash->info.capacity
 	);
 
+	/* Fast Read (0x0B) has one dummy byte after the address but it is
+	 * specified for much higher clock than Read Data. Dual (0x3B) and quad
+	 * (0x6B) output reads need a controller able to sample IO1-IO3, the
+	 * SPI peripheral is single bit only, they are not used. */
+	if (flash->info.caps & FLASH_CAP_FAST_READ) {
+		flash->read_cmd = 0x0b;
+		flash->read_dummy = 1;
+		u_log(system_log, LOG_TYPE_INFO, "spi_flash: using fast read");
+	}
+
 	return FLASH_INIT_OK;
 }
 
 
+int32_t flash_set_clock(struct flash_dev *flash, uint32_t pclk, uint32_t max_freq) {
+	if (u_assert(flash != NULL) ||
+	    u_assert(max_freq > 0)) {
+		return FLASH_SET_CLOCK_FAILED;
+	}
+
+	/* Prescaler values 0 to 7 divide the clock by 2 to 256. */
+	uint8_t br = 0;
+	while (br < 7 && (pclk >> (br + 1)) > max_freq) {
+		br++;
+	}
+
+	flash_transfer_wait(flash);
+	spi_set_baudrate_prescaler(flash->spi, br);
+
+	u_log(system_log, LOG_TYPE_INFO, "spi_flash: SPI clock %u Hz", pclk >> (br + 1));
+
+	return FLASH_SET_CLOCK_OK;
+}
+
+
 int32_t flash_free(struct flash_dev *flash) {
 	if (u_assert(flash != NULL)) {
 		return FLASH_FREE_FAILED;
@@ -91,12 +379,12 @@ int32_t flash_get_id(struct flash_dev *flash, uint32_t *id) {
 	}
 
 	uint32_t n = 0;
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
+	flash_select(flash);
 	spi_xfer(flash->spi, 0x9f);
 	n = (n << 8) | spi_xfer(flash->spi, 0x00);
 	n = (n << 8) | spi_xfer(flash->spi, 0x00);
 	n = (n << 8) | spi_xfer(flash->spi, 0x00);
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
+	flash_deselect(flash);
 
 	*id = n;
 	return FLASH_GET_ID_OK;
@@ -108,13 +396,13 @@ int32_t flash_write_enable(struct flash_dev *flash, bool ena) {
 		return FLASH_WRITE_ENABLE_FAILED;
 	}
 
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
+	flash_select(flash);
 	if (ena) {
 		spi_xfer(flash->spi, 0x06);
 	} else {
 		spi_xfer(flash->spi, 0x04);
 	}
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
+	flash_deselect(flash);
 
 	return FLASH_WRITE_ENABLE_OK;
 }
@@ -125,10 +413,10 @@ int32_t flash_get_status(struct flash_dev *flash, uint8_t *status) {
 		return FLASH_GET_STATUS_FAILED;
 	}
 
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
+	flash_select(flash);
 	spi_xfer(flash->spi, 0x05);
 	*status = spi_xfer(flash->spi, 0x00);
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
+	flash_deselect(flash);
 
 	return FLASH_GET_STATUS_OK;
 }
@@ -139,11 +427,17 @@ int32_t flash_wait_complete(struct flash_dev *flash) {
 		return FLASH_WAIT_COMPLETE_FAILED;
 	}
 
-	/* TODO: timeout */
-	uint8_t sr;
+	int32_t ret;
 	do {
-		flash_get_status(flash, &sr);
-	} while (sr & 0x01);
+		ret = flash_poll(flash);
+	} while (ret == FLASH_POLL_BUSY);
+
+	if (ret == FLASH_POLL_TIMEOUT) {
+		return FLASH_WAIT_COMPLETE_TIMEOUT;
+	}
+	if (ret != FLASH_POLL_DONE) {
+		return FLASH_WAIT_COMPLETE_FAILED;
+	}
 
 	return FLASH_WAIT_COMPLETE_OK;
 }
@@ -168,6 +462,25 @@ int32_t flash_get_info(struct flash_dev *flash, struct flash_info *info) {
 		info->block_size = 65536;
 		info->manufacturer = "Spansion";
 		info->part = "S25FL208K";
+		info->caps = FLASH_CAP_FAST_READ | FLASH_CAP_DUAL_OUTPUT_READ;
+		info->page_program_time = 5;
+		info->sector_erase_time = 500;
+		info->block_erase_time = 2000;
+		return FLASH_GET_INFO_OK;
+	}
+
+	/* Winbond W25Q80DV */
+	if (id == 0x00ef4014) {
+		info->capacity = 1024 * 1024;
+		info->page_size = 256;
+		info->sector_size = 4096;
+		info->block_size = 65536;
+		info->manufacturer = "Winbond";
+		info->part = "W25Q80DV";
+		info->caps = FLASH_CAP_FAST_READ | FLASH_CAP_DUAL_OUTPUT_READ | FLASH_CAP_QUAD_OUTPUT_READ | FLASH_CAP_SUSPEND;
+		info->page_program_time = 5;
+		info->sector_erase_time = 400;
+		info->block_erase_time = 2000;
 		return FLASH_GET_INFO_OK;
 	}
 
@@ -189,17 +502,10 @@ int32_t flash_block_erase(struct flash_dev *flash, const uint32_t addr) {
 		return FLASH_BLOCK_ERASE_FAILED;
 	}
 
-	flash_write_enable(flash, true);
-
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
-	spi_xfer(flash->spi, 0xd8);
-	spi_xfer(flash->spi, (addr >> 16) & 0xff);
-	spi_xfer(flash->spi, (addr >> 8) & 0xff);
-	spi_xfer(flash->spi, addr & 0xff);
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
-
-	flash_wait_complete(flash);
-	flash_write_enable(flash, false);
+	if (flash_block_erase_start(flash, addr) != FLASH_BLOCK_ERASE_START_OK ||
+	    flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_BLOCK_ERASE_FAILED;
+	}
 
 	return FLASH_BLOCK_ERASE_OK;
 }
@@ -210,66 +516,322 @@ int32_t flash_sector_erase(struct flash_dev *flash, const uint32_t addr) {
 		return FLASH_SECTOR_ERASE_FAILED;
 	}
 
-	flash_write_enable(flash, true);
-
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
-	spi_xfer(flash->spi, 0x20);
-	spi_xfer(flash->spi, (addr >> 16) & 0xff);
-	spi_xfer(flash->spi, (addr >> 8) & 0xff);
-	spi_xfer(flash->spi, addr & 0xff);
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
-
-	flash_wait_complete(flash);
-	flash_write_enable(flash, false);
+	if (flash_sector_erase_start(flash, addr) != FLASH_SECTOR_ERASE_START_OK ||
+	    flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_SECTOR_ERASE_FAILED;
+	}
 
 	return FLASH_SECTOR_ERASE_OK;
 }
 
 
 int32_t flash_page_write(struct flash_dev *flash, const uint32_t addr, const uint8_t *data, const uint32_t len) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_PAGE_WRITE_FAILED;
+	}
+
+	if (flash_page_write_start(flash, addr, data, len) != FLASH_PAGE_WRITE_START_OK ||
+	    flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_PAGE_WRITE_FAILED;
+	}
+
+	return FLASH_PAGE_WRITE_OK;
+}
+
+
+int32_t flash_page_read(struct flash_dev *flash, const uint32_t addr, uint8_t *data, const uint32_t len) {
 	if (u_assert(flash != NULL) ||
 	    u_assert(data != NULL) ||
 	    u_assert(len > 0) ||
 	    u_assert(len <= 256)) {
-		return FLASH_PAGE_WRITE_FAILED;
+		return FLASH_PAGE_READ_FAILED;
 	}
 
-	flash_write_enable(flash, true);
+	if (flash_read(flash, addr, data, len) != FLASH_READ_OK) {
+		return FLASH_PAGE_READ_FAILED;
+	}
 
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
-	spi_xfer(flash->spi, 0x02);
-	spi_xfer(flash->spi, (addr >> 16) & 0xff);
-	spi_xfer(flash->spi, (addr >> 8) & 0xff);
-	spi_xfer(flash->spi, addr & 0xff);
-	for (uint32_t i = 0; i < len; i++) {
-		spi_xfer(flash->spi, data[i]);
+	return FLASH_PAGE_READ_OK;
+}
+
+
+int32_t flash_read(struct flash_dev *flash, const uint32_t addr, uint8_t *data, const uint32_t len) {
+	if (u_assert(flash != NULL) ||
+	    u_assert(data != NULL) ||
+	    u_assert(len > 0)) {
+		return FLASH_READ_FAILED;
 	}
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
 
-	flash_wait_complete(flash);
-	flash_write_enable(flash, false);
+	if (flash_read_prepare(flash) != FLASH_READ_PREPARE_OK) {
+		return FLASH_READ_FAILED;
+	}
 
-	return FLASH_PAGE_WRITE_OK;
+	flash_select(flash);
+	flash_send_read(flash, addr);
+	int32_t ret = flash_xfer(flash, NULL, data, len);
+	flash_deselect(flash);
+
+	if (ret != FLASH_XFER_OK) {
+		return FLASH_READ_FAILED;
+	}
+
+	return FLASH_READ_OK;
 }
 
 
-int32_t flash_page_read(struct flash_dev *flash, const uint32_t addr, uint8_t *data, const uint32_t len) {
+int32_t flash_write(struct flash_dev *flash, const uint32_t addr, const uint8_t *data, const uint32_t len) {
+	if (u_assert(flash != NULL) ||
+	    u_assert(data != NULL) ||
+	    u_assert(flash->info.page_size > 0)) {
+		return FLASH_WRITE_FAILED;
+	}
+
+	uint32_t pos = 0;
+	while (pos < len) {
+		/* Program up to the end of the current page. */
+		uint32_t chunk = flash->info.page_size - ((addr + pos) % flash->info.page_size);
+		if (chunk > (len - pos)) {
+			chunk = len - pos;
+		}
+
+		if (flash_page_write_start(flash, addr + pos, data + pos, chunk) != FLASH_PAGE_WRITE_START_OK) {
+			return FLASH_WRITE_FAILED;
+		}
+		pos += chunk;
+	}
+
+	if (flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_WRITE_FAILED;
+	}
+
+	return FLASH_WRITE_OK;
+}
+
+
+int32_t flash_set_dma(struct flash_dev *flash, uint32_t dma, uint8_t rx_stream, uint8_t tx_stream, uint32_t channel) {
+	if (u_assert(flash != NULL) ||
+	    u_assert(flash->transfer_busy == false)) {
+		return FLASH_SET_DMA_FAILED;
+	}
+
+	flash->dma = dma;
+	flash->dma_rx_stream = rx_stream;
+	flash->dma_tx_stream = tx_stream;
+	flash->dma_channel = channel;
+
+	return FLASH_SET_DMA_OK;
+}
+
+
+int32_t flash_set_transfer_callback(struct flash_dev *flash, void (*callback)(struct flash_dev *flash, void *ctx), void *ctx) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_SET_TRANSFER_CALLBACK_FAILED;
+	}
+
+	flash->transfer_callback = callback;
+	flash->transfer_callback_ctx = ctx;
+
+	return FLASH_SET_TRANSFER_CALLBACK_OK;
+}
+
+
+int32_t flash_page_read_start(struct flash_dev *flash, const uint32_t addr, uint8_t *data, const uint32_t len) {
 	if (u_assert(flash != NULL) ||
 	    u_assert(data != NULL) ||
 	    u_assert(len > 0) ||
 	    u_assert(len <= 256)) {
-		return FLASH_PAGE_READ_FAILED;
+		return FLASH_PAGE_READ_START_FAILED;
 	}
 
-	gpio_clear(flash->cs_port, 1 << flash->cs_pin);
-	spi_xfer(flash->spi, 0x03);
-	spi_xfer(flash->spi, (addr >> 16) & 0xff);
-	spi_xfer(flash->spi, (addr >> 8) & 0xff);
-	spi_xfer(flash->spi, addr & 0xff);
-	for (uint32_t i = 0; i < len; i++) {
-		data[i] = spi_xfer(flash->spi, 0x00);
+	/* Polled fallback, the transfer is complete before returning. */
+	if (flash->dma == 0 || len < FLASH_DMA_MIN_LEN) {
+		if (flash_page_read(flash, addr, data, len) != FLASH_PAGE_READ_OK) {
+			return FLASH_PAGE_READ_START_FAILED;
+		}
+		if (flash->transfer_callback != NULL) {
+			flash->transfer_callback(flash, flash->transfer_callback_ctx);
+		}
+		return FLASH_PAGE_READ_START_OK;
 	}
-	gpio_set(flash->cs_port, 1 << flash->cs_pin);
 
-	return FLASH_PAGE_READ_OK;
+	if (flash_read_prepare(flash) != FLASH_READ_PREPARE_OK) {
+		return FLASH_PAGE_READ_START_FAILED;
+	}
+
+	flash_select(flash);
+	flash_send_read(flash, addr);
+
+	/* The chip stays selected until the transfer is polled as complete. */
+	flash->transfer_busy = true;
+	flash_dma_start(flash, NULL, data, len);
+
+	return FLASH_PAGE_READ_START_OK;
+}
+
+
+int32_t flash_transfer_poll(struct flash_dev *flash) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_TRANSFER_POLL_FAILED;
+	}
+
+	if (flash->transfer_busy == false) {
+		return FLASH_TRANSFER_POLL_DONE;
+	}
+
+	int32_t ret = flash_dma_check(flash);
+	if (ret == FLASH_TRANSFER_POLL_BUSY) {
+		return FLASH_TRANSFER_POLL_BUSY;
+	}
+
+	flash_deselect(flash);
+	flash->transfer_busy = false;
+
+	if (ret != FLASH_TRANSFER_POLL_DONE) {
+		return FLASH_TRANSFER_POLL_FAILED;
+	}
+
+	if (flash->transfer_callback != NULL) {
+		flash->transfer_callback(flash, flash->transfer_callback_ctx);
+	}
+
+	return FLASH_TRANSFER_POLL_DONE;
+}
+
+
+int32_t flash_transfer_wait(struct flash_dev *flash) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_TRANSFER_WAIT_FAILED;
+	}
+
+	int32_t ret;
+	do {
+		ret = flash_transfer_poll(flash);
+	} while (ret == FLASH_TRANSFER_POLL_BUSY);
+
+	if (ret != FLASH_TRANSFER_POLL_DONE) {
+		return FLASH_TRANSFER_WAIT_FAILED;
+	}
+
+	return FLASH_TRANSFER_WAIT_OK;
+}
+
+
+int32_t flash_sector_erase_start(struct flash_dev *flash, const uint32_t addr) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_SECTOR_ERASE_START_FAILED;
+	}
+
+	if (flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_SECTOR_ERASE_START_FAILED;
+	}
+
+	flash_write_enable(flash, true);
+
+	flash_select(flash);
+	flash_send_addr(flash, 0x20, addr);
+	flash_deselect(flash);
+	flash_op_started(flash, flash->info.sector_erase_time, true);
+
+	return FLASH_SECTOR_ERASE_START_OK;
+}
+
+
+int32_t flash_block_erase_start(struct flash_dev *flash, const uint32_t addr) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_BLOCK_ERASE_START_FAILED;
+	}
+
+	if (flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_BLOCK_ERASE_START_FAILED;
+	}
+
+	flash_write_enable(flash, true);
+
+	flash_select(flash);
+	flash_send_addr(flash, 0xd8, addr);
+	flash_deselect(flash);
+	flash_op_started(flash, flash->info.block_erase_time, true);
+
+	return FLASH_BLOCK_ERASE_START_OK;
+}
+
+
+int32_t flash_page_write_start(struct flash_dev *flash, const uint32_t addr, const uint8_t *data, const uint32_t len) {
+	if (u_assert(flash != NULL) ||
+	    u_assert(data != NULL) ||
+	    u_assert(len > 0) ||
+	    u_assert(len <= 256) ||
+	    u_assert(flash->info.page_size > 0) ||
+	    u_assert((addr % flash->info.page_size) + len <= flash->info.page_size)) {
+		return FLASH_PAGE_WRITE_START_FAILED;
+	}
+
+	if (flash_wait_complete(flash) != FLASH_WAIT_COMPLETE_OK) {
+		return FLASH_PAGE_WRITE_START_FAILED;
+	}
+
+	flash_write_enable(flash, true);
+
+	flash_select(flash);
+	flash_send_addr(flash, 0x02, addr);
+	int32_t ret = flash_xfer(flash, data, NULL, len);
+	flash_deselect(flash);
+	flash_op_started(flash, flash->info.page_program_time, false);
+
+	if (ret != FLASH_XFER_OK) {
+		return FLASH_PAGE_WRITE_START_FAILED;
+	}
+
+	return FLASH_PAGE_WRITE_START_OK;
+}
+
+
+int32_t flash_poll(struct flash_dev *flash) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_POLL_FAILED;
+	}
+
+	if (flash->op_pending == false) {
+		return FLASH_POLL_DONE;
+	}
+
+	/* The erase cannot progress while suspended. */
+	if (flash->op_suspended) {
+		flash_resume(flash);
+	}
+
+	uint8_t sr;
+	if (flash_get_status(flash, &sr) != FLASH_GET_STATUS_OK) {
+		return FLASH_POLL_FAILED;
+	}
+
+	int32_t ret = FLASH_POLL_DONE;
+	if (sr & 0x01) {
+		if (timer_timeout_check(flash->op_start, flash->op_timeout)) {
+			return FLASH_POLL_BUSY;
+		}
+		u_log(system_log, LOG_TYPE_ERROR, "spi_flash: operation timeout");
+		ret = FLASH_POLL_TIMEOUT;
+	}
+
+	flash->op_pending = false;
+	flash_write_enable(flash, false);
+
+	if (flash->complete_callback != NULL) {
+		flash->complete_callback(flash, ret, flash->complete_callback_ctx);
+	}
+
+	return ret;
+}
+
+
+int32_t flash_set_complete_callback(struct flash_dev *flash, void (*callback)(struct flash_dev *flash, int32_t result, void *ctx), void *ctx) {
+	if (u_assert(flash != NULL)) {
+		return FLASH_SET_COMPLETE_CALLBACK_FAILED;
+	}
+
+	flash->complete_callback = callback;
+	flash->complete_callback_ctx = ctx;
+
+	return FLASH_SET_COMPLETE_CALLBACK_OK;
 }
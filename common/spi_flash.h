@@ -25,13 +25,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-struct flash_dev {
-
-	uint32_t spi;
-	uint32_t cs_port;
-	uint8_t cs_pin;
-};
-
+/* Read commands supported by the part in addition to Read Data (0x03). */
+#define FLASH_CAP_FAST_READ        (1 << 0)
+#define FLASH_CAP_DUAL_OUTPUT_READ (1 << 1)
+#define FLASH_CAP_QUAD_OUTPUT_READ (1 << 2)
+/* Erase suspend (0x75) and resume (0x7A) */
+#define FLASH_CAP_SUSPEND          (1 << 3)
 
 struct flash_info {
 	uint32_t capacity;
@@ -40,6 +39,63 @@ struct flash_info {
 	uint32_t block_size;
 	char *manufacturer;
 	char *part;
+	uint32_t caps;
+
+	/* Maximum operation times in milliseconds. */
+	uint32_t page_program_time;
+	uint32_t sector_erase_time;
+	uint32_t block_erase_time;
+};
+
+
+struct flash_dev {
+
+	uint32_t spi;
+	uint32_t cs_port;
+	uint8_t cs_pin;
+
+	/**
+	 * DMA controller, streams and channel used for data transfers. If dma
+	 * is set to 0, all transfers are done by polling the SPI peripheral.
+	 */
+	uint32_t dma;
+	uint8_t dma_rx_stream;
+	uint8_t dma_tx_stream;
+	uint32_t dma_channel;
+
+	/**
+	 * Set while an asynchronous read started by flash_page_read_start is
+	 * in progress. The optional callback is called once it completes.
+	 */
+	volatile bool transfer_busy;
+	void (*transfer_callback)(struct flash_dev *flash, void *ctx);
+	void *transfer_callback_ctx;
+
+	/* Geometry and timing of the detected part. */
+	struct flash_info info;
+
+	/* Read command chosen from the part capabilities and number of dummy
+	 * bytes sent after the address. */
+	uint8_t read_cmd;
+	uint8_t read_dummy;
+
+	/**
+	 * Erase or program operation started by one of the *_start functions.
+	 * The chip stays busy until flash_poll reports completion or timeout.
+	 */
+	bool op_pending;
+	uint32_t op_start;
+	uint32_t op_timeout;
+
+	/**
+	 * A pending erase can be suspended to serve reads. It stays suspended
+	 * until another operation is started or the erase is polled.
+	 */
+	bool op_erase;
+	bool op_suspended;
+	uint32_t resume_time;
+	void (*complete_callback)(struct flash_dev *flash, int32_t result, void *ctx);
+	void *complete_callback_ctx;
 };
 
 
@@ -47,6 +103,20 @@ int32_t flash_init(struct flash_dev *flash, uint32_t spi, uint32_t cs_port, uint
 #define FLASH_INIT_OK 0
 #define FLASH_INIT_FAILED -1
 
+/**
+ * @brief Set the SPI clock prescaler.
+ *
+ * The lowest prescaler producing SPI clock not higher than the requested
+ * frequency is selected.
+ *
+ * @param flash The flash device.
+ * @param pclk Frequency of the peripheral bus clock feeding the SPI.
+ * @param max_freq Maximum allowed SPI clock frequency.
+ */
+int32_t flash_set_clock(struct flash_dev *flash, uint32_t pclk, uint32_t max_freq);
+#define FLASH_SET_CLOCK_OK 0
+#define FLASH_SET_CLOCK_FAILED -1
+
 int32_t flash_free(struct flash_dev *flash);
 #define FLASH_FREE_OK 0
 #define FLASH_FREE_FAILED -1
@@ -63,9 +133,18 @@ int32_t flash_get_status(struct flash_dev *flash, uint8_t *status);
 #define FLASH_GET_STATUS_OK 0
 #define FLASH_GET_STATUS_FAILED -1
 
+/**
+ * @brief Wait for the pending erase or program operation to finish.
+ *
+ * @return FLASH_WAIT_COMPLETE_OK if there is no operation pending or it has
+ *         completed successfully, FLASH_WAIT_COMPLETE_TIMEOUT if the chip has
+ *         not finished in the maximum operation time of the part or
+ *         FLASH_WAIT_COMPLETE_FAILED otherwise.
+ */
 int32_t flash_wait_complete(struct flash_dev *flash);
 #define FLASH_WAIT_COMPLETE_OK 0
 #define FLASH_WAIT_COMPLETE_FAILED -1
+#define FLASH_WAIT_COMPLETE_TIMEOUT -2
 
 int32_t flash_get_info(struct flash_dev *flash, struct flash_info *info);
 #define FLASH_GET_INFO_OK 0
@@ -83,6 +162,12 @@ int32_t flash_sector_erase(struct flash_dev *flash, const uint32_t addr);
 #define FLASH_SECTOR_ERASE_OK 0
 #define FLASH_SECTOR_ERASE_FAILED -1
 
+/**
+ * @brief Program data within a single flash page.
+ *
+ * The data must not cross a page boundary (the chip would wrap around to the
+ * beginning of the page), use flash_write for arbitrary data.
+ */
 int32_t flash_page_write(struct flash_dev *flash, const uint32_t addr, const uint8_t *data, const uint32_t len);
 #define FLASH_PAGE_WRITE_OK 0
 #define FLASH_PAGE_WRITE_FAILED -1
@@ -91,6 +176,124 @@ int32_t flash_page_read(struct flash_dev *flash, const uint32_t addr, uint8_t *d
 #define FLASH_PAGE_READ_OK 0
 #define FLASH_PAGE_READ_FAILED -1
 
+/**
+ * @brief Read any amount of data in a single transaction.
+ *
+ * The chip is selected only once, the read command and address are sent and
+ * the whole buffer is read continuously (the chip increments the address
+ * internally). If an erase is running and the part supports it, the erase
+ * is suspended instead of waiting for it to finish.
+ */
+int32_t flash_read(struct flash_dev *flash, const uint32_t addr, uint8_t *data, const uint32_t len);
+#define FLASH_READ_OK 0
+#define FLASH_READ_FAILED -1
+
+/**
+ * @brief Program any amount of data.
+ *
+ * Data are split at page boundaries and programmed page by page.
+ */
+int32_t flash_write(struct flash_dev *flash, const uint32_t addr, const uint8_t *data, const uint32_t len);
+#define FLASH_WRITE_OK 0
+#define FLASH_WRITE_FAILED -1
+
+/**
+ * @brief Use DMA for SPI data transfers.
+ *
+ * Page reads and writes longer than FLASH_DMA_MIN_LEN are done using the
+ * specified DMA streams (the RX and TX stream mapped to the SPI peripheral).
+ * Shorter transfers (commands, status reads, SFFS metadata) are always polled
+ * as the DMA setup overhead would outweigh the gain.
+ *
+ * @param flash The flash device.
+ * @param dma DMA controller or 0 to disable DMA transfers.
+ * @param rx_stream DMA stream serving the SPI RX request.
+ * @param tx_stream DMA stream serving the SPI TX request.
+ * @param channel Channel selection of both streams.
+ *
+ * @return FLASH_SET_DMA_OK on success or FLASH_SET_DMA_FAILED otherwise.
+ */
+int32_t flash_set_dma(struct flash_dev *flash, uint32_t dma, uint8_t rx_stream, uint8_t tx_stream, uint32_t channel);
+#define FLASH_SET_DMA_OK 0
+#define FLASH_SET_DMA_FAILED -1
+#define FLASH_DMA_MIN_LEN 16
+
+/**
+ * @brief Set a callback called when an asynchronous transfer completes.
+ *
+ * The callback is called from flash_transfer_poll (or flash_transfer_wait)
+ * right after the chip is deselected, it is allowed to start another transfer.
+ */
+int32_t flash_set_transfer_callback(struct flash_dev *flash, void (*callback)(struct flash_dev *flash, void *ctx), void *ctx);
+#define FLASH_SET_TRANSFER_CALLBACK_OK 0
+#define FLASH_SET_TRANSFER_CALLBACK_FAILED -1
+
+/**
+ * @brief Start reading data asynchronously.
+ *
+ * If DMA is enabled, the read command is sent and the data phase is left to
+ * the DMA controller, the function returns immediately. The CPU is free to
+ * do other work (eg. hash previously read data) until flash_transfer_poll
+ * reports the transfer has completed. Without DMA the read is done
+ * synchronously before returning. The data buffer must remain valid until
+ * the transfer completes. Any other flash operation waits for the pending
+ * transfer to complete first.
+ */
+int32_t flash_page_read_start(struct flash_dev *flash, const uint32_t addr, uint8_t *data, const uint32_t len);
+#define FLASH_PAGE_READ_START_OK 0
+#define FLASH_PAGE_READ_START_FAILED -1
+
+int32_t flash_transfer_poll(struct flash_dev *flash);
+#define FLASH_TRANSFER_POLL_DONE 0
+#define FLASH_TRANSFER_POLL_FAILED -1
+#define FLASH_TRANSFER_POLL_BUSY 1
+
+int32_t flash_transfer_wait(struct flash_dev *flash);
+#define FLASH_TRANSFER_WAIT_OK 0
+#define FLASH_TRANSFER_WAIT_FAILED -1
+
+/**
+ * @brief Start erase or program operations without waiting for completion.
+ *
+ * The command is sent and the function returns while the chip is still busy.
+ * Completion is checked using flash_poll (non-blocking) or flash_wait_complete.
+ * It is not necessary to wait explicitly, every following flash operation
+ * waits for the pending one to complete first. This allows the caller to
+ * receive or process the next data during a 45ms sector erase.
+ */
+int32_t flash_sector_erase_start(struct flash_dev *flash, const uint32_t addr);
+#define FLASH_SECTOR_ERASE_START_OK 0
+#define FLASH_SECTOR_ERASE_START_FAILED -1
+
+int32_t flash_block_erase_start(struct flash_dev *flash, const uint32_t addr);
+#define FLASH_BLOCK_ERASE_START_OK 0
+#define FLASH_BLOCK_ERASE_START_FAILED -1
+
+int32_t flash_page_write_start(struct flash_dev *flash, const uint32_t addr, const uint8_t *data, const uint32_t len);
+#define FLASH_PAGE_WRITE_START_OK 0
+#define FLASH_PAGE_WRITE_START_FAILED -1
+
+/**
+ * @brief Check the state of the pending erase or program operation.
+ *
+ * The completion callback (if set) is called once with the result when the
+ * operation finishes or times out.
+ *
+ * @return FLASH_POLL_DONE if no operation is pending anymore,
+ *         FLASH_POLL_BUSY if the chip is still busy,
+ *         FLASH_POLL_TIMEOUT if the operation exceeded its maximum time or
+ *         FLASH_POLL_FAILED otherwise.
+ */
+int32_t flash_poll(struct flash_dev *flash);
+#define FLASH_POLL_DONE 0
+#define FLASH_POLL_FAILED -1
+#define FLASH_POLL_TIMEOUT -2
+#define FLASH_POLL_BUSY 1
+
+int32_t flash_set_complete_callback(struct flash_dev *flash, void (*callback)(struct flash_dev *flash, int32_t result, void *ctx), void *ctx);
+#define FLASH_SET_COMPLETE_CALLBACK_OK 0
+#define FLASH_SET_COMPLETE_CALLBACK_FAILED -1
+
 
 
 
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 
 #include <libopencm3/cm3/systick.h>
+#include <libopencm3/stm32/rcc.h>
 
 #include "timer.h"
 
@@ -35,9 +36,9 @@ void sys_tick_handler(void) {
 
 
 int32_t timer_init(void) {
-	/* Init systick (1000Hz) */
+	/* Init systick (1000Hz) from the actual core clock. */
 	systick_set_clocksource(STK_CSR_CLKSOURCE_AHB);
-	systick_set_reload(15999);
+	systick_set_reload(rcc_ahb_frequency / 1000 - 1);
 	systick_interrupt_enable();
 	systick_counter_enable();
 
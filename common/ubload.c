@@ -33,6 +33,8 @@
 #include "spi_flash.h"
 #include "sffs.h"
 #include "fw_image.h"
+#include "verify_cache.h"
+#include "fw_catalogue.h"
 
 /* TODO: the whole file is meh. It needs to be rewritten. */
 
@@ -64,8 +66,25 @@ static void ubload_led_init(void) {
 struct flash_dev flash1;
 struct sffs flash_fs; /* TODO: cannot be static, CLI uses it */
 
+/* Pending sector formats and flash operations must be finished before the
+ * bootloader resets or jumps to the user code. */
+static void ubload_flash_sync(void) {
+	sffs_sector_format_complete(&flash_fs);
+	flash_wait_complete(&flash1);
+}
+
 static void ubload_flash_init(void) {
 	flash_init(&flash1, PORT_SPI_FLASH_PORT, PORT_SPI_FLASH_CS_PORT, PORT_SPI_FLASH_CS_PIN);
+	flash_set_clock(&flash1, PORT_SPI_FLASH_PCLK, PORT_SPI_FLASH_MAX_FREQ);
+	#if PORT_SPI_FLASH_DMA == true
+		flash_set_dma(
+			&flash1,
+			PORT_SPI_FLASH_DMA_PORT,
+			PORT_SPI_FLASH_DMA_RX,
+			PORT_SPI_FLASH_DMA_TX,
+			PORT_SPI_FLASH_DMA_CHANNEL
+		);
+	#endif
 
 	/* TODO: do this only if invalid flash data found. */
 	/* sffs_format(&flash1); */
@@ -128,6 +147,24 @@ static void ubload_config_init(void) {
 }
 
 
+#define UBLOAD_CONFIG_SAVE_OK 0
+#define UBLOAD_CONFIG_SAVE_FAILED -1
+static int32_t ubload_config_save(void) {
+	struct sffs_file f;
+	if (sffs_open(&flash_fs, &f, "ubload.cfg", SFFS_OVERWRITE) != SFFS_OPEN_OK) {
+		return UBLOAD_CONFIG_SAVE_FAILED;
+	}
+	if (sffs_write(&f, (uint8_t *)&running_config, sizeof(running_config)) != sizeof(running_config)) {
+		u_log(system_log, LOG_TYPE_ERROR, "config: error saving the configuration");
+		sffs_close(&f);
+		return UBLOAD_CONFIG_SAVE_FAILED;
+	}
+	sffs_close(&f);
+
+	return UBLOAD_CONFIG_SAVE_OK;
+}
+
+
 /*******************************************************************************
  * Serial port initialization and global variables
  *
@@ -189,7 +226,8 @@ static void ubload_cli(void) {
 				}
 
 				/* Reset on error, quit or reset command. */
-				fw_image_reset(&main_fw);
+				ubload_flash_sync();
+				fw_image_reset(main_fw);
 			}
 		} else {
 			/* Continue booting on error, no keypress or skip keypress
@@ -209,7 +247,7 @@ static void ubload_watchdog_init(void) {
 			u_log(system_log, LOG_TYPE_INFO, "Enabling watchdog");
 		}
 		/* TODO: make the watchdog interval configurable. */
-		fw_image_watchdog_enable(&main_fw, 5000);
+		fw_image_watchdog_enable(main_fw, 5000);
 	}
 }
 
@@ -222,7 +260,9 @@ static void ubload_boot(void) {
 	if (running_config.cli_enabled) {
 		u_log(system_log, LOG_TYPE_INFO, "ubload: jumping to user code");
 	}
-	fw_image_jump(&main_fw);
+	ubload_flash_sync();
+	port_clock_deinit();
+	fw_image_jump(main_fw);
 
 	while (1) {
 		;
@@ -231,53 +271,171 @@ static void ubload_boot(void) {
 
 
 /*******************************************************************************
- * Firmware verification and authentication.
+ * Firmware slots.
+ ******************************************************************************/
+#if PORT_FW_ALT == true
+	static struct fw_image fw_slots[2];
+	struct fw_image *main_fw = &fw_slots[0];
+	static struct fw_image *alt_fw = &fw_slots[1];
+#else
+	static struct fw_image fw_slot;
+	struct fw_image *main_fw = &fw_slot;
+#endif
+
+static void ubload_fw_init(void) {
+	#if PORT_FW_ALT == true
+		/* The selected slot is always accessed as main_fw, the other
+		 * slot keeps the previous firmware. The selection is checked
+		 * again by ubload_authenticate. */
+		if (running_config.fw_slot) {
+			fw_image_init(main_fw, (void *)FW_IMAGE_ALT_BASE, FW_IMAGE_ALT_BASE_SECTOR, FW_IMAGE_ALT_SECTORS);
+			fw_image_init(alt_fw, (void *)FW_IMAGE_BASE, FW_IMAGE_BASE_SECTOR, FW_IMAGE_SECTORS);
+		} else {
+			fw_image_init(main_fw, (void *)FW_IMAGE_BASE, FW_IMAGE_BASE_SECTOR, FW_IMAGE_SECTORS);
+			fw_image_init(alt_fw, (void *)FW_IMAGE_ALT_BASE, FW_IMAGE_ALT_BASE_SECTOR, FW_IMAGE_ALT_SECTORS);
+		}
+	#else
+		fw_image_init(main_fw, (void *)FW_IMAGE_BASE, FW_IMAGE_BASE_SECTOR, FW_IMAGE_SECTORS);
+	#endif
+}
+
+
+#if PORT_FW_ALT == true
+/**
+ * Switch to the other firmware slot. Images are swapped instead of being
+ * initialized again, the verification state of the new main_fw (eg. the
+ * hash computed while it was programmed) is kept.
+ */
+static void ubload_fw_switch(void) {
+	struct fw_image *tmp = main_fw;
+	main_fw = alt_fw;
+	alt_fw = tmp;
+	running_config.fw_slot = !running_config.fw_slot;
+}
+#endif
+
+
+/*******************************************************************************
+ * Firmware programming.
  ******************************************************************************/
+/**
+ * Program an already authenticated firmware file. If the port has two
+ * firmware slots, the image is programmed to the other one and the current
+ * firmware is kept intact until the programming succeeds.
+ */
+#define UBLOAD_PROGRAM_FW_OK 0
+#define UBLOAD_PROGRAM_FW_FAILED -1
+static int32_t ubload_program_fw(const char *fname) {
+	struct fw_image *target = main_fw;
+	#if PORT_FW_ALT == true
+		target = alt_fw;
+	#endif
+
+	/* Only the sectors required by the new image are erased during
+	 * programming. In the differential mode, sectors with unchanged
+	 * contents are not touched at all. */
+	u_log(system_log, LOG_TYPE_INFO, "ubload: programming firmware '%s'", fname);
+	if (running_config.cli_enabled) {
+		fw_image_set_progress_callback(target, cli_progress_callback, (void *)&console_cli);
+	}
+	bool programmed;
+	if (running_config.fw_update_diff) {
+		programmed = (fw_image_program_file_diff(target, &flash_fs, fname) == FW_IMAGE_PROGRAM_FILE_DIFF_OK);
+	} else {
+		programmed = (fw_image_program_file(target, &flash_fs, fname) == FW_IMAGE_PROGRAM_FILE_OK);
+	}
+
+	#if PORT_FW_ALT == true
+		/* Images are executed in place, switch to the new slot only if
+		 * the image was linked for it. */
+		if (programmed && fw_image_parse(target) == FW_IMAGE_PARSE_OK &&
+		    fw_image_check_location(target) == FW_IMAGE_CHECK_LOCATION_OK) {
+			ubload_fw_switch();
+			u_log(system_log, LOG_TYPE_INFO, "ubload: switched to firmware slot %u", (unsigned int)running_config.fw_slot);
+			return UBLOAD_PROGRAM_FW_OK;
+		}
+		u_log(system_log, LOG_TYPE_CRIT, "ubload: cannot use the new firmware, keeping the current slot");
+		return UBLOAD_PROGRAM_FW_FAILED;
+	#else
+		if (!programmed) {
+			u_log(system_log, LOG_TYPE_CRIT, "ubload: firmware programming failed");
+			return UBLOAD_PROGRAM_FW_FAILED;
+		}
+		return UBLOAD_PROGRAM_FW_OK;
+	#endif
+}
+
+
+/**
+ * Check if the firmware file contains the image which is already installed.
+ * The catalogue record of the file is used, the file is not read.
+ */
+static bool ubload_fw_installed(const char *fname) {
+	if (main_fw->parsed == false && fw_image_parse(main_fw) != FW_IMAGE_PARSE_OK) {
+		return false;
+	}
+
+	struct fw_catalogue_record rec;
+	if (main_fw->have_hash == false ||
+	    fw_catalogue_get(&flash_fs, fname, &rec) != FW_CATALOGUE_GET_OK ||
+	    rec.status != FW_CATALOGUE_STATUS_AUTHENTICATED ||
+	    rec.hash_len != main_fw->hash_len ||
+	    memcmp(rec.hash, main_fw->hash, main_fw->hash_len)) {
+		return false;
+	}
+
+	return true;
+}
+
+
 #define UBLOAD_CHECK_FW_OK 0
 #define UBLOAD_CHECK_FW_FAILED -1
 static int32_t ubload_check_fw(void) {
 	/* TODO: rename fw_request to fw_request */
 	/* Check if a new firmware programming is requested. */
+	if (strcmp("", running_config.fw_request) && ubload_fw_installed(running_config.fw_request)) {
+		u_log(system_log, LOG_TYPE_INFO, "ubload: requested firmware '%s' is already installed", running_config.fw_request);
+		strlcpy(running_config.fw_request, "", sizeof(running_config.fw_request));
+		if (ubload_config_save() != UBLOAD_CONFIG_SAVE_OK) {
+			return UBLOAD_CHECK_FW_FAILED;
+		}
+	}
 	if (strcmp("", running_config.fw_request)) {
 
+		/* Make backup firmware only if we are not flashing the backup
+		 * itself. It is done first as the backup is also the base image
+		 * for delta updates. */
 		if (strcmp("backup.fw", running_config.fw_request)) {
-			/* Make backup firmware only if we are not flashing the backup itself. */
 			u_log(system_log, LOG_TYPE_INFO, "ubload: new firmware requested, doing current firmware backup...");
 			if (running_config.cli_enabled) {
-				fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)&console_cli);
+				fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)&console_cli);
 			}
-			if (fw_image_dump_file(&main_fw, &flash_fs, "backup.fw") != FW_IMAGE_DUMP_FILE_OK) {
+			if (fw_image_dump_file(main_fw, &flash_fs, "backup.fw") != FW_IMAGE_DUMP_FILE_OK) {
 				u_log(system_log, LOG_TYPE_WARN, "ubload: cannot backup current firmware");
 			}
 		}
 
-		u_log(system_log, LOG_TYPE_INFO, "ubload: programming requested firmware '%s'", running_config.fw_request);
+		/* Check the requested image before the current firmware is
+		 * touched. An invalid image is never programmed. */
 		if (running_config.cli_enabled) {
-			fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)&console_cli);
+			fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)&console_cli);
 		}
-		fw_image_erase(&main_fw);
-		if (running_config.cli_enabled) {
-			fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)&console_cli);
-		}
-		fw_image_program_file(&main_fw, &flash_fs, running_config.fw_request);
+		if (fw_image_authenticate_file(main_fw, &flash_fs, running_config.fw_request) != FW_IMAGE_AUTHENTICATE_FILE_OK) {
+			u_log(system_log, LOG_TYPE_CRIT, "ubload: requested firmware '%s' is not valid, keeping the current one", running_config.fw_request);
+		} else {
+			ubload_program_fw(running_config.fw_request);
 
-		/* If a backup firmware was programmed, erase it. */
-		if (!strcmp("backup.fw", running_config.fw_request)) {
-			sffs_file_remove(&flash_fs, "backup.fw");
+			/* If a backup firmware was programmed, erase it. */
+			if (!strcmp("backup.fw", running_config.fw_request)) {
+				sffs_file_remove(&flash_fs, "backup.fw");
+				fw_catalogue_invalidate(&flash_fs, "backup.fw");
+			}
 		}
 
 		strlcpy(running_config.fw_request, "", sizeof(running_config.fw_request));
-		/* Save running configuration before reset. */
-		/* TODO: move away */
-		struct sffs_file f;
-		if (sffs_open(&flash_fs, &f, "ubload.cfg", SFFS_OVERWRITE) != SFFS_OPEN_OK) {
-			return UBLOAD_CHECK_FW_FAILED;
-		}
-		if (sffs_write(&f, (uint8_t *)&running_config, sizeof(running_config)) != sizeof(running_config)) {
-			u_log(system_log, LOG_TYPE_ERROR, "config: error saving the configuration");
+		if (ubload_config_save() != UBLOAD_CONFIG_SAVE_OK) {
 			return UBLOAD_CHECK_FW_FAILED;
 		}
-		sffs_close(&f);
 	}
 
 	return UBLOAD_CHECK_FW_OK;
@@ -287,70 +445,244 @@ static int32_t ubload_check_fw(void) {
 /*******************************************************************************
  * Firmware verification and authentication.
  ******************************************************************************/
-#define UBLOAD_AUTHENTICATE_OK 0
-#define UBLOAD_AUTHENTICATE_FAILED -1
-static int32_t ubload_authenticate(void) {
+/**
+ * Verify and authenticate a single firmware slot.
+ */
+#define UBLOAD_AUTHENTICATE_FW_OK 0
+#define UBLOAD_AUTHENTICATE_FW_FAILED -1
+static int32_t ubload_authenticate_fw(struct fw_image *fw) {
 
 	if (running_config.cli_enabled) {
-		fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)&console_cli);
+		fw_image_set_progress_callback(fw, cli_progress_callback, (void *)&console_cli);
+	}
+
+	/* Skip the signature check if the image was authenticated before and
+	 * its contents are confirmed to be unchanged. */
+	if (fw->parsed == false) {
+		fw_image_parse(fw);
+	}
+	if (running_config.verify_cache && verify_cache_check(fw) == VERIFY_CACHE_CHECK_OK) {
+		u_log(system_log, LOG_TYPE_INFO, "ubload: firmware unchanged since last authentication, skipping signature check");
+		fw->authenticated = true;
+		return UBLOAD_AUTHENTICATE_FW_OK;
 	}
 
-	if (fw_image_verify(&main_fw) != FW_IMAGE_VERIFY_OK) {
+	/* The image may have been verified already while it was programmed. */
+	if (fw->verified == false && fw_image_verify(fw) != FW_IMAGE_VERIFY_OK) {
 		u_log(system_log, LOG_TYPE_CRIT, "ubload: required firmware verification failed");
-		return UBLOAD_AUTHENTICATE_FAILED;
+		return UBLOAD_AUTHENTICATE_FW_FAILED;
 	}
 
-	if (fw_image_authenticate(&main_fw) != FW_IMAGE_AUTHENTICATE_OK) {
+	if (fw_image_authenticate(fw) != FW_IMAGE_AUTHENTICATE_OK) {
 		u_log(system_log, LOG_TYPE_CRIT, "ubload: required firmware authentication failed");
-		return UBLOAD_AUTHENTICATE_FAILED;
+		return UBLOAD_AUTHENTICATE_FW_FAILED;
+	}
+
+	if (fw_image_check_location(fw) != FW_IMAGE_CHECK_LOCATION_OK) {
+		return UBLOAD_AUTHENTICATE_FW_FAILED;
+	}
+
+	if (running_config.verify_cache) {
+		verify_cache_update(fw);
+	}
+
+	return UBLOAD_AUTHENTICATE_FW_OK;
+}
+
+
+#if PORT_FW_ALT == true
+/**
+ * Compare two version strings. Runs of digits are compared as numbers,
+ * other characters one by one (eg. "1.10" is newer than "1.9"). Returns
+ * a positive number if a is newer than b.
+ */
+static int32_t ubload_version_compare(const char *a, const char *b) {
+	while (*a != '\0' || *b != '\0') {
+		if (*a >= '0' && *a <= '9' && *b >= '0' && *b <= '9') {
+			while (*a == '0') {
+				a++;
+			}
+			while (*b == '0') {
+				b++;
+			}
+			size_t la = 0;
+			size_t lb = 0;
+			while (a[la] >= '0' && a[la] <= '9') {
+				la++;
+			}
+			while (b[lb] >= '0' && b[lb] <= '9') {
+				lb++;
+			}
+			if (la != lb) {
+				return (la > lb) ? 1 : -1;
+			}
+			int32_t c = memcmp(a, b, la);
+			if (c != 0) {
+				return c;
+			}
+			a += la;
+			b += lb;
+		} else {
+			if (*a != *b) {
+				return (int32_t)(unsigned char)*a - (int32_t)(unsigned char)*b;
+			}
+			a++;
+			b++;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Check if the image in the first slot is newer than the image in the
+ * second one. An image without a version is never newer.
+ */
+static bool ubload_fw_newer(struct fw_image *a, struct fw_image *b) {
+	if (a->parsed == false || a->have_version == false) {
+		return false;
 	}
-	return UBLOAD_AUTHENTICATE_OK;
+	if (b->parsed == false || b->have_version == false) {
+		return true;
+	}
+	return ubload_version_compare(a->version, b->version) > 0;
+}
+#endif
+
+
+/**
+ * Authenticate the firmware to be executed. If the port has two firmware
+ * slots, the newest valid image is selected. The newer image is tried
+ * first, the other one is authenticated only if it fails.
+ */
+#define UBLOAD_AUTHENTICATE_OK 0
+#define UBLOAD_AUTHENTICATE_FAILED -1
+static int32_t ubload_authenticate(void) {
+	#if PORT_FW_ALT == true
+		if (main_fw->parsed == false) {
+			fw_image_parse(main_fw);
+		}
+		if (alt_fw->parsed == false) {
+			fw_image_parse(alt_fw);
+		}
+
+		struct fw_image *first = main_fw;
+		struct fw_image *second = alt_fw;
+		if (ubload_fw_newer(alt_fw, main_fw)) {
+			first = alt_fw;
+			second = main_fw;
+		}
+
+		struct fw_image *selected = NULL;
+		if (ubload_authenticate_fw(first) == UBLOAD_AUTHENTICATE_FW_OK) {
+			selected = first;
+		} else if (ubload_authenticate_fw(second) == UBLOAD_AUTHENTICATE_FW_OK) {
+			selected = second;
+		} else {
+			return UBLOAD_AUTHENTICATE_FAILED;
+		}
+
+		if (selected != main_fw) {
+			ubload_fw_switch();
+			u_log(system_log, LOG_TYPE_WARN, "ubload: switched to firmware slot %u", (unsigned int)running_config.fw_slot);
+
+			/* The slot selection must survive a reset. */
+			if (ubload_config_save() != UBLOAD_CONFIG_SAVE_OK) {
+				return UBLOAD_AUTHENTICATE_FAILED;
+			}
+		}
+		return UBLOAD_AUTHENTICATE_OK;
+	#else
+		return ubload_authenticate_fw(main_fw);
+	#endif
 }
 
+
 /*******************************************************************************
  * Firmware fallback if something is wrong
  ******************************************************************************/
-static void ubload_request_last(void) {
+/**
+ * Authenticate a fallback firmware file and program it if it is valid.
+ */
+#define UBLOAD_FALLBACK_TRY_OK 0
+#define UBLOAD_FALLBACK_TRY_FAILED -1
+static int32_t ubload_fallback_try(const char *fname) {
+	if (!strcmp("", fname)) {
+		return UBLOAD_FALLBACK_TRY_FAILED;
+	}
+
+	/* Do not read the whole file again if it is known to be corrupted. */
+	if (fw_catalogue_known_invalid(&flash_fs, fname)) {
+		u_log(system_log, LOG_TYPE_WARN, "ubload: fallback firmware '%s' is known to be invalid", fname);
+		return UBLOAD_FALLBACK_TRY_FAILED;
+	}
+
 	if (running_config.cli_enabled) {
-		fw_image_set_progress_callback(&main_fw, cli_progress_callback, (void *)&console_cli);
+		fw_image_set_progress_callback(main_fw, cli_progress_callback, (void *)&console_cli);
+	}
+	if (fw_image_authenticate_file(main_fw, &flash_fs, fname) != FW_IMAGE_AUTHENTICATE_FILE_OK) {
+		u_log(system_log, LOG_TYPE_WARN, "ubload: fallback firmware '%s' is not valid", fname);
+		return UBLOAD_FALLBACK_TRY_FAILED;
+	}
+
+	u_log(system_log, LOG_TYPE_WARN, "ubload: using fallback firmware '%s'", fname);
+	if (ubload_program_fw(fname) != UBLOAD_PROGRAM_FW_OK) {
+		return UBLOAD_FALLBACK_TRY_FAILED;
 	}
 
+	return UBLOAD_FALLBACK_TRY_OK;
+}
+
+
+/**
+ * Program the first valid fallback firmware in the same boot. The last
+ * working firmware is tried first, then the files from the fallback list
+ * in the configured order and the backup at last. Every candidate is
+ * authenticated before it is programmed. With two firmware slots, the
+ * other slot was already tried by ubload_authenticate.
+ */
+#define UBLOAD_FALLBACK_OK 0
+#define UBLOAD_FALLBACK_FAILED -1
+static int32_t ubload_fallback(void) {
 	u_log(system_log, LOG_TYPE_INFO, "ubload: doing fallback");
-	/* First we check if there is some known working firmware saved.
-	 * Request this firmware in this case. */
-	if (strcmp("", running_config.fw_working)) {
-		u_log(system_log, LOG_TYPE_WARN, "ubload: requesting last working firmware");
-		strlcpy(running_config.fw_request, running_config.fw_working, sizeof(running_config.fw_request));
-	} else {
-		/* No known working firmware, try to use backup. */
-		struct sffs_file f;
-		if (sffs_open(&flash_fs, &f, "backup.fw", SFFS_READ) == SFFS_OPEN_OK) {
-			sffs_close(&f);
-			u_log(system_log, LOG_TYPE_WARN, "ubload: requesting backup firmware");
-			strlcpy(running_config.fw_request, "backup.fw", sizeof(running_config.fw_request));
 
-		} else {
-			/* No backup available. */
-			u_log(system_log, LOG_TYPE_CRIT, "ubload: no fallback possible");
-			return;
+	bool found = (ubload_fallback_try(running_config.fw_working) == UBLOAD_FALLBACK_TRY_OK);
+
+	const char *list = running_config.fw_fallback;
+	while (!found && *list != '\0') {
+		char fname[CONFIG_FIRMWARE_ID_LEN];
+		size_t len = strcspn(list, ",");
+		if (len < sizeof(fname)) {
+			memcpy(fname, list, len);
+			fname[len] = '\0';
+			found = (ubload_fallback_try(fname) == UBLOAD_FALLBACK_TRY_OK);
+		}
+		list += len;
+		if (*list == ',') {
+			list++;
 		}
 	}
 
-	/* Save running configuration before reset. */
-	/* TODO: move away */
-	struct sffs_file f;
-	if (sffs_open(&flash_fs, &f, "ubload.cfg", SFFS_OVERWRITE) != SFFS_OPEN_OK) {
-		return;
+	if (!found) {
+		found = (ubload_fallback_try("backup.fw") == UBLOAD_FALLBACK_TRY_OK);
 	}
-	if (sffs_write(&f, (uint8_t *)&running_config, sizeof(running_config)) != sizeof(running_config)) {
-		u_log(system_log, LOG_TYPE_ERROR, "config: error saving the configuration");
-		return;
+
+	if (!found) {
+		u_log(system_log, LOG_TYPE_CRIT, "ubload: no fallback possible");
+		return UBLOAD_FALLBACK_FAILED;
 	}
-	sffs_close(&f);
+
+	#if PORT_FW_ALT == true
+		/* The new slot selection must survive a reset. */
+		if (ubload_config_save() != UBLOAD_CONFIG_SAVE_OK) {
+			return UBLOAD_FALLBACK_FAILED;
+		}
+	#endif
+
+	return UBLOAD_FALLBACK_OK;
 }
 
 
-struct fw_image main_fw;
 int main(void) {
 	/* Initialize circular log before any other things. */
 	#if PORT_CLOG == true
@@ -364,24 +696,26 @@ int main(void) {
 	ubload_flash_init();
 	ubload_config_init();
 
-	fw_image_init(&main_fw, (void *)FW_IMAGE_BASE, FW_IMAGE_BASE_SECTOR, FW_IMAGE_SECTORS);
+	ubload_fw_init();
 
 	ubload_serial_init();
 	ubload_cli();
 
 	if (ubload_check_fw() != UBLOAD_CHECK_FW_OK || ubload_authenticate() != UBLOAD_AUTHENTICATE_OK) {
-		ubload_request_last();
-
-		timer_wait_ms(2000);
-		fw_image_reset(&main_fw);
-
+		/* Recover in the same boot, reset only if there is no valid
+		 * fallback firmware. */
+		if (ubload_fallback() != UBLOAD_FALLBACK_OK || ubload_authenticate() != UBLOAD_AUTHENTICATE_OK) {
+			ubload_flash_sync();
+			timer_wait_ms(2000);
+			fw_image_reset(main_fw);
+		}
 	}
 
 	ubload_watchdog_init();
 	ubload_boot();
 
 	/* Unreachable. Reset just in case anything goes wrong. */
-	fw_image_reset(&main_fw);
+	fw_image_reset(main_fw);
 	while (1) {
 		;
 	}
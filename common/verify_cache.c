@@ -0,0 +1,250 @@
+/**
+ * uBLoad firmware verification cache
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/desig.h>
+
+#include "u_assert.h"
+#include "u_log.h"
+#include "sha512.h"
+#include "fw_image.h"
+#include "pubkey_storage.h"
+#include "verify_cache.h"
+
+
+/* Same as the pubkey storage, the table is erased with the bootloader. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+const struct verify_cache_slot verify_cache_slots[VERIFY_CACHE_SLOT_COUNT] = {
+	[0 ... VERIFY_CACHE_SLOT_COUNT - 1] = {
+		.base = 0xffffffff,
+		.len = 0xffffffff,
+		.hash_type = 0xffffffff,
+		.hash_len = 0xffffffff,
+		.hash = { [0 ... FW_IMAGE_HASH_MAX_SIZE - 1] = 0xff },
+		.mac = { [0 ... VERIFY_CACHE_MAC_SIZE - 1] = 0xff },
+		.commit = 0xffffffff,
+		.revoke = 0xffffffff,
+	}
+};
+#pragma GCC diagnostic pop
+
+
+/**
+ * Flash may be unlocked already if a programming session is running.
+ * Unlocking it again would lock the flash controller until the next reset.
+ */
+static void verify_cache_program(const void *dst, const void *src, uint32_t len) {
+	const uint8_t *data = (const uint8_t *)src;
+
+	bool locked = (FLASH_CR & FLASH_CR_LOCK) != 0;
+	if (locked) {
+		flash_unlock();
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		flash_program_byte((uint32_t)dst + i, data[i]);
+	}
+	if (locked) {
+		flash_lock();
+	}
+}
+
+
+/* Hash context is too large for the stack. */
+static struct fw_image_hash verify_cache_hash;
+
+/**
+ * The MAC key is a hash of the device unique ID and the public key storage
+ * salt, it is never saved anywhere. Records cannot be moved to another
+ * device and are ignored if the salt is not set.
+ */
+#define VERIFY_CACHE_MAC_OK 0
+#define VERIFY_CACHE_MAC_FAILED -1
+static int32_t verify_cache_mac(const struct verify_cache_slot *rec, uint8_t *mac) {
+	if (pubkey_storage_verify_salt() != PUBKEY_STORAGE_VERIFY_SALT_OK) {
+		return VERIFY_CACHE_MAC_FAILED;
+	}
+
+	uint32_t uid[3];
+	uint8_t key[SHA512_HASH_SIZE];
+	desig_get_unique_id(uid);
+	fw_image_hash_init(&verify_cache_hash, FW_IMAGE_SECTION_HASH_SHA512);
+	fw_image_hash_update(&verify_cache_hash, (const uint8_t *)uid, sizeof(uid));
+	fw_image_hash_update(&verify_cache_hash, pubkey_storage_salt, PUBKEY_STORAGE_SALT_SIZE);
+	fw_image_hash_final(&verify_cache_hash, key, sizeof(key));
+
+	fw_image_hash_init(&verify_cache_hash, FW_IMAGE_SECTION_HASH_SHA512);
+	fw_image_hash_update(&verify_cache_hash, key, sizeof(key));
+	fw_image_hash_update(&verify_cache_hash, (const uint8_t *)rec, offsetof(struct verify_cache_slot, mac));
+	fw_image_hash_final(&verify_cache_hash, mac, VERIFY_CACHE_MAC_SIZE);
+
+	return VERIFY_CACHE_MAC_OK;
+}
+
+
+static bool verify_cache_slot_empty(const struct verify_cache_slot *slot) {
+	const uint8_t *data = (const uint8_t *)slot;
+	for (uint32_t i = 0; i < sizeof(struct verify_cache_slot); i++) {
+		if (data[i] != 0xff) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/**
+ * Records are never moved, the last committed one is the actual record.
+ * Slots after the last committed one may be left incomplete by a reset
+ * during programming.
+ */
+static const struct verify_cache_slot *verify_cache_find(void) {
+	const struct verify_cache_slot *found = NULL;
+	for (uint32_t i = 0; i < VERIFY_CACHE_SLOT_COUNT; i++) {
+		if (verify_cache_slots[i].commit == VERIFY_CACHE_MAGIC) {
+			found = &verify_cache_slots[i];
+		}
+	}
+	if (found == NULL || found->revoke != 0xffffffff) {
+		return NULL;
+	}
+	return found;
+}
+
+
+static bool verify_cache_match(const struct verify_cache_slot *slot, struct fw_image *fw) {
+	return slot->base == (uint32_t)fw->base &&
+	       slot->len == fw->verified_section.len &&
+	       slot->hash_type == (uint32_t)fw->hash_type &&
+	       slot->hash_len == fw->hash_len &&
+	       fw->hash_len <= FW_IMAGE_HASH_MAX_SIZE &&
+	       !memcmp(slot->hash, fw->hash, fw->hash_len);
+}
+
+
+int32_t verify_cache_invalidate(void) {
+	const uint32_t revoked = 0;
+	int32_t ret = VERIFY_CACHE_INVALIDATE_OK;
+
+	for (uint32_t i = 0; i < VERIFY_CACHE_SLOT_COUNT; i++) {
+		const struct verify_cache_slot *slot = &verify_cache_slots[i];
+		if (slot->commit == VERIFY_CACHE_MAGIC && slot->revoke != revoked) {
+			verify_cache_program(&slot->revoke, &revoked, sizeof(revoked));
+			if (slot->revoke != revoked) {
+				ret = VERIFY_CACHE_INVALIDATE_FAILED;
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+int32_t verify_cache_update(struct fw_image *fw) {
+	if (u_assert(fw != NULL)) {
+		return VERIFY_CACHE_UPDATE_FAILED;
+	}
+
+	if (fw->verified == false || fw->authenticated == false || fw->have_hash == false) {
+		return VERIFY_CACHE_UPDATE_FAILED;
+	}
+
+	const struct verify_cache_slot *slot = verify_cache_find();
+	if (slot != NULL && verify_cache_match(slot, fw)) {
+		return VERIFY_CACHE_UPDATE_OK;
+	}
+
+	/* Revoke the previous record first, the new one may fail to save. */
+	verify_cache_invalidate();
+
+	slot = NULL;
+	for (uint32_t i = 0; i < VERIFY_CACHE_SLOT_COUNT; i++) {
+		if (verify_cache_slot_empty(&verify_cache_slots[i])) {
+			slot = &verify_cache_slots[i];
+			break;
+		}
+	}
+	if (slot == NULL) {
+		u_log(system_log, LOG_TYPE_WARN, "verify_cache: no free slot, firmware will be verified on every boot");
+		return VERIFY_CACHE_UPDATE_FAILED;
+	}
+
+	struct verify_cache_slot rec;
+	memset(&rec, 0xff, sizeof(rec));
+	rec.base = (uint32_t)fw->base;
+	rec.len = fw->verified_section.len;
+	rec.hash_type = (uint32_t)fw->hash_type;
+	rec.hash_len = fw->hash_len;
+	memcpy(rec.hash, fw->hash, fw->hash_len);
+	if (verify_cache_mac(&rec, rec.mac) != VERIFY_CACHE_MAC_OK) {
+		u_log(system_log, LOG_TYPE_WARN, "verify_cache: salt not set, firmware will be authenticated on every boot");
+		return VERIFY_CACHE_UPDATE_FAILED;
+	}
+
+	/* Commit the record only after all data is programmed. */
+	verify_cache_program(slot, &rec, offsetof(struct verify_cache_slot, commit));
+	if (memcmp(slot, &rec, offsetof(struct verify_cache_slot, commit))) {
+		u_log(system_log, LOG_TYPE_ERROR, "verify_cache: cannot save verification record");
+		return VERIFY_CACHE_UPDATE_FAILED;
+	}
+	rec.commit = VERIFY_CACHE_MAGIC;
+	verify_cache_program(&slot->commit, &rec.commit, sizeof(rec.commit));
+
+	return VERIFY_CACHE_UPDATE_OK;
+}
+
+
+int32_t verify_cache_check(struct fw_image *fw) {
+	if (u_assert(fw != NULL)) {
+		return VERIFY_CACHE_CHECK_FAILED;
+	}
+
+	if (fw->parsed == false || fw->have_hash == false) {
+		return VERIFY_CACHE_CHECK_FAILED;
+	}
+
+	const struct verify_cache_slot *slot = verify_cache_find();
+	if (slot == NULL || !verify_cache_match(slot, fw)) {
+		return VERIFY_CACHE_CHECK_FAILED;
+	}
+
+	uint8_t mac[VERIFY_CACHE_MAC_SIZE];
+	if (verify_cache_mac(slot, mac) != VERIFY_CACHE_MAC_OK || memcmp(mac, slot->mac, sizeof(mac))) {
+		u_log(system_log, LOG_TYPE_WARN, "verify_cache: record MAC mismatch");
+		return VERIFY_CACHE_CHECK_FAILED;
+	}
+
+	/* The record says the image was authenticated, confirm that the
+	 * contents still have the hash saved in the record. */
+	if (fw_image_hash_compare(fw, fw->verified_section.data, fw->verified_section.len, slot->hash) != FW_IMAGE_HASH_COMPARE_OK) {
+		u_log(system_log, LOG_TYPE_WARN, "verify_cache: firmware contents changed, revoking the record");
+		verify_cache_invalidate();
+		return VERIFY_CACHE_CHECK_FAILED;
+	}
+	fw->verified = true;
+
+	return VERIFY_CACHE_CHECK_OK;
+}
@@ -0,0 +1,126 @@
+/**
+ * uBLoad firmware verification cache
+ *
+ * Copyright (C) 2015, Marek Koza, qyx@krtko.org
+ *
+ * This file is part of uMesh node firmware (http://qyx.krtko.org/projects/umesh)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VERIFY_CACHE_H_
+#define _VERIFY_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fw_image.h"
+
+#define VERIFY_CACHE_SLOT_COUNT 16
+#define VERIFY_CACHE_MAGIC 0x7c3a91d5
+#define VERIFY_CACHE_MAC_SIZE 32
+
+/**
+ * Verification record is saved after the firmware image is successfully
+ * verified and authenticated. If the record is valid during the next boot,
+ * the image signature need not be checked again.
+ *
+ * Records are kept in a write-once table in the bootloader flash. A new
+ * record is programmed to the first free slot, an existing one can only be
+ * revoked. No more records can be saved if the table is full, the firmware
+ * is fully verified and authenticated on every boot then.
+ *
+ * Each record is protected by a MAC keyed from device unique data (the
+ * unique ID and the public key storage salt). Records which were not
+ * written by the bootloader of this device are ignored.
+ */
+struct verify_cache_slot {
+	/**
+	 * Description of the verified image. The record is valid only for an
+	 * image with the same base, verified section length and hash.
+	 */
+	uint32_t base;
+	uint32_t len;
+	uint32_t hash_type;
+	uint32_t hash_len;
+	uint8_t hash[FW_IMAGE_HASH_MAX_SIZE];
+
+	/**
+	 * Truncated SHA512 of the device key followed by all previous
+	 * members.
+	 */
+	uint8_t mac[VERIFY_CACHE_MAC_SIZE];
+
+	/**
+	 * Set to VERIFY_CACHE_MAGIC after all other members are programmed.
+	 * Slots with incomplete data are never used.
+	 */
+	uint32_t commit;
+
+	/**
+	 * Cleared when the firmware image is erased or programmed. The record
+	 * is valid only if no bit is cleared.
+	 */
+	uint32_t revoke;
+};
+
+extern const struct verify_cache_slot verify_cache_slots[VERIFY_CACHE_SLOT_COUNT];
+
+
+/**
+ * @brief Revoke all verification records.
+ *
+ * It must be called before the firmware image is modified.
+ *
+ * @return VERIFY_CACHE_INVALIDATE_OK if all records were revoked or
+ *         VERIFY_CACHE_INVALIDATE_FAILED otherwise.
+ */
+int32_t verify_cache_invalidate(void);
+#define VERIFY_CACHE_INVALIDATE_OK 0
+#define VERIFY_CACHE_INVALIDATE_FAILED -1
+
+/**
+ * @brief Save a verification record for a verified and authenticated image.
+ *
+ * Nothing is saved if a valid record for the same image exists already.
+ *
+ * @param fw Firmware image which was verified and authenticated.
+ *
+ * @return VERIFY_CACHE_UPDATE_OK if the record was saved or
+ *         VERIFY_CACHE_UPDATE_FAILED otherwise.
+ */
+int32_t verify_cache_update(struct fw_image *fw);
+#define VERIFY_CACHE_UPDATE_OK 0
+#define VERIFY_CACHE_UPDATE_FAILED -1
+
+/**
+ * @brief Check if the firmware image was authenticated before and confirm
+ *        its integrity.
+ *
+ * The image contents are hashed on every call and compared with the hash
+ * saved in the record, only the signature check is skipped. The record is
+ * revoked if the contents do not match.
+ *
+ * @param fw Parsed firmware image to check.
+ *
+ * @return VERIFY_CACHE_CHECK_OK if the image is intact and the signature
+ *         check can be skipped or VERIFY_CACHE_CHECK_FAILED if no valid
+ *         record was found or the image contents do not match.
+ */
+int32_t verify_cache_check(struct fw_image *fw);
+#define VERIFY_CACHE_CHECK_OK 0
+#define VERIFY_CACHE_CHECK_FAILED -1
+
+
+#endif
@@ -0,0 +1,140 @@
+/* BLAKE2s
+ * Unkeyed BLAKE2s-256 following RFC 7693, interface modelled after the
+ * SHA512 implementation by Daniel Beer <dlbeer@gmail.com>
+ *
+ * This file is in the public domain.
+ */
+
+#include "blake2s.h"
+
+static const uint32_t blake2s_iv[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint8_t sigma[10][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+};
+
+static inline uint32_t load32_le(const uint8_t *x)
+{
+	return (uint32_t)x[0] |
+		((uint32_t)x[1] << 8) |
+		((uint32_t)x[2] << 16) |
+		((uint32_t)x[3] << 24);
+}
+
+static inline void store32_le(uint8_t *x, uint32_t v)
+{
+	x[0] = v;
+	x[1] = v >> 8;
+	x[2] = v >> 16;
+	x[3] = v >> 24;
+}
+
+static inline uint32_t rot32(uint32_t x, int bits)
+{
+	return (x >> bits) | (x << (32 - bits));
+}
+
+#define G(a, b, c, d, x, y) do { \
+		v[a] = v[a] + v[b] + (x); \
+		v[d] = rot32(v[d] ^ v[a], 16); \
+		v[c] = v[c] + v[d]; \
+		v[b] = rot32(v[b] ^ v[c], 12); \
+		v[a] = v[a] + v[b] + (y); \
+		v[d] = rot32(v[d] ^ v[a], 8); \
+		v[c] = v[c] + v[d]; \
+		v[b] = rot32(v[b] ^ v[c], 7); \
+	} while (0)
+
+static void compress(struct blake2s_state *s, const uint8_t *blk, int last)
+{
+	uint32_t m[16];
+	uint32_t v[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		m[i] = load32_le(blk + i * 4);
+
+	for (i = 0; i < 8; i++) {
+		v[i] = s->h[i];
+		v[i + 8] = blake2s_iv[i];
+	}
+
+	/* Note: we assume the stream size fits in 32 bits */
+	v[12] ^= s->t;
+	if (last)
+		v[14] = ~v[14];
+
+	for (i = 0; i < 10; i++) {
+		const uint8_t *z = sigma[i];
+
+		G(0, 4,  8, 12, m[z[0]],  m[z[1]]);
+		G(1, 5,  9, 13, m[z[2]],  m[z[3]]);
+		G(2, 6, 10, 14, m[z[4]],  m[z[5]]);
+		G(3, 7, 11, 15, m[z[6]],  m[z[7]]);
+		G(0, 5, 10, 15, m[z[8]],  m[z[9]]);
+		G(1, 6, 11, 12, m[z[10]], m[z[11]]);
+		G(2, 7,  8, 13, m[z[12]], m[z[13]]);
+		G(3, 4,  9, 14, m[z[14]], m[z[15]]);
+	}
+
+	for (i = 0; i < 8; i++)
+		s->h[i] ^= v[i] ^ v[i + 8];
+}
+
+void blake2s_init(struct blake2s_state *s)
+{
+	memcpy(s->h, blake2s_iv, sizeof(s->h));
+
+	/* Parameter block: digest length 32, no key, fanout 1, depth 1 */
+	s->h[0] ^= 0x01010000 | BLAKE2S_HASH_SIZE;
+	s->t = 0;
+}
+
+void blake2s_block(struct blake2s_state *s, const uint8_t *blk)
+{
+	s->t += BLAKE2S_BLOCK_SIZE;
+	compress(s, blk, 0);
+}
+
+void blake2s_final(struct blake2s_state *s, const uint8_t *blk,
+		   size_t total_size)
+{
+	uint8_t temp[BLAKE2S_BLOCK_SIZE] = {0};
+	const size_t last_size = total_size - s->t;
+
+	if (last_size)
+		memcpy(temp, blk, last_size);
+
+	s->t = total_size;
+	compress(s, temp, 1);
+}
+
+void blake2s_get(const struct blake2s_state *s, uint8_t *hash,
+		 unsigned int offset, unsigned int len)
+{
+	uint8_t tmp[BLAKE2S_HASH_SIZE];
+	int i;
+
+	if (offset > BLAKE2S_HASH_SIZE)
+		return;
+
+	if (len > BLAKE2S_HASH_SIZE - offset)
+		len = BLAKE2S_HASH_SIZE - offset;
+
+	for (i = 0; i < 8; i++)
+		store32_le(tmp + i * 4, s->h[i]);
+
+	memcpy(hash, tmp + offset, len);
+}
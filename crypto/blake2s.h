@@ -0,0 +1,49 @@
+/* BLAKE2s
+ * Unkeyed BLAKE2s-256 following RFC 7693, interface modelled after the
+ * SHA512 implementation by Daniel Beer <dlbeer@gmail.com>
+ *
+ * This file is in the public domain.
+ */
+
+#ifndef BLAKE2S_H_
+#define BLAKE2S_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* BLAKE2s state. State is updated as data is fed in, and then the final
+ * hash can be read out in slices.
+ *
+ * Data is fed in as a sequence of full blocks terminated by a single
+ * final block. Unlike SHA512, the final block must not be empty unless
+ * the whole stream is empty, a full last block must be passed to
+ * blake2s_final.
+ */
+struct blake2s_state {
+	uint32_t	h[8];
+	uint32_t	t;
+};
+
+/* Set up a new context for 32 byte hash output */
+void blake2s_init(struct blake2s_state *s);
+
+/* Feed a full (non-final) block in */
+#define BLAKE2S_BLOCK_SIZE	64
+
+void blake2s_block(struct blake2s_state *s, const uint8_t *blk);
+
+/* Feed the last block in. The total stream size must be specified, the
+ * size of the block given is (total_size - bytes already fed), between 1
+ * and BLAKE2S_BLOCK_SIZE (or 0 for an empty stream).
+ */
+void blake2s_final(struct blake2s_state *s, const uint8_t *blk,
+		   size_t total_size);
+
+/* Fetch a slice of the hash result. */
+#define BLAKE2S_HASH_SIZE	32
+
+void blake2s_get(const struct blake2s_state *s, uint8_t *hash,
+		 unsigned int offset, unsigned int len);
+
+#endif
@@ -318,3 +318,111 @@ void ed25519_smult(struct ed25519_pt *r_out, const struct ed25519_pt *p,
 
 	ed25519_copy(r_out, &r);
 }
+
+void ed25519_neg(struct ed25519_pt *r, const struct ed25519_pt *a)
+{
+	f25519_neg(r->x, a->x);
+	f25519_copy(r->y, a->y);
+	f25519_neg(r->t, a->t);
+	f25519_copy(r->z, a->z);
+}
+
+/* Number of odd multiples of P computed for the variable point */
+#define POINT_TAB_SIZE		8
+
+/* Recode an exponent into signed odd digits, each digit followed by at
+ * least log2(2 * max + 1) zero digits, where max is the largest absolute
+ * value of a digit (2 * tab_size - 1). One extra digit is needed to
+ * hold the final carry.
+ */
+#define SLIDE_SIZE		(ED25519_EXPONENT_SIZE * 8 + 1)
+
+static void slide(int8_t *r, const uint8_t *e, int tab_size)
+{
+	const int max = tab_size * 2 - 1;
+	int i;
+
+	for (i = 0; i < SLIDE_SIZE - 1; i++)
+		r[i] = (e[i >> 3] >> (i & 7)) & 1;
+	r[SLIDE_SIZE - 1] = 0;
+
+	for (i = 0; i < SLIDE_SIZE; i++) {
+		int b;
+
+		if (!r[i])
+			continue;
+
+		for (b = 1; b <= 6 && i + b < SLIDE_SIZE; b++) {
+			int k;
+
+			if (!r[i + b])
+				continue;
+
+			if (r[i] + (r[i + b] << b) <= max) {
+				r[i] += r[i + b] << b;
+				r[i + b] = 0;
+			} else if (r[i] - (r[i + b] << b) >= -max) {
+				r[i] -= r[i + b] << b;
+				for (k = i + b; k < SLIDE_SIZE; k++) {
+					if (!r[k]) {
+						r[k] = 1;
+						break;
+					}
+					r[k] = 0;
+				}
+			} else {
+				break;
+			}
+		}
+	}
+}
+
+static void add_digit(struct ed25519_pt *r, const struct ed25519_pt *tab,
+		      int8_t digit)
+{
+	struct ed25519_pt n;
+
+	if (digit > 0) {
+		ed25519_add(r, r, &tab[digit >> 1]);
+	} else if (digit < 0) {
+		ed25519_neg(&n, &tab[(-digit) >> 1]);
+		ed25519_add(r, r, &n);
+	}
+}
+
+void ed25519_double_smult_vartime(struct ed25519_pt *r_out, const uint8_t *a,
+				  const uint8_t *b,
+				  const struct ed25519_pt *p)
+{
+	/* Too large for the stack, the function is not reentrant. */
+	static struct ed25519_pt tab[POINT_TAB_SIZE];
+	static int8_t sa[SLIDE_SIZE];
+	static int8_t sb[SLIDE_SIZE];
+	struct ed25519_pt p2;
+	struct ed25519_pt r;
+	int i;
+
+	slide(sa, a, ED25519_BASE_TAB_SIZE);
+	slide(sb, b, POINT_TAB_SIZE);
+
+	/* P, 3P, 5P, ... */
+	ed25519_copy(&tab[0], p);
+	ed25519_double(&p2, p);
+	for (i = 1; i < POINT_TAB_SIZE; i++)
+		ed25519_add(&tab[i], &tab[i - 1], &p2);
+
+	/* Skip leading zero digits */
+	for (i = SLIDE_SIZE - 1; i >= 0; i--)
+		if (sa[i] || sb[i])
+			break;
+
+	ed25519_copy(&r, &ed25519_neutral);
+
+	for (; i >= 0; i--) {
+		ed25519_double(&r, &r);
+		add_digit(&r, ed25519_base_tab, sa[i]);
+		add_digit(&r, tab, sb[i]);
+	}
+
+	ed25519_copy(r_out, &r);
+}
@@ -79,4 +79,21 @@ void ed25519_double(struct ed25519_pt *r, const struct ed25519_pt *a);
 void ed25519_smult(struct ed25519_pt *r, const struct ed25519_pt *a,
 		   const uint8_t *e);
 
+/* Variable-time operations. These leak the exponents through timing and
+ * must be used with public data only (eg. signature verification).
+ *
+ * double_smult_vartime() computes r = aB + bP using joint (Straus)
+ * multiplication of sliding window signed digit representations of
+ * both exponents. Odd multiples of the base point are taken from a
+ * precomputed table, multiples of P are computed on the fly.
+ */
+#define ED25519_BASE_TAB_SIZE	16
+
+extern const struct ed25519_pt ed25519_base_tab[ED25519_BASE_TAB_SIZE];
+
+void ed25519_neg(struct ed25519_pt *r, const struct ed25519_pt *a);
+void ed25519_double_smult_vartime(struct ed25519_pt *r, const uint8_t *a,
+				  const uint8_t *b,
+				  const struct ed25519_pt *p);
+
 #endif
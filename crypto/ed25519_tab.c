@@ -0,0 +1,362 @@
+/* Edwards curve operations, base point table
+ *
+ * This file is generated by tools/ed25519_tab.py, do not edit.
+ */
+
+#include "ed25519.h"
+
+/* Odd multiples of the base point in extended coordinates (z = 1) */
+const struct ed25519_pt ed25519_base_tab[ED25519_BASE_TAB_SIZE] = {
+	/* 1B */
+	{
+		.x = {
+			0x1a, 0xd5, 0x25, 0x8f, 0x60, 0x2d, 0x56, 0xc9,
+			0xb2, 0xa7, 0x25, 0x95, 0x60, 0xc7, 0x2c, 0x69,
+			0x5c, 0xdc, 0xd6, 0xfd, 0x31, 0xe2, 0xa4, 0xc0,
+			0xfe, 0x53, 0x6e, 0xcd, 0xd3, 0x36, 0x69, 0x21
+		},
+		.y = {
+			0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+			0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+			0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+			0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+		},
+		.t = {
+			0xa3, 0xdd, 0xb7, 0xa5, 0xb3, 0x8a, 0xde, 0x6d,
+			0xf5, 0x52, 0x51, 0x77, 0x80, 0x9f, 0xf0, 0x20,
+			0x7d, 0xe3, 0xab, 0x64, 0x8e, 0x4e, 0xea, 0x66,
+			0x65, 0x76, 0x8b, 0xd7, 0x0f, 0x5f, 0x87, 0x67
+		},
+		.z = {1, 0}
+	},
+	/* 3B */
+	{
+		.x = {
+			0x5c, 0xe2, 0xf8, 0xd3, 0x5f, 0x48, 0x62, 0xac,
+			0x86, 0x48, 0x62, 0x81, 0x19, 0x98, 0x43, 0x63,
+			0x3a, 0xc8, 0xda, 0x3e, 0x74, 0xae, 0xf4, 0x1f,
+			0x49, 0x8f, 0x92, 0x22, 0x4a, 0x9c, 0xae, 0x67
+		},
+		.y = {
+			0xd4, 0xb4, 0xf5, 0x78, 0x48, 0x68, 0xc3, 0x02,
+			0x04, 0x03, 0x24, 0x67, 0x17, 0xec, 0x16, 0x9f,
+			0xf7, 0x9e, 0x26, 0x60, 0x8e, 0xa1, 0x26, 0xa1,
+			0xab, 0x69, 0xee, 0x77, 0xd1, 0xb1, 0x67, 0x12
+		},
+		.t = {
+			0x1a, 0xa4, 0xb3, 0x78, 0xfa, 0x08, 0xf9, 0xcd,
+			0x4a, 0xfc, 0x16, 0xfb, 0x8b, 0x35, 0x27, 0x5c,
+			0x27, 0x15, 0xb9, 0xad, 0x83, 0x37, 0xef, 0xeb,
+			0x10, 0x95, 0xdd, 0xb1, 0x5c, 0x02, 0x4d, 0x2a
+		},
+		.z = {1, 0}
+	},
+	/* 5B */
+	{
+		.x = {
+			0x33, 0xf2, 0x2e, 0x32, 0xc0, 0x9c, 0x40, 0x91,
+			0xa5, 0xe1, 0x1b, 0x3e, 0xf9, 0x19, 0x28, 0x5c,
+			0xde, 0xa5, 0x2d, 0xd1, 0xf7, 0x7c, 0xef, 0xfc,
+			0x7b, 0x58, 0xe3, 0xad, 0x3e, 0xa7, 0xfd, 0x49
+		},
+		.y = {
+			0xed, 0xc8, 0x76, 0xd6, 0x83, 0x1f, 0xd2, 0x10,
+			0x5d, 0x0b, 0x43, 0x89, 0xca, 0x2e, 0x28, 0x31,
+			0x66, 0x46, 0x92, 0x89, 0x14, 0x6e, 0x2c, 0xe0,
+			0x6f, 0xae, 0xfe, 0x98, 0xb2, 0x25, 0x48, 0x5f
+		},
+		.t = {
+			0xd0, 0x01, 0xe8, 0xf3, 0xbc, 0x50, 0x19, 0x64,
+			0xbf, 0x26, 0x09, 0x00, 0x85, 0x4e, 0xb9, 0xaf,
+			0xf9, 0xc7, 0x36, 0x87, 0x50, 0xea, 0x60, 0x31,
+			0x4c, 0x3d, 0x59, 0x9c, 0x2c, 0x56, 0x5c, 0x74
+		},
+		.z = {1, 0}
+	},
+	/* 7B */
+	{
+		.x = {
+			0x07, 0x41, 0x0e, 0xf5, 0x1a, 0x98, 0x55, 0x58,
+			0x95, 0xce, 0xf1, 0xbb, 0xf3, 0x09, 0xe8, 0x83,
+			0x07, 0x81, 0x1d, 0x4b, 0x19, 0xee, 0xe3, 0xe9,
+			0x4e, 0xbd, 0xf4, 0xfc, 0x85, 0x86, 0x56, 0x14
+		},
+		.y = {
+			0xb8, 0x62, 0x40, 0x9f, 0xb5, 0xc4, 0xc4, 0x12,
+			0x3d, 0xf2, 0xab, 0xf7, 0x46, 0x2b, 0x88, 0xf0,
+			0x41, 0xad, 0x36, 0xdd, 0x68, 0x64, 0xce, 0x87,
+			0x2f, 0xd5, 0x47, 0x2b, 0xe3, 0x63, 0xc5, 0x31
+		},
+		.t = {
+			0x1b, 0xed, 0x87, 0x55, 0x56, 0x45, 0xbd, 0x10,
+			0xe4, 0xa4, 0x9a, 0x1e, 0x2a, 0x63, 0x94, 0x52,
+			0xb4, 0xba, 0xd5, 0x89, 0xc5, 0x2d, 0xe8, 0x9b,
+			0x1b, 0x5e, 0x16, 0x1d, 0xb1, 0x77, 0x9e, 0x11
+		},
+		.z = {1, 0}
+	},
+	/* 9B */
+	{
+		.x = {
+			0x5c, 0x71, 0x85, 0x51, 0x06, 0x23, 0xe0, 0xd3,
+			0x94, 0x02, 0x4e, 0x2e, 0x5c, 0x0e, 0xd8, 0x86,
+			0xb8, 0x22, 0x94, 0x6f, 0xe0, 0x36, 0xf3, 0x1b,
+			0x65, 0x71, 0x00, 0xc8, 0x70, 0xc9, 0x7c, 0x35
+		},
+		.y = {
+			0xc0, 0xf1, 0x22, 0x55, 0x84, 0x44, 0x4e, 0xc7,
+			0x30, 0x44, 0x6e, 0x23, 0x13, 0x90, 0x78, 0x1f,
+			0xfd, 0xd2, 0xf2, 0x56, 0xe9, 0xfc, 0xbe, 0xb2,
+			0xf4, 0x0d, 0xdd, 0xc2, 0xc2, 0x23, 0x3d, 0x7f
+		},
+		.t = {
+			0x65, 0xf4, 0xb2, 0x88, 0x6f, 0x38, 0x3b, 0x5c,
+			0x7e, 0x32, 0x70, 0xf7, 0xa0, 0xd4, 0xb3, 0x17,
+			0x74, 0xcd, 0x47, 0xf7, 0xad, 0x76, 0x66, 0xdb,
+			0xf9, 0xcb, 0x87, 0xea, 0x48, 0xfc, 0x70, 0x5c
+		},
+		.z = {1, 0}
+	},
+	/* 11B */
+	{
+		.x = {
+			0xcb, 0xf3, 0x7c, 0x20, 0xc1, 0xd2, 0x2f, 0xff,
+			0x52, 0xd5, 0x93, 0xc5, 0xb2, 0xa5, 0x81, 0xd3,
+			0x38, 0x24, 0x71, 0xd6, 0x8d, 0x07, 0xcf, 0xb6,
+			0x17, 0xe4, 0x4b, 0x15, 0xb1, 0x28, 0xe5, 0x14
+		},
+		.y = {
+			0x13, 0x37, 0x03, 0x6a, 0xc3, 0x2d, 0x8f, 0x30,
+			0xd4, 0x58, 0x9c, 0x3c, 0x1c, 0x59, 0x58, 0x12,
+			0xce, 0x0f, 0xff, 0x40, 0xe3, 0x7c, 0x6f, 0x5a,
+			0x97, 0xab, 0x21, 0x3f, 0x31, 0x82, 0x90, 0x2d
+		},
+		.t = {
+			0xd4, 0xee, 0x5b, 0xdb, 0x2e, 0xcf, 0x85, 0xeb,
+			0x37, 0xc8, 0x8f, 0xe1, 0xdd, 0x01, 0x00, 0x59,
+			0xbf, 0xad, 0x16, 0xf2, 0xbe, 0xa6, 0xca, 0x39,
+			0xa2, 0x28, 0x0f, 0x80, 0x65, 0xa5, 0xe6, 0x5a
+		},
+		.z = {1, 0}
+	},
+	/* 13B */
+	{
+		.x = {
+			0xed, 0x5f, 0xc0, 0xb7, 0x73, 0xe0, 0x80, 0x37,
+			0xb8, 0xb7, 0x22, 0x8d, 0xe8, 0xe3, 0x43, 0x88,
+			0x4f, 0x30, 0x2d, 0x28, 0xf0, 0xad, 0x33, 0xdb,
+			0xcc, 0x66, 0xf3, 0xd5, 0xe0, 0x27, 0x74, 0x10
+		},
+		.y = {
+			0x80, 0x1f, 0x40, 0xea, 0xae, 0xe1, 0xef, 0x87,
+			0x23, 0x27, 0x9a, 0x28, 0xb2, 0xcf, 0x40, 0x37,
+			0xb8, 0x89, 0xda, 0xd2, 0x22, 0x60, 0x46, 0x78,
+			0x74, 0x8b, 0x53, 0xed, 0x0d, 0xb0, 0xdb, 0x12
+		},
+		.t = {
+			0x53, 0x2f, 0xde, 0xe8, 0xcd, 0xdc, 0x2c, 0x52,
+			0xfc, 0x8e, 0x2e, 0xeb, 0x51, 0xaa, 0x14, 0x5b,
+			0x38, 0x23, 0x56, 0xcd, 0x61, 0xdd, 0xc0, 0xc5,
+			0x60, 0x64, 0xbe, 0x17, 0xb9, 0x06, 0x28, 0x41
+		},
+		.z = {1, 0}
+	},
+	/* 15B */
+	{
+		.x = {
+			0xc1, 0x8d, 0xa1, 0x66, 0x3e, 0x7f, 0x61, 0x90,
+			0xcb, 0x89, 0x01, 0x77, 0x74, 0x13, 0x63, 0xd9,
+			0x9e, 0x41, 0x20, 0x5d, 0xf9, 0xc6, 0x5a, 0xdc,
+			0x35, 0xc4, 0x2e, 0xec, 0xea, 0x2d, 0x16, 0x4f
+		},
+		.y = {
+			0xdf, 0x5c, 0x2e, 0xad, 0xc4, 0x4c, 0x6d, 0x94,
+			0xa1, 0x9a, 0x9a, 0xa1, 0x18, 0xaf, 0xe5, 0xac,
+			0x31, 0x93, 0xd2, 0x64, 0x01, 0xf7, 0x62, 0x51,
+			0xf5, 0x22, 0xff, 0x04, 0x2d, 0xfb, 0xcb, 0x12
+		},
+		.t = {
+			0x29, 0xbf, 0x92, 0x5c, 0x33, 0x7f, 0x0d, 0x14,
+			0xf5, 0xe5, 0x0a, 0xe4, 0x8f, 0xb6, 0x63, 0xfa,
+			0xe2, 0x0d, 0x76, 0x41, 0x22, 0xfd, 0x24, 0xab,
+			0x91, 0x74, 0xb7, 0x36, 0x0e, 0xf0, 0x33, 0x5e
+		},
+		.z = {1, 0}
+	},
+	/* 17B */
+	{
+		.x = {
+			0x6a, 0xdf, 0x76, 0xa8, 0x53, 0x78, 0x59, 0xc5,
+			0x4d, 0x0b, 0xa2, 0x85, 0x5b, 0x98, 0x94, 0x8d,
+			0x91, 0x72, 0xfd, 0xa2, 0x1e, 0x74, 0x50, 0xb8,
+			0xe9, 0x16, 0xb8, 0x7d, 0x5a, 0x2d, 0xc5, 0x7d
+		},
+		.y = {
+			0x04, 0xbe, 0x97, 0xec, 0x9b, 0xfe, 0x6c, 0xcd,
+			0x01, 0xf9, 0x34, 0x3b, 0x72, 0x88, 0xb1, 0x17,
+			0xb7, 0x9f, 0x91, 0xcc, 0x45, 0xc2, 0x4a, 0xf2,
+			0xf9, 0x3e, 0x00, 0x60, 0xca, 0x2b, 0x6d, 0x6f
+		},
+		.t = {
+			0x3f, 0x05, 0xb3, 0xc3, 0x96, 0xb5, 0xbb, 0xfd,
+			0x68, 0xbf, 0xa9, 0x0b, 0xa2, 0xda, 0x3f, 0xb7,
+			0x00, 0xeb, 0x76, 0xe0, 0xaa, 0x0c, 0x59, 0x45,
+			0xa7, 0x04, 0x2c, 0x50, 0xba, 0x1a, 0x03, 0x25
+		},
+		.z = {1, 0}
+	},
+	/* 19B */
+	{
+		.x = {
+			0x72, 0x44, 0xa9, 0x04, 0x3a, 0x1a, 0x79, 0x4f,
+			0xe7, 0x96, 0x46, 0x30, 0xa5, 0x81, 0xe2, 0xb0,
+			0xc1, 0xb9, 0x63, 0xd7, 0x40, 0xc1, 0xe8, 0x22,
+			0x70, 0x5c, 0xa4, 0x5b, 0x4a, 0xf7, 0x81, 0x1d
+		},
+		.y = {
+			0xb9, 0x55, 0x1d, 0x69, 0x02, 0x61, 0xfe, 0x83,
+			0x30, 0x5f, 0x43, 0x3f, 0x82, 0x30, 0x18, 0x2e,
+			0xf4, 0x5c, 0xd6, 0xdd, 0xb6, 0x5b, 0x7c, 0x22,
+			0x47, 0x43, 0x5a, 0xd9, 0x93, 0x5a, 0x18, 0x3f
+		},
+		.t = {
+			0x31, 0x11, 0x00, 0xc5, 0x27, 0x04, 0xc4, 0x8b,
+			0x52, 0x35, 0xe5, 0x1b, 0xe5, 0x09, 0xf3, 0x41,
+			0xf9, 0xfe, 0x14, 0x05, 0xed, 0x8c, 0xa4, 0x7f,
+			0xde, 0x50, 0x72, 0x1a, 0x16, 0x9c, 0xfd, 0x66
+		},
+		.z = {1, 0}
+	},
+	/* 21B */
+	{
+		.x = {
+			0x16, 0x57, 0x36, 0xf9, 0x7e, 0x3e, 0x5e, 0xc4,
+			0x3c, 0x07, 0x3d, 0xde, 0x1d, 0xcb, 0x52, 0xf2,
+			0xed, 0x41, 0x75, 0xd4, 0xf9, 0x88, 0x85, 0x95,
+			0x87, 0x0e, 0xb9, 0x5e, 0x8e, 0xc7, 0x0a, 0x6f
+		},
+		.y = {
+			0x9e, 0x28, 0x6d, 0x33, 0x51, 0x60, 0xc6, 0xff,
+			0x6e, 0xa5, 0xd8, 0xc7, 0xc5, 0xd5, 0x06, 0xae,
+			0x35, 0xcc, 0xf8, 0xf4, 0xdd, 0xe5, 0x23, 0xf3,
+			0xe5, 0x5a, 0x97, 0xb7, 0x16, 0xd1, 0x28, 0x66
+		},
+		.t = {
+			0x26, 0x0a, 0xfc, 0x78, 0xb0, 0xf0, 0xeb, 0x49,
+			0xd5, 0xf0, 0x73, 0x21, 0xd8, 0x39, 0xff, 0x43,
+			0x5b, 0xf9, 0xb9, 0xcd, 0x16, 0x07, 0xdd, 0x9d,
+			0xe0, 0x12, 0x79, 0x87, 0x09, 0xb4, 0x1f, 0x47
+		},
+		.z = {1, 0}
+	},
+	/* 23B */
+	{
+		.x = {
+			0x95, 0x4d, 0xe1, 0xd2, 0xb2, 0x98, 0x57, 0xab,
+			0x2c, 0xcc, 0xb7, 0xd9, 0x05, 0x1f, 0xf9, 0xca,
+			0x1b, 0x39, 0x2a, 0x22, 0x05, 0x5e, 0x91, 0x25,
+			0x56, 0xdb, 0x67, 0x3c, 0x42, 0xac, 0x88, 0x21
+		},
+		.y = {
+			0xee, 0xc0, 0x33, 0x2b, 0x78, 0x79, 0x3d, 0x66,
+			0xab, 0x69, 0x93, 0xa4, 0x1f, 0x7b, 0x27, 0x04,
+			0x05, 0xe5, 0x46, 0xfc, 0x23, 0x9a, 0xf6, 0x4d,
+			0x9a, 0xb7, 0x57, 0x9c, 0x55, 0x0c, 0x24, 0x23
+		},
+		.t = {
+			0xdb, 0x12, 0x9d, 0x9f, 0xc8, 0xfd, 0xe0, 0xb5,
+			0x11, 0x0b, 0xe3, 0x08, 0xba, 0x06, 0x26, 0x23,
+			0x75, 0x83, 0x05, 0x2b, 0xb7, 0x51, 0x44, 0x01,
+			0x6b, 0x7a, 0x07, 0x36, 0xf6, 0x54, 0x4b, 0x49
+		},
+		.z = {1, 0}
+	},
+	/* 25B */
+	{
+		.x = {
+			0x55, 0x34, 0x35, 0x36, 0x2c, 0x36, 0x19, 0x6b,
+			0xc0, 0x2d, 0x82, 0xcb, 0x2e, 0x55, 0x98, 0xca,
+			0x0f, 0x79, 0xb8, 0x0c, 0x37, 0x4b, 0x38, 0x09,
+			0xb0, 0xce, 0xd9, 0x1e, 0x47, 0x41, 0x42, 0x79
+		},
+		.y = {
+			0xd0, 0xdc, 0x11, 0xd3, 0x68, 0xbc, 0x62, 0x23,
+			0x91, 0x78, 0xf3, 0x83, 0x0a, 0x9a, 0xd7, 0x92,
+			0x9d, 0x8f, 0xee, 0x18, 0x8d, 0x2e, 0x77, 0x07,
+			0x72, 0xca, 0xdf, 0x3c, 0xc0, 0x18, 0xe9, 0x71
+		},
+		.t = {
+			0x18, 0x62, 0x7a, 0xb5, 0x70, 0xf2, 0x90, 0x5e,
+			0x5b, 0x4f, 0xdb, 0x8b, 0xe5, 0x76, 0xae, 0x63,
+			0xca, 0xec, 0xb5, 0x67, 0xf1, 0xc6, 0xf5, 0xc8,
+			0xf8, 0xc9, 0x03, 0x60, 0x4e, 0x31, 0x4e, 0x48
+		},
+		.z = {1, 0}
+	},
+	/* 27B */
+	{
+		.x = {
+			0x79, 0x80, 0x7f, 0x5a, 0x8f, 0x1d, 0x61, 0x29,
+			0xe7, 0xd4, 0xa1, 0x0a, 0x36, 0xb4, 0x88, 0x3a,
+			0xa9, 0xbb, 0x07, 0x21, 0x05, 0x5c, 0x3c, 0xa2,
+			0x5d, 0xfc, 0x2d, 0xc2, 0x80, 0xc1, 0x3b, 0x16
+		},
+		.y = {
+			0x39, 0x19, 0x50, 0x77, 0x86, 0x49, 0xe1, 0xba,
+			0x4d, 0x38, 0x00, 0xf8, 0xda, 0x20, 0xca, 0x38,
+			0xf6, 0x54, 0x0a, 0x6a, 0x76, 0xb9, 0x94, 0x81,
+			0x45, 0xf7, 0x83, 0xba, 0xa6, 0x07, 0x11, 0x63
+		},
+		.t = {
+			0x50, 0x80, 0x72, 0xfa, 0x74, 0xd7, 0xba, 0x0a,
+			0x67, 0x8e, 0x89, 0x2d, 0x9b, 0xd9, 0x4d, 0xee,
+			0x46, 0xb1, 0x9a, 0xbd, 0x3b, 0xe8, 0x85, 0xbc,
+			0x61, 0xa4, 0xbe, 0x25, 0xcc, 0xd9, 0x7e, 0x33
+		},
+		.z = {1, 0}
+	},
+	/* 29B */
+	{
+		.x = {
+			0x5d, 0x7a, 0x0f, 0xdb, 0xb5, 0x63, 0xb6, 0x9d,
+			0xe7, 0xa9, 0xa3, 0x61, 0x4b, 0xb2, 0x90, 0x38,
+			0xda, 0xe3, 0xac, 0xb8, 0x03, 0x39, 0x7e, 0xeb,
+			0xa0, 0x1d, 0xeb, 0xf3, 0x30, 0x2a, 0xa3, 0x39
+		},
+		.y = {
+			0x91, 0xc4, 0x67, 0x5d, 0x71, 0x03, 0xd2, 0x6d,
+			0x13, 0x23, 0x58, 0x34, 0xaf, 0x16, 0x3c, 0x80,
+			0xdc, 0x45, 0x00, 0x01, 0xa0, 0x9c, 0xaf, 0xa1,
+			0xc9, 0xf1, 0xc1, 0x5d, 0x67, 0x54, 0x4c, 0x4d
+		},
+		.t = {
+			0x28, 0xd1, 0x92, 0xfa, 0xac, 0x58, 0x1d, 0x59,
+			0x2a, 0xe4, 0x0a, 0x39, 0xc8, 0xc4, 0xef, 0x10,
+			0xe7, 0xd8, 0xbc, 0x66, 0xa2, 0x1d, 0x26, 0x82,
+			0xad, 0x25, 0xcd, 0xfa, 0x66, 0x46, 0xc7, 0x1d
+		},
+		.z = {1, 0}
+	},
+	/* 31B */
+	{
+		.x = {
+			0xe9, 0xc0, 0xfa, 0x8e, 0x65, 0xe4, 0xe0, 0x58,
+			0xf9, 0x1f, 0xf1, 0x25, 0x99, 0x35, 0x4d, 0x78,
+			0x15, 0x15, 0x59, 0xe7, 0xcc, 0x3f, 0xc3, 0x59,
+			0x1f, 0x83, 0xe2, 0xa0, 0x91, 0x53, 0x08, 0x38
+		},
+		.y = {
+			0x2a, 0xe6, 0x19, 0x4a, 0x94, 0x31, 0xcc, 0x55,
+			0x19, 0xd9, 0x9e, 0x66, 0x60, 0x46, 0xe2, 0x30,
+			0x1b, 0xc2, 0xfa, 0xb7, 0x4a, 0xe3, 0x34, 0x56,
+			0x9b, 0xf4, 0x29, 0xa8, 0x01, 0x80, 0x91, 0x42
+		},
+		.t = {
+			0x76, 0x60, 0x9d, 0xd8, 0x29, 0x26, 0x35, 0x6c,
+			0x00, 0x6a, 0x05, 0x1b, 0x5c, 0xd3, 0x14, 0xd4,
+			0x15, 0x82, 0x93, 0x10, 0x45, 0x7b, 0x42, 0x12,
+			0xc2, 0xd8, 0x0d, 0x67, 0xc1, 0x2b, 0x83, 0x1d
+		},
+		.z = {1, 0}
+	}
+};
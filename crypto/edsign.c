@@ -140,11 +140,13 @@ void edsign_sign(uint8_t *signature, const uint8_t *pub,
 	memcpy(signature + 32, s, 32);
 }
 
-uint8_t edsign_verify(const uint8_t *signature, const uint8_t *pub,
-		      const uint8_t *message, size_t len)
+uint8_t edsign_verify_point(const uint8_t *signature, const uint8_t *pub,
+			    const struct ed25519_pt *a,
+			    const uint8_t *message, size_t len)
 {
 	struct ed25519_pt p;
-	struct ed25519_pt q;
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
 	uint8_t lhs[F25519_SIZE];
 	uint8_t rhs[F25519_SIZE];
 	uint8_t z[FPRIME_SIZE];
@@ -153,16 +155,37 @@ uint8_t edsign_verify(const uint8_t *signature, const uint8_t *pub,
 	/* Compute z = H(R, A, M) */
 	hash_message(z, signature, pub, message, len);
 
-	/* sB = (ze + k)B = ... */
-	sm_pack(lhs, signature + 32);
+	/* sB = (ze + k)B = zA + R, so R = sB - zA. Only public values
+	 * are involved, variable-time multiplication can be used.
+	 */
+	ed25519_neg(&p, a);
+	ed25519_double_smult_vartime(&p, signature + 32, z, &p);
 
-	/* ... = zA + R */
-	ok &= upp(&p, pub);
-	ed25519_smult(&p, &p, z);
-	ok &= upp(&q, signature);
-	ed25519_add(&p, &p, &q);
-	pp(rhs, &p);
+	/* Compare with R in projective coordinates (R is affine) */
+	ok &= ed25519_try_unpack(x, y, signature);
+
+	f25519_mul__distinct(lhs, x, p.z);
+	f25519_normalize(lhs);
+	f25519_copy(rhs, p.x);
+	f25519_normalize(rhs);
+	ok &= f25519_eq(lhs, rhs);
+
+	f25519_mul__distinct(lhs, y, p.z);
+	f25519_normalize(lhs);
+	f25519_copy(rhs, p.y);
+	f25519_normalize(rhs);
 
 	/* Equal? */
 	return ok & f25519_eq(lhs, rhs);
 }
+
+uint8_t edsign_verify(const uint8_t *signature, const uint8_t *pub,
+		      const uint8_t *message, size_t len)
+{
+	struct ed25519_pt a;
+	uint8_t ok;
+
+	ok = upp(&a, pub);
+
+	return ok & edsign_verify_point(signature, pub, &a, message, len);
+}
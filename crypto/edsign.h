@@ -9,6 +9,8 @@
 
 #include <stdint.h>
 
+#include "ed25519.h"
+
 /* This is the Ed25519 signature system, as described in:
  *
  *     Daniel J. Bernstein, Niels Duif, Tanja Lange, Peter Schwabe, Bo-Yin
@@ -47,4 +49,13 @@ void edsign_sign(uint8_t *signature, const uint8_t *pub,
 uint8_t edsign_verify(const uint8_t *signature, const uint8_t *pub,
 		      const uint8_t *message, size_t len);
 
+/* Verify a message signature using a public key which was already
+ * unpacked and validated (see ed25519_try_unpack() and
+ * ed25519_project()). The packed key is still needed for hashing.
+ * Returns non-zero if ok.
+ */
+uint8_t edsign_verify_point(const uint8_t *signature, const uint8_t *pub,
+			    const struct ed25519_pt *a,
+			    const uint8_t *message, size_t len);
+
 #endif
@@ -83,6 +83,178 @@ void f25519_select(uint8_t *dst,
 		dst[i] = zero[i] ^ (mask & (one[i] ^ zero[i]));
 }
 
+#ifdef F25519_FAST
+
+/* Field arithmetic using eight 32-bit limbs (radix 2^32). Elements keep
+ * the byte string interface, limbs are loaded and stored on every
+ * operation. Multiplication is a 8x8 schoolbook product of 32x32->64
+ * multiply-accumulates (UMULL/UMAAL on Cortex-M4) followed by reduction
+ * with 2^256 = 38 mod p. The byte implementation is kept as the reference.
+ */
+
+#define F25519_LIMBS		8
+
+static inline void load_limbs(uint32_t *l, const uint8_t *x)
+{
+	int i;
+
+	for (i = 0; i < F25519_LIMBS; i++) {
+		l[i] = ((uint32_t)x[0]) | ((uint32_t)x[1] << 8) |
+		       ((uint32_t)x[2] << 16) | ((uint32_t)x[3] << 24);
+		x += 4;
+	}
+}
+
+static inline void store_limbs(uint8_t *x, const uint32_t *l)
+{
+	int i;
+
+	for (i = 0; i < F25519_LIMBS; i++) {
+		x[0] = l[i];
+		x[1] = l[i] >> 8;
+		x[2] = l[i] >> 16;
+		x[3] = l[i] >> 24;
+		x += 4;
+	}
+}
+
+/* Fold everything above bit 255 (carry is the part above bit 256) back
+ * using 2^255 = 19 mod p. */
+static inline void reduce_limbs(uint32_t *l, uint32_t carry)
+{
+	uint64_t c;
+	int i;
+
+	c = (uint64_t)((carry << 1) | (l[7] >> 31)) * 19;
+	l[7] &= 0x7fffffff;
+
+	for (i = 0; i < F25519_LIMBS; i++) {
+		c += l[i];
+		l[i] = c;
+		c >>= 32;
+	}
+}
+
+void f25519_add(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	uint32_t x[F25519_LIMBS];
+	uint32_t y[F25519_LIMBS];
+	uint64_t c = 0;
+	int i;
+
+	load_limbs(x, a);
+	load_limbs(y, b);
+
+	for (i = 0; i < F25519_LIMBS; i++) {
+		c += (uint64_t)x[i] + y[i];
+		x[i] = c;
+		c >>= 32;
+	}
+
+	reduce_limbs(x, c);
+	store_limbs(r, x);
+}
+
+/* Calculate a + 2p - b, to avoid underflow */
+static void sub_limbs(uint32_t *x, const uint32_t *y)
+{
+	int64_t c = 0;
+	int i;
+
+	/* 2p = 2^256 - 38 */
+	c = (int64_t)x[0] + 0xffffffda - y[0];
+	x[0] = c;
+	c >>= 32;
+	for (i = 1; i < F25519_LIMBS; i++) {
+		c += (int64_t)x[i] + 0xffffffff - y[i];
+		x[i] = c;
+		c >>= 32;
+	}
+
+	reduce_limbs(x, c);
+}
+
+void f25519_sub(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	uint32_t x[F25519_LIMBS];
+	uint32_t y[F25519_LIMBS];
+
+	load_limbs(x, a);
+	load_limbs(y, b);
+	sub_limbs(x, y);
+	store_limbs(r, x);
+}
+
+void f25519_neg(uint8_t *r, const uint8_t *a)
+{
+	uint32_t x[F25519_LIMBS] = {0};
+	uint32_t y[F25519_LIMBS];
+
+	load_limbs(y, a);
+	sub_limbs(x, y);
+	store_limbs(r, x);
+}
+
+void f25519_mul__distinct(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	uint32_t x[F25519_LIMBS];
+	uint32_t y[F25519_LIMBS];
+	uint32_t t[F25519_LIMBS * 2] = {0};
+	uint64_t c;
+	int i;
+	int j;
+
+	load_limbs(x, a);
+	load_limbs(y, b);
+
+	/* 512 bit product, a*b + t + c always fits in 64 bits. */
+	for (i = 0; i < F25519_LIMBS; i++) {
+		c = 0;
+		for (j = 0; j < F25519_LIMBS; j++) {
+			c += (uint64_t)x[i] * y[j] + t[i + j];
+			t[i + j] = c;
+			c >>= 32;
+		}
+		t[i + F25519_LIMBS] = c;
+	}
+
+	/* Reduce with 2^256 = 38 mod p */
+	c = 0;
+	for (i = 0; i < F25519_LIMBS; i++) {
+		c += (uint64_t)t[i + F25519_LIMBS] * 38 + t[i];
+		x[i] = c;
+		c >>= 32;
+	}
+
+	reduce_limbs(x, c);
+	store_limbs(r, x);
+}
+
+void f25519_mul(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	f25519_mul__distinct(r, a, b);
+}
+
+void f25519_mul_c(uint8_t *r, const uint8_t *a, uint32_t b)
+{
+	uint32_t x[F25519_LIMBS];
+	uint64_t c = 0;
+	int i;
+
+	load_limbs(x, a);
+
+	for (i = 0; i < F25519_LIMBS; i++) {
+		c += (uint64_t)x[i] * b;
+		x[i] = c;
+		c >>= 32;
+	}
+
+	reduce_limbs(x, c);
+	store_limbs(r, x);
+}
+
+#else
+
 void f25519_add(uint8_t *r, const uint8_t *a, const uint8_t *b)
 {
 	uint16_t c = 0;
@@ -213,6 +385,8 @@ void f25519_mul_c(uint8_t *r, const uint8_t *a, uint32_t b)
 	}
 }
 
+#endif
+
 void f25519_inv__distinct(uint8_t *r, const uint8_t *x)
 {
 	uint8_t s[F25519_SIZE];
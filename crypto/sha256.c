@@ -0,0 +1,190 @@
+/* SHA256
+ * Based on the SHA512 implementation by Daniel Beer <dlbeer@gmail.com>
+ *
+ * This file is in the public domain.
+ */
+
+#include "sha256.h"
+
+const struct sha256_state sha256_initial_state = { {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+} };
+
+static const uint32_t round_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t load32(const uint8_t *x)
+{
+	uint32_t r;
+
+	r = *(x++);
+	r = (r << 8) | *(x++);
+	r = (r << 8) | *(x++);
+	r = (r << 8) | *(x++);
+
+	return r;
+}
+
+static inline void store32(uint8_t *x, uint32_t v)
+{
+	x += 3;
+	*(x--) = v;
+	v >>= 8;
+	*(x--) = v;
+	v >>= 8;
+	*(x--) = v;
+	v >>= 8;
+	*(x--) = v;
+}
+
+static inline uint32_t rot32(uint32_t x, int bits)
+{
+	return (x >> bits) | (x << (32 - bits));
+}
+
+void sha256_block(struct sha256_state *s, const uint8_t *blk)
+{
+	uint32_t w[16];
+	uint32_t a, b, c, d, e, f, g, h;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = load32(blk);
+		blk += 4;
+	}
+
+	/* Load state */
+	a = s->h[0];
+	b = s->h[1];
+	c = s->h[2];
+	d = s->h[3];
+	e = s->h[4];
+	f = s->h[5];
+	g = s->h[6];
+	h = s->h[7];
+
+	for (i = 0; i < 64; i++) {
+		/* Compute value of w[i + 16]. w[wrap(i)] is currently w[i] */
+		const uint32_t wi = w[i & 15];
+		const uint32_t wi15 = w[(i + 1) & 15];
+		const uint32_t wi2 = w[(i + 14) & 15];
+		const uint32_t wi7 = w[(i + 9) & 15];
+		const uint32_t s0 =
+			rot32(wi15, 7) ^ rot32(wi15, 18) ^ (wi15 >> 3);
+		const uint32_t s1 =
+			rot32(wi2, 17) ^ rot32(wi2, 19) ^ (wi2 >> 10);
+
+		/* Round calculations */
+		const uint32_t S0 = rot32(a, 2) ^ rot32(a, 13) ^ rot32(a, 22);
+		const uint32_t S1 = rot32(e, 6) ^ rot32(e, 11) ^ rot32(e, 25);
+		const uint32_t ch = (e & f) ^ ((~e) & g);
+		const uint32_t temp1 = h + S1 + ch + round_k[i] + wi;
+		const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		const uint32_t temp2 = S0 + maj;
+
+		/* Update round state */
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+
+		/* w[wrap(i)] becomes w[i + 16] */
+		w[i & 15] = wi + s0 + wi7 + s1;
+	}
+
+	/* Store state */
+	s->h[0] += a;
+	s->h[1] += b;
+	s->h[2] += c;
+	s->h[3] += d;
+	s->h[4] += e;
+	s->h[5] += f;
+	s->h[6] += g;
+	s->h[7] += h;
+}
+
+void sha256_final(struct sha256_state *s, const uint8_t *blk,
+		  size_t total_size)
+{
+	uint8_t temp[SHA256_BLOCK_SIZE] = {0};
+	const size_t last_size = total_size & (SHA256_BLOCK_SIZE - 1);
+
+	if (last_size)
+		memcpy(temp, blk, last_size);
+	temp[last_size] = 0x80;
+
+	if (last_size > 55) {
+		sha256_block(s, temp);
+		memset(temp, 0, sizeof(temp));
+	}
+
+	/* Note: we assume total_size fits in 29 bits */
+	store32(temp + SHA256_BLOCK_SIZE - 4, total_size << 3);
+	sha256_block(s, temp);
+}
+
+void sha256_get(const struct sha256_state *s, uint8_t *hash,
+		unsigned int offset, unsigned int len)
+{
+	int i;
+
+	if (offset > SHA256_HASH_SIZE)
+		return;
+
+	if (len > SHA256_HASH_SIZE - offset)
+		len = SHA256_HASH_SIZE - offset;
+
+	/* Skip whole words */
+	i = offset >> 2;
+	offset &= 3;
+
+	/* Skip/read out bytes */
+	if (offset) {
+		uint8_t tmp[4];
+		unsigned int c = 4 - offset;
+
+		if (c > len)
+			c = len;
+
+		store32(tmp, s->h[i++]);
+		memcpy(hash, tmp + offset, c);
+		len -= c;
+		hash += c;
+	}
+
+	/* Read out whole words */
+	while (len >= 4) {
+		store32(hash, s->h[i++]);
+		hash += 4;
+		len -= 4;
+	}
+
+	/* Read out bytes */
+	if (len) {
+		uint8_t tmp[4];
+
+		store32(tmp, s->h[i]);
+		memcpy(hash, tmp, len);
+	}
+}
@@ -0,0 +1,52 @@
+/* SHA256
+ * Based on the SHA512 implementation by Daniel Beer <dlbeer@gmail.com>
+ *
+ * This file is in the public domain.
+ */
+
+#ifndef SHA256_H_
+#define SHA256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* SHA256 state. State is updated as data is fed in, and then the final
+ * hash can be read out in slices.
+ *
+ * Data is fed in as a sequence of full blocks terminated by a single
+ * partial block.
+ */
+struct sha256_state {
+	uint32_t	h[8];
+};
+
+/* Initial state */
+extern const struct sha256_state sha256_initial_state;
+
+/* Set up a new context */
+static inline void sha256_init(struct sha256_state *s)
+{
+	memcpy(s, &sha256_initial_state, sizeof(*s));
+}
+
+/* Feed a full block in */
+#define SHA256_BLOCK_SIZE	64
+
+void sha256_block(struct sha256_state *s, const uint8_t *blk);
+
+/* Feed the last partial block in. The total stream size must be
+ * specified. The size of the block given is assumed to be (total_size %
+ * SHA256_BLOCK_SIZE). This might be zero, but you still need to call
+ * this function to terminate the stream.
+ */
+void sha256_final(struct sha256_state *s, const uint8_t *blk,
+		  size_t total_size);
+
+/* Fetch a slice of the hash result. */
+#define SHA256_HASH_SIZE	32
+
+void sha256_get(const struct sha256_state *s, uint8_t *hash,
+		unsigned int offset, unsigned int len);
+
+#endif
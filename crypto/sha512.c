@@ -97,6 +97,130 @@ static inline uint64_t rot64(uint64_t x, int bits)
 	return (x >> bits) | (x << (64 - bits));
 }
 
+#ifdef SHA512_FAST
+
+/* Optimised block function for 32-bit cores (Cortex-M4). Rotations are
+ * done on 32-bit halves so each one compiles to a pair of shifted ORs
+ * using the barrel shifter, rounds are unrolled 8 times to avoid shuffling
+ * the working variables and the message schedule is computed on the fly.
+ * The portable version below is kept as the reference.
+ */
+
+#define HI(x) ((uint32_t)((x) >> 32))
+#define LO(x) ((uint32_t)(x))
+#define JOIN(hi, lo) (((uint64_t)(hi) << 32) | (lo))
+
+static inline uint64_t Sigma0(uint64_t x)
+{
+	const uint32_t hi = HI(x);
+	const uint32_t lo = LO(x);
+
+	/* rot 28 ^ rot 34 ^ rot 39 */
+	return JOIN(
+		((hi >> 28) | (lo << 4)) ^ ((lo >> 2) | (hi << 30)) ^ ((lo >> 7) | (hi << 25)),
+		((lo >> 28) | (hi << 4)) ^ ((hi >> 2) | (lo << 30)) ^ ((hi >> 7) | (lo << 25))
+	);
+}
+
+static inline uint64_t Sigma1(uint64_t x)
+{
+	const uint32_t hi = HI(x);
+	const uint32_t lo = LO(x);
+
+	/* rot 14 ^ rot 18 ^ rot 41 */
+	return JOIN(
+		((hi >> 14) | (lo << 18)) ^ ((hi >> 18) | (lo << 14)) ^ ((lo >> 9) | (hi << 23)),
+		((lo >> 14) | (hi << 18)) ^ ((lo >> 18) | (hi << 14)) ^ ((hi >> 9) | (lo << 23))
+	);
+}
+
+static inline uint64_t sigma0(uint64_t x)
+{
+	const uint32_t hi = HI(x);
+	const uint32_t lo = LO(x);
+
+	/* rot 1 ^ rot 8 ^ shr 7 */
+	return JOIN(
+		((hi >> 1) | (lo << 31)) ^ ((hi >> 8) | (lo << 24)) ^ (hi >> 7),
+		((lo >> 1) | (hi << 31)) ^ ((lo >> 8) | (hi << 24)) ^ ((lo >> 7) | (hi << 25))
+	);
+}
+
+static inline uint64_t sigma1(uint64_t x)
+{
+	const uint32_t hi = HI(x);
+	const uint32_t lo = LO(x);
+
+	/* rot 19 ^ rot 61 ^ shr 6 */
+	return JOIN(
+		((hi >> 19) | (lo << 13)) ^ ((lo >> 29) | (hi << 3)) ^ (hi >> 6),
+		((lo >> 19) | (hi << 13)) ^ ((hi >> 29) | (lo << 3)) ^ ((lo >> 6) | (hi << 26))
+	);
+}
+
+#define CH(e, f, g) ((g) ^ ((e) & ((f) ^ (g))))
+#define MAJ(a, b, c) (((a) & (b)) | ((c) & ((a) | (b))))
+
+/* Message word i, words 16 to 79 are computed in place. */
+#define W(i) ((i) < 16 ? w[i] : \
+	(w[(i) & 15] += sigma1(w[((i) + 14) & 15]) + \
+		w[((i) + 9) & 15] + sigma0(w[((i) + 1) & 15])))
+
+#define ROUND(a, b, c, d, e, f, g, h, i) do { \
+		const uint64_t t1 = h + Sigma1(e) + CH(e, f, g) + \
+			round_k[i] + W(i); \
+		d += t1; \
+		h = t1 + Sigma0(a) + MAJ(a, b, c); \
+	} while (0)
+
+void sha512_block(struct sha512_state *s, const uint8_t *blk)
+{
+	uint64_t w[16];
+	uint64_t a, b, c, d, e, f, g, h;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = JOIN(
+			((uint32_t)blk[0] << 24) | ((uint32_t)blk[1] << 16) |
+			((uint32_t)blk[2] << 8) | blk[3],
+			((uint32_t)blk[4] << 24) | ((uint32_t)blk[5] << 16) |
+			((uint32_t)blk[6] << 8) | blk[7]
+		);
+		blk += 8;
+	}
+
+	a = s->h[0];
+	b = s->h[1];
+	c = s->h[2];
+	d = s->h[3];
+	e = s->h[4];
+	f = s->h[5];
+	g = s->h[6];
+	h = s->h[7];
+
+	for (i = 0; i < 80; i += 8) {
+		ROUND(a, b, c, d, e, f, g, h, i);
+		ROUND(h, a, b, c, d, e, f, g, i + 1);
+		ROUND(g, h, a, b, c, d, e, f, i + 2);
+		ROUND(f, g, h, a, b, c, d, e, i + 3);
+		ROUND(e, f, g, h, a, b, c, d, i + 4);
+		ROUND(d, e, f, g, h, a, b, c, i + 5);
+		ROUND(c, d, e, f, g, h, a, b, i + 6);
+		ROUND(b, c, d, e, f, g, h, a, i + 7);
+	}
+
+	s->h[0] += a;
+	s->h[1] += b;
+	s->h[2] += c;
+	s->h[3] += d;
+	s->h[4] += e;
+	s->h[5] += f;
+	s->h[6] += g;
+	s->h[7] += h;
+}
+
+#else
+
 void sha512_block(struct sha512_state *s, const uint8_t *blk)
 {
 	uint64_t w[16];
@@ -162,6 +286,8 @@ void sha512_block(struct sha512_state *s, const uint8_t *blk)
 	s->h[7] += h;
 }
 
+#endif
+
 void sha512_final(struct sha512_state *s, const uint8_t *blk,
 		  size_t total_size)
 {
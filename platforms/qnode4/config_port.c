@@ -24,18 +24,115 @@
 #include <stdlib.h>
 
 #include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/flash.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/timer.h>
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
 
 #include "config_port.h"
 
 
+int32_t port_clock_init(void) {
+	/* Start the HSE oscillator, do not wait forever if the crystal is
+	 * missing or broken, HSI is used as the PLL source instead. */
+	uint32_t pll_src = RCC_PLLCFGR_PLLSRC;
+	uint32_t pll_in = PORT_CLOCK_HSE_FREQ;
+	#if PORT_CLOCK_HSE == true
+		RCC_CR |= RCC_CR_HSEON;
+		uint32_t i = 0;
+		while ((RCC_CR & RCC_CR_HSERDY) == 0) {
+			if (++i >= PORT_CLOCK_HSE_TIMEOUT) {
+				RCC_CR &= ~RCC_CR_HSEON;
+				pll_src = 0;
+				pll_in = 16000000;
+				break;
+			}
+		}
+	#else
+		pll_src = 0;
+		pll_in = 16000000;
+	#endif
+
+	/* PLL input is always 1MHz. */
+	RCC_CR &= ~RCC_CR_PLLON;
+	RCC_PLLCFGR = ((pll_in / 1000000) << RCC_PLLCFGR_PLLM_SHIFT) |
+		(PORT_CLOCK_PLLN << RCC_PLLCFGR_PLLN_SHIFT) |
+		(((PORT_CLOCK_PLLP >> 1) - 1) << RCC_PLLCFGR_PLLP_SHIFT) |
+		(PORT_CLOCK_PLLQ << RCC_PLLCFGR_PLLQ_SHIFT) |
+		pll_src;
+	RCC_CR |= RCC_CR_PLLON;
+	while ((RCC_CR & RCC_CR_PLLRDY) == 0) {
+		;
+	}
+
+	/* Wait states must be set before switching to the higher frequency.
+	 * Caches are reset before they are enabled. */
+	flash_icache_disable();
+	flash_dcache_disable();
+	flash_icache_reset();
+	flash_dcache_reset();
+	flash_set_ws(PORT_CLOCK_FLASH_WS);
+	flash_prefetch_enable();
+	flash_icache_enable();
+	flash_dcache_enable();
+
+	rcc_set_hpre(RCC_CFGR_HPRE_DIV_NONE);
+	rcc_set_ppre1(RCC_CFGR_PPRE_DIV_2);
+	rcc_set_ppre2(RCC_CFGR_PPRE_DIV_NONE);
+
+	rcc_set_sysclk_source(RCC_CFGR_SW_PLL);
+	while (((RCC_CFGR >> RCC_CFGR_SWS_SHIFT) & RCC_CFGR_SWS_MASK) != RCC_CFGR_SWS_PLL) {
+		;
+	}
+
+	/* Used by libopencm3 to compute USART baudrates and by the bootloader
+	 * for SysTick and SPI prescalers. */
+	rcc_ahb_frequency = PORT_CLOCK_SYSCLK_FREQ;
+	rcc_apb1_frequency = PORT_CLOCK_SYSCLK_FREQ / 2;
+	rcc_apb2_frequency = PORT_CLOCK_SYSCLK_FREQ;
+
+	return PORT_CLOCK_INIT_OK;
+}
+
+
+int32_t port_clock_deinit(void) {
+	/* Return to the reset clock configuration (16MHz HSI) before jumping
+	 * to the user code, it expects the MCU in its reset state. */
+	RCC_CR |= RCC_CR_HSION;
+	while ((RCC_CR & RCC_CR_HSIRDY) == 0) {
+		;
+	}
+	rcc_set_sysclk_source(RCC_CFGR_SW_HSI);
+	while (((RCC_CFGR >> RCC_CFGR_SWS_SHIFT) & RCC_CFGR_SWS_MASK) != RCC_CFGR_SWS_HSI) {
+		;
+	}
+
+	rcc_set_hpre(RCC_CFGR_HPRE_DIV_NONE);
+	rcc_set_ppre1(RCC_CFGR_PPRE_DIV_NONE);
+	rcc_set_ppre2(RCC_CFGR_PPRE_DIV_NONE);
+	RCC_CR &= ~(RCC_CR_PLLON | RCC_CR_HSEON);
+	flash_set_ws(FLASH_ACR_LATENCY_0WS);
+
+	rcc_ahb_frequency = 16000000;
+	rcc_apb1_frequency = 16000000;
+	rcc_apb2_frequency = 16000000;
+
+	return PORT_CLOCK_DEINIT_OK;
+}
+
+
 int32_t port_mcu_init(void) {
+	port_clock_init();
+
 	rcc_periph_clock_enable(RCC_GPIOA);
 	rcc_periph_clock_enable(RCC_GPIOB);
 
+	#if PORT_CRC == true
+		rcc_periph_clock_enable(RCC_CRC);
+	#endif
+
 	#if PORT_SERIAL == true
 		#if PORT_SERIAL_USART == USART1
 			rcc_periph_clock_enable(RCC_USART1);
@@ -47,6 +144,11 @@ int32_t port_mcu_init(void) {
 		#if PORT_SPI_FLASH_PORT == SPI2
 			rcc_periph_clock_enable(RCC_SPI2);
 		#endif
+		#if PORT_SPI_FLASH_DMA == true
+			#if PORT_SPI_FLASH_DMA_PORT == DMA1
+				rcc_periph_clock_enable(RCC_DMA1);
+			#endif
+		#endif
 	#endif
 
 	return 0;
@@ -22,14 +22,29 @@
 #ifndef _CONFIG_PORT_H_
 #define _CONFIG_PORT_H_
 
+#include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/usart.h>
 #include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma.h>
 #include "version.h"
 
 #define PORT_NAME                  "qNode4"
 #define PORT_BANNER                "uBLoad (umeshFw bootloader)"
 
+/* System clock configuration. qNode4 uses STM32F401 (256K flash, 64K RAM)
+ * running at 84MHz max. PLL input is the HSE crystal (or HSI if the crystal
+ * fails to start) divided down to 1MHz, VCO runs at 336MHz, SYSCLK = VCO / 4,
+ * 48MHz clock = VCO / 7. APB1 runs at 42MHz, APB2 at 84MHz. */
+#define PORT_CLOCK_HSE             true
+#define PORT_CLOCK_HSE_FREQ        8000000
+#define PORT_CLOCK_HSE_TIMEOUT     100000
+#define PORT_CLOCK_PLLN            336
+#define PORT_CLOCK_PLLP            4
+#define PORT_CLOCK_PLLQ            7
+#define PORT_CLOCK_SYSCLK_FREQ     84000000
+#define PORT_CLOCK_FLASH_WS        FLASH_ACR_LATENCY_2WS
+
 /* Enable basic status/diagnostic LED functionality. */
 #define PORT_LED_BASIC             true
 #define PORT_LED_BASIC_PORT        GPIOA
@@ -53,12 +68,28 @@
 #define PORT_SERIAL_RX_PIN         7
 #define PORT_SERIAL_AF             GPIO_AF7
 
-/* Firmware image configuration */
+/* Firmware image configuration. If the alternative slot is enabled, the
+ * internal flash holds two executable images (sectors 2-4 and sector 5).
+ * Images must be linked for the slot they are programmed to. The slot is
+ * enabled by building with "scons FW_ALT=1". */
+#ifndef PORT_FW_ALT
+	#define PORT_FW_ALT                false
+#endif
 #define FW_IMAGE_BASE              0x08008000
-#define FW_IMAGE_SECTORS           4
+#if PORT_FW_ALT == true
+	#define FW_IMAGE_SECTORS           3
+#else
+	#define FW_IMAGE_SECTORS           4
+#endif
 #define FW_IMAGE_BASE_SECTOR       2
+#define FW_IMAGE_ALT_BASE          0x08020000
+#define FW_IMAGE_ALT_SECTORS       1
+#define FW_IMAGE_ALT_BASE_SECTOR   5
 #define FW_IMAGE_PROGRAM_SPEED     3
 
+/* Hardware CRC unit is used for firmware CRC32 checks. */
+#define PORT_CRC                   true
+
 /* Circular log configuration */
 #define PORT_CLOG                  true
 #define PORT_CLOG_BASE             0x20000000
@@ -69,9 +100,26 @@
 #define PORT_SPI_FLASH_PORT        SPI2
 #define PORT_SPI_FLASH_CS_PORT     GPIOB
 #define PORT_SPI_FLASH_CS_PIN      12
+#define PORT_SPI_FLASH_PCLK        rcc_apb1_frequency
+#define PORT_SPI_FLASH_MAX_FREQ    25000000
+
+/* SPI2 RX and TX requests are served by DMA1 streams 3 and 4, channel 0. */
+#define PORT_SPI_FLASH_DMA         true
+#define PORT_SPI_FLASH_DMA_PORT    DMA1
+#define PORT_SPI_FLASH_DMA_RX      DMA_STREAM3
+#define PORT_SPI_FLASH_DMA_TX      DMA_STREAM4
+#define PORT_SPI_FLASH_DMA_CHANNEL DMA_SxCR_CHSEL_0
+
+
 
 
+int32_t port_clock_init(void);
+#define PORT_CLOCK_INIT_OK 0
+#define PORT_CLOCK_INIT_FAILED -1
 
+int32_t port_clock_deinit(void);
+#define PORT_CLOCK_DEINIT_OK 0
+#define PORT_CLOCK_DEINIT_FAILED -1
 
 int32_t port_mcu_init(void);
 #define PORT_MCU_INIT_OK 0
@@ -0,0 +1,37 @@
+/* Host test stand-in for libopencm3, implemented by the test. */
+
+#ifndef _STUB_DMA_H_
+#define _STUB_DMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DMA_SxCR_PL_HIGH (2 << 16)
+#define DMA_SxCR_MSIZE_8BIT 0
+#define DMA_SxCR_PSIZE_8BIT 0
+#define DMA_SxCR_DIR_PERIPHERAL_TO_MEM 0
+#define DMA_SxCR_DIR_MEM_TO_PERIPHERAL (1 << 6)
+
+#define DMA_FEIF (1 << 0)
+#define DMA_DMEIF (1 << 2)
+#define DMA_TEIF (1 << 3)
+#define DMA_HTIF (1 << 4)
+#define DMA_TCIF (1 << 5)
+
+void dma_stream_reset(uint32_t dma, uint8_t stream);
+void dma_channel_select(uint32_t dma, uint8_t stream, uint32_t channel);
+void dma_set_priority(uint32_t dma, uint8_t stream, uint32_t prio);
+void dma_set_memory_size(uint32_t dma, uint8_t stream, uint32_t mem_size);
+void dma_set_peripheral_size(uint32_t dma, uint8_t stream, uint32_t peripheral_size);
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t stream);
+void dma_disable_memory_increment_mode(uint32_t dma, uint8_t stream);
+void dma_set_transfer_mode(uint32_t dma, uint8_t stream, uint32_t direction);
+void dma_set_peripheral_address(uint32_t dma, uint8_t stream, uint32_t address);
+void dma_set_memory_address(uint32_t dma, uint8_t stream, uint32_t address);
+void dma_set_number_of_data(uint32_t dma, uint8_t stream, uint16_t number);
+void dma_enable_stream(uint32_t dma, uint8_t stream);
+void dma_disable_stream(uint32_t dma, uint8_t stream);
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t stream, uint32_t interrupts);
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t stream, uint32_t interrupts);
+
+#endif
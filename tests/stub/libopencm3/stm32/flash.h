@@ -0,0 +1,12 @@
+/* Host test stand-in for libopencm3, implemented by the test. */
+
+#ifndef _STUB_FLASH_H_
+#define _STUB_FLASH_H_
+
+#include <stdint.h>
+
+void flash_unlock(void);
+void flash_lock(void);
+void flash_program(uint32_t address, uint8_t *data, uint32_t len);
+
+#endif
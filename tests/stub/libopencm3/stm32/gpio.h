@@ -0,0 +1,11 @@
+/* Host test stand-in for libopencm3, implemented by the test. */
+
+#ifndef _STUB_GPIO_H_
+#define _STUB_GPIO_H_
+
+#include <stdint.h>
+
+void gpio_set(uint32_t gpioport, uint16_t gpios);
+void gpio_clear(uint32_t gpioport, uint16_t gpios);
+
+#endif
@@ -0,0 +1,6 @@
+/* Host test stand-in for libopencm3, nothing from rcc is used. */
+
+#ifndef _STUB_RCC_H_
+#define _STUB_RCC_H_
+
+#endif
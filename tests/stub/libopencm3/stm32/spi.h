@@ -0,0 +1,31 @@
+/* Host test stand-in for libopencm3, implemented by the test. */
+
+#ifndef _STUB_SPI_H_
+#define _STUB_SPI_H_
+
+#include <stdint.h>
+
+#define SPI_CR1_BR_FPCLK_DIV_2 0
+
+/* Only the address of the data register is used (as the DMA peripheral
+ * address). */
+extern volatile uint32_t spi_dr_sim;
+#define SPI_DR(spi) spi_dr_sim
+
+void spi_set_master_mode(uint32_t spi);
+void spi_set_baudrate_prescaler(uint32_t spi, uint8_t baudrate);
+void spi_set_clock_polarity_0(uint32_t spi);
+void spi_set_clock_phase_0(uint32_t spi);
+void spi_set_full_duplex_mode(uint32_t spi);
+void spi_set_unidirectional_mode(uint32_t spi);
+void spi_enable_software_slave_management(uint32_t spi);
+void spi_send_msb_first(uint32_t spi);
+void spi_set_nss_high(uint32_t spi);
+void spi_enable(uint32_t spi);
+uint16_t spi_xfer(uint32_t spi, uint16_t data);
+void spi_enable_rx_dma(uint32_t spi);
+void spi_disable_rx_dma(uint32_t spi);
+void spi_enable_tx_dma(uint32_t spi);
+void spi_disable_tx_dma(uint32_t spi);
+
+#endif
@@ -0,0 +1,13 @@
+/* Host test stand-in for the lineedit library (only types used by cli.h). */
+
+#ifndef _LINEEDIT_H_
+#define _LINEEDIT_H_
+
+#include <stdint.h>
+
+struct lineedit {
+	int32_t (*print_handler)(const char *s, void *ctx);
+	void *print_handler_ctx;
+};
+
+#endif
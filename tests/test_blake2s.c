@@ -0,0 +1,128 @@
+/**
+ * Host test of the BLAKE2s implementation. It is checked against the
+ * RFC 7693 example ("abc"), other known answers computed with the RFC 7693
+ * reference code and a reference hash of messages of all lengths up to
+ * four blocks.
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "blake2s.h"
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+#define MSG_MAX 1000000
+static uint8_t msg[MSG_MAX];
+
+#define LEN_MAX (4 * BLAKE2S_BLOCK_SIZE)
+static uint8_t hashes[(LEN_MAX + 1) * BLAKE2S_HASH_SIZE];
+
+
+/* The last block is passed to blake2s_final even if it is a full one. */
+static void hash(const uint8_t *m, size_t len, uint8_t *out) {
+	struct blake2s_state s;
+	size_t pos = 0;
+
+	blake2s_init(&s);
+	while (len - pos > BLAKE2S_BLOCK_SIZE) {
+		blake2s_block(&s, m + pos);
+		pos += BLAKE2S_BLOCK_SIZE;
+	}
+	blake2s_final(&s, m + pos, len);
+	blake2s_get(&s, out, 0, BLAKE2S_HASH_SIZE);
+}
+
+
+static void parse_hex(const char *hex, uint8_t *out) {
+	for (size_t i = 0; i < BLAKE2S_HASH_SIZE; i++) {
+		unsigned int b;
+		sscanf(hex + i * 2, "%2x", &b);
+		out[i] = b;
+	}
+}
+
+
+struct vector {
+	const char *msg;
+	size_t repeat;
+	const char *hash;
+};
+
+static const struct vector vectors[] = {
+	{
+		"abc", 1,
+		"508c5e8c327c14e2e1a72ba34eeb452f37458b209ed63a294d999b4c86675982"
+	}, {
+		"", 1,
+		"69217a3079908094e11121d042354a7c1f55b6482ca1a51e1b250dfd1ed0eef9"
+	}, {
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+		"6f4df5116a6f332edab1d9e10ee87df6557beab6259d7663f3bcd5722c13f189"
+	}, {
+		"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+		"hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+		"358dd2ed0780d4054e76cb6f3a5bce2841e8e2f547431d4d09db21b66d941fc7"
+	}, {
+		"a", 1000000,
+		"bec0c0e6cde5b67acb73b81f79a67a4079ae1c60dac9d2661af18e9f8b50dfa5"
+	},
+};
+
+
+static void test_vectors(void) {
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		const struct vector *v = &vectors[i];
+		size_t l = strlen(v->msg);
+		size_t len = l * v->repeat;
+		for (size_t j = 0; j < v->repeat; j++) {
+			memcpy(msg + j * l, v->msg, l);
+		}
+
+		uint8_t expected[BLAKE2S_HASH_SIZE];
+		uint8_t computed[BLAKE2S_HASH_SIZE];
+		parse_hex(v->hash, expected);
+		hash(msg, len, computed);
+		CHECK(memcmp(computed, expected, BLAKE2S_HASH_SIZE) == 0);
+	}
+}
+
+
+/**
+ * Messages 0, 1, 2, ... of all lengths from 0 to LEN_MAX are hashed, the
+ * hash of all results concatenated is compared with a reference value.
+ * All padding and block boundary cases are covered.
+ */
+static void test_lengths(void) {
+	for (size_t i = 0; i < LEN_MAX; i++) {
+		msg[i] = i;
+	}
+	for (size_t len = 0; len <= LEN_MAX; len++) {
+		hash(msg, len, hashes + len * BLAKE2S_HASH_SIZE);
+	}
+
+	uint8_t expected[BLAKE2S_HASH_SIZE];
+	uint8_t computed[BLAKE2S_HASH_SIZE];
+	parse_hex("ae7c30aa6e1742023839460afa2e74bd92614c0b79d61197da5bd214f1ab3101", expected);
+	hash(hashes, sizeof(hashes), computed);
+	CHECK(memcmp(computed, expected, BLAKE2S_HASH_SIZE) == 0);
+}
+
+
+int main(void) {
+	test_vectors();
+	test_lengths();
+
+	if (failed) {
+		printf("test_blake2s: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_blake2s: OK\n");
+	return 0;
+}
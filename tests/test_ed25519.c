@@ -0,0 +1,244 @@
+/**
+ * Host test of the variable-time Ed25519 signature verification. Accept and
+ * reject decisions of edsign_verify are compared with the previous
+ * implementation (two constant-time scalar multiplications, results
+ * compared packed) over valid, corrupted and random signatures.
+ *
+ * ed25519_double_smult_vartime is also compared with ed25519_smult directly.
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "f25519.h"
+#include "fprime.h"
+#include "ed25519.h"
+#include "sha512.h"
+#include "edsign.h"
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+#define ROUNDS 64
+#define MSG_MAX 300
+
+static const uint8_t ed25519_order[FPRIME_SIZE] = {
+	0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+	0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+
+/* xorshift64, the sequence is the same on every run. */
+static uint64_t rnd_state = 0x6a09e667f3bcc908ULL;
+static uint64_t rnd(void) {
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+
+static void rnd_fill(uint8_t *buf, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = rnd();
+	}
+}
+
+
+static void pack_point(uint8_t *packed, const struct ed25519_pt *p) {
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
+
+	ed25519_unproject(x, y, p);
+	ed25519_pack(packed, x, y);
+}
+
+
+static uint8_t unpack_point(struct ed25519_pt *p, const uint8_t *packed) {
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
+	uint8_t ok = ed25519_try_unpack(x, y, packed);
+
+	ed25519_project(p, x, y);
+	return ok;
+}
+
+
+/* z = H(R, A, M) reduced modulo the group order. */
+static void hash_message(uint8_t *z, const uint8_t *r, const uint8_t *a, const uint8_t *m, size_t len) {
+	static uint8_t buf[64 + MSG_MAX];
+	struct sha512_state s;
+	uint8_t hash[SHA512_HASH_SIZE];
+	size_t pos = 0;
+
+	memcpy(buf, r, 32);
+	memcpy(buf + 32, a, 32);
+	memcpy(buf + 64, m, len);
+	len += 64;
+
+	sha512_init(&s);
+	while (len - pos >= SHA512_BLOCK_SIZE) {
+		sha512_block(&s, buf + pos);
+		pos += SHA512_BLOCK_SIZE;
+	}
+	sha512_final(&s, buf + pos, len);
+	sha512_get(&s, hash, 0, SHA512_HASH_SIZE);
+	fprime_from_bytes(z, hash, SHA512_HASH_SIZE, ed25519_order);
+}
+
+
+/* Previous edsign_verify, sB is compared with zA + R. */
+static uint8_t verify_ref(const uint8_t *signature, const uint8_t *pub, const uint8_t *message, size_t len) {
+	struct ed25519_pt p;
+	struct ed25519_pt q;
+	uint8_t lhs[F25519_SIZE];
+	uint8_t rhs[F25519_SIZE];
+	uint8_t z[FPRIME_SIZE];
+	uint8_t ok = 1;
+
+	hash_message(z, signature, pub, message, len);
+
+	ed25519_smult(&p, &ed25519_base, signature + 32);
+	pack_point(lhs, &p);
+
+	ok &= unpack_point(&p, pub);
+	ed25519_smult(&p, &p, z);
+	ok &= unpack_point(&q, signature);
+	ed25519_add(&p, &p, &q);
+	pack_point(rhs, &p);
+
+	return ok & f25519_eq(lhs, rhs);
+}
+
+
+struct counts {
+	uint32_t accepted;
+	uint32_t rejected;
+};
+
+static void compare(const uint8_t *signature, const uint8_t *pub, const uint8_t *message, size_t len, struct counts *c) {
+	uint8_t ref = verify_ref(signature, pub, message, len);
+	uint8_t res = edsign_verify(signature, pub, message, len);
+	CHECK(ref == res);
+
+	if (res) {
+		c->accepted++;
+	} else {
+		c->rejected++;
+	}
+}
+
+
+static void test_signatures(void) {
+	struct counts valid = {0, 0};
+	struct counts corrupted = {0, 0};
+	struct counts random = {0, 0};
+
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		uint8_t secret[EDSIGN_SECRET_KEY_SIZE];
+		uint8_t pub[EDSIGN_PUBLIC_KEY_SIZE];
+		uint8_t signature[EDSIGN_SIGNATURE_SIZE];
+		uint8_t message[MSG_MAX];
+		size_t len = rnd() % MSG_MAX;
+
+		rnd_fill(secret, sizeof(secret));
+		rnd_fill(message, len);
+		edsign_sec_to_pub(pub, secret);
+		edsign_sign(signature, pub, secret, message, len);
+		compare(signature, pub, message, len, &valid);
+
+		/* -R instead of R, only the x coordinate differs. */
+		signature[31] ^= 0x80;
+		compare(signature, pub, message, len, &corrupted);
+		signature[31] ^= 0x80;
+
+		/* Single bit flipped in the signature, the key or the message. */
+		uint32_t where = rnd() % 3;
+		uint8_t *data = signature;
+		size_t data_len = sizeof(signature);
+		if (where == 1) {
+			data = pub;
+			data_len = sizeof(pub);
+		} else if (where == 2 && len > 0) {
+			data = message;
+			data_len = len;
+		}
+		size_t bit = rnd() % (data_len * 8);
+		data[bit / 8] ^= 1 << (bit % 8);
+		compare(signature, pub, message, len, &corrupted);
+
+		/* Random signature for a valid key. */
+		rnd_fill(signature, sizeof(signature));
+		compare(signature, pub, message, len, &random);
+
+		/* Random signature with a random key. */
+		rnd_fill(pub, sizeof(pub));
+		compare(signature, pub, message, len, &random);
+	}
+
+	CHECK(valid.accepted == ROUNDS);
+	CHECK(corrupted.accepted == 0);
+	CHECK(random.accepted == 0);
+}
+
+
+/* aB + bP must equal the sum of two constant-time multiplications. */
+static void test_double_smult(void) {
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		uint8_t a[ED25519_EXPONENT_SIZE];
+		uint8_t b[ED25519_EXPONENT_SIZE];
+		uint8_t k[ED25519_EXPONENT_SIZE];
+		struct ed25519_pt p;
+		struct ed25519_pt q;
+		struct ed25519_pt ref;
+		struct ed25519_pt res;
+		uint8_t ref_packed[F25519_SIZE];
+		uint8_t res_packed[F25519_SIZE];
+
+		rnd_fill(a, sizeof(a));
+		rnd_fill(b, sizeof(b));
+		rnd_fill(k, sizeof(k));
+		switch (i % 4) {
+			case 0:
+				memset(a, 0, sizeof(a));
+				break;
+			case 1:
+				memset(b, 0xff, sizeof(b));
+				break;
+			default:
+				break;
+		}
+
+		ed25519_smult(&p, &ed25519_base, k);
+
+		ed25519_smult(&ref, &ed25519_base, a);
+		ed25519_smult(&q, &p, b);
+		ed25519_add(&ref, &ref, &q);
+
+		ed25519_double_smult_vartime(&res, a, b, &p);
+
+		pack_point(ref_packed, &ref);
+		pack_point(res_packed, &res);
+		CHECK(memcmp(ref_packed, res_packed, F25519_SIZE) == 0);
+	}
+}
+
+
+int main(void) {
+	test_signatures();
+	test_double_smult();
+
+	if (failed) {
+		printf("test_ed25519: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_ed25519: OK\n");
+	return 0;
+}
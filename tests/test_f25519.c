@@ -0,0 +1,231 @@
+/**
+ * Host test of the F25519_FAST field arithmetic. The radix 2^32
+ * implementation is compared with the byte implementation, results are
+ * compared after f25519_normalize.
+ *
+ * crypto/f25519.c is built twice, the F25519_FAST build has its symbols
+ * renamed to f25519_fast_* (see the Makefile).
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "f25519.h"
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+void f25519_fast_add(uint8_t *r, const uint8_t *a, const uint8_t *b);
+void f25519_fast_sub(uint8_t *r, const uint8_t *a, const uint8_t *b);
+void f25519_fast_neg(uint8_t *r, const uint8_t *a);
+void f25519_fast_mul(uint8_t *r, const uint8_t *a, const uint8_t *b);
+void f25519_fast_mul__distinct(uint8_t *r, const uint8_t *a, const uint8_t *b);
+void f25519_fast_mul_c(uint8_t *r, const uint8_t *a, uint32_t b);
+
+#define ROUNDS 100000
+
+
+/* xorshift64, the sequence is the same on every run. */
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+static uint64_t rnd(void) {
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+
+/**
+ * Random field element representation. Besides uniformly random 256 bit
+ * values, values just above p (2^255 - 19) and close to 2^255 are
+ * generated often, they exercise the final carry folding.
+ */
+static void rnd_element(uint8_t *x) {
+	for (uint32_t i = 0; i < F25519_SIZE; i++) {
+		x[i] = rnd();
+	}
+
+	switch (rnd() % 7) {
+		case 0:
+			/* Uniform below 2^255. */
+			x[31] &= 0x7f;
+			break;
+		case 1:
+			/* p <= x < 2^255 */
+			memset(x + 1, 0xff, F25519_SIZE - 2);
+			x[0] = 0xed + (x[0] % 0x13);
+			x[31] = 0x7f;
+			break;
+		case 2:
+			/* 2^255 <= x < 2^255 + 2^16 */
+			memset(x + 2, 0x00, F25519_SIZE - 3);
+			x[31] = 0x80;
+			break;
+		case 3:
+			/* 2^255 - 2^16 <= x < 2^255 */
+			memset(x + 2, 0xff, F25519_SIZE - 3);
+			x[31] = 0x7f;
+			break;
+		case 4:
+			/* Small values. */
+			memset(x + 1, 0x00, F25519_SIZE - 1);
+			break;
+		default:
+			/* Uniform 256 bit. */
+			break;
+	}
+}
+
+
+static bool same(const uint8_t *a, const uint8_t *b) {
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
+
+	f25519_copy(x, a);
+	f25519_copy(y, b);
+	f25519_normalize(x);
+	f25519_normalize(y);
+
+	return memcmp(x, y, F25519_SIZE) == 0;
+}
+
+
+static void test_add_sub_neg(void) {
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		uint8_t a[F25519_SIZE];
+		uint8_t b[F25519_SIZE];
+		uint8_t ref[F25519_SIZE];
+		uint8_t fast[F25519_SIZE];
+		rnd_element(a);
+		rnd_element(b);
+
+		f25519_add(ref, a, b);
+		f25519_fast_add(fast, a, b);
+		CHECK(same(ref, fast));
+
+		f25519_sub(ref, a, b);
+		f25519_fast_sub(fast, a, b);
+		CHECK(same(ref, fast));
+
+		f25519_neg(ref, a);
+		f25519_fast_neg(fast, a);
+		CHECK(same(ref, fast));
+	}
+}
+
+
+static void test_mul(void) {
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		uint8_t a[F25519_SIZE];
+		uint8_t b[F25519_SIZE];
+		uint8_t ref[F25519_SIZE];
+		uint8_t fast[F25519_SIZE];
+		rnd_element(a);
+		rnd_element(b);
+
+		f25519_mul__distinct(ref, a, b);
+		f25519_fast_mul__distinct(fast, a, b);
+		CHECK(same(ref, fast));
+
+		/* In place operation. */
+		f25519_copy(ref, a);
+		f25519_copy(fast, a);
+		f25519_mul(ref, ref, b);
+		f25519_fast_mul(fast, fast, b);
+		CHECK(same(ref, fast));
+	}
+}
+
+
+/**
+ * The byte implementation accumulates b * 255 in 32 bits, the constant is
+ * limited to 23 bits. Curve constants (121665) are tested explicitly.
+ */
+static void test_mul_c(void) {
+	static const uint32_t constants[] = {0, 1, 2, 19, 38, 121665, 121666, 0x7fffff};
+
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		uint8_t a[F25519_SIZE];
+		uint8_t ref[F25519_SIZE];
+		uint8_t fast[F25519_SIZE];
+		rnd_element(a);
+
+		uint32_t c;
+		if (i < sizeof(constants) / sizeof(constants[0]) * 100) {
+			c = constants[i % (sizeof(constants) / sizeof(constants[0]))];
+		} else {
+			c = rnd() & 0x7fffff;
+		}
+
+		f25519_mul_c(ref, a, c);
+		f25519_fast_mul_c(fast, a, c);
+		CHECK(same(ref, fast));
+	}
+}
+
+
+/**
+ * Results of one operation are used as operands of the next one, as in the
+ * curve arithmetic. The unreduced outputs of both implementations may
+ * differ, each implementation is fed its own results.
+ */
+static void test_chain(void) {
+	uint8_t ref[2][F25519_SIZE];
+	uint8_t fast[2][F25519_SIZE];
+	rnd_element(ref[0]);
+	rnd_element(ref[1]);
+	memcpy(fast, ref, sizeof(fast));
+
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		uint32_t d = i & 1;
+		switch (rnd() % 5) {
+			case 0:
+				f25519_add(ref[d], ref[0], ref[1]);
+				f25519_fast_add(fast[d], fast[0], fast[1]);
+				break;
+			case 1:
+				f25519_sub(ref[d], ref[0], ref[1]);
+				f25519_fast_sub(fast[d], fast[0], fast[1]);
+				break;
+			case 2:
+				f25519_neg(ref[d], ref[!d]);
+				f25519_fast_neg(fast[d], fast[!d]);
+				break;
+			case 3:
+				f25519_mul(ref[d], ref[0], ref[1]);
+				f25519_fast_mul(fast[d], fast[0], fast[1]);
+				break;
+			default:
+				f25519_mul_c(ref[d], ref[!d], 121665);
+				f25519_fast_mul_c(fast[d], fast[!d], 121665);
+				break;
+		}
+		CHECK(same(ref[d], fast[d]));
+
+		/* Avoid getting stuck at zero. */
+		if (f25519_eq(ref[d], f25519_zero)) {
+			rnd_element(ref[d]);
+			f25519_copy(fast[d], ref[d]);
+		}
+	}
+}
+
+
+int main(void) {
+	test_add_sub_neg();
+	test_mul();
+	test_mul_c();
+	test_chain();
+
+	if (failed) {
+		printf("test_f25519: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_f25519: OK\n");
+	return 0;
+}
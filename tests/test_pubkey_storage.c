@@ -0,0 +1,251 @@
+/**
+ * Host test of the public key storage. Keys are saved to the slots and the
+ * unpacked keys cached in the slots are compared with the decompressed
+ * public keys. Corrupted slots must be refused.
+ *
+ * The internal flash is simulated by the storage tables themselves, they
+ * are made writable while the flash is unlocked.
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "u_log.h"
+#include "crc32.h"
+#include "f25519.h"
+#include "ed25519.h"
+#include "edsign.h"
+#include "pubkey_storage.h"
+
+#include <libopencm3/stm32/flash.h>
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+
+/*******************************************************************************
+ * System stubs.
+ ******************************************************************************/
+struct log_cbuffer *system_log;
+
+int u_assert_func(const char *expr, const char *fname, int line) {
+	printf("assertion %s failed (%s:%d)\n", expr, fname, line);
+	return 1;
+}
+
+int32_t log_cbuffer_printf(struct log_cbuffer *buf, uint8_t type, char *fmt, ...) {
+	(void)buf;
+	(void)type;
+	(void)fmt;
+	return 0;
+}
+
+/* Any CRC will do, it is only compared with itself. */
+int32_t crc32_compute(const uint8_t *data, uint32_t len, uint32_t *crc) {
+	uint32_t c = 0xffffffff;
+	for (uint32_t i = 0; i < len; i++) {
+		c ^= data[i];
+		for (uint32_t j = 0; j < 8; j++) {
+			c = (c >> 1) ^ (0xedb88320 & -(c & 1));
+		}
+	}
+	*crc = c;
+	return CRC32_COMPUTE_OK;
+}
+
+
+/*******************************************************************************
+ * Internal flash simulation. The storage tables are const, the pages they
+ * occupy are writable only while the flash is unlocked. Programming can
+ * only clear bits.
+ ******************************************************************************/
+static bool flash_unlocked;
+
+static void flash_protect(int prot) {
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)pubkey_storage_slots;
+	uintptr_t end = (uintptr_t)pubkey_storage_slots + sizeof(pubkey_storage_slots);
+	uintptr_t salt = (uintptr_t)pubkey_storage_salt;
+
+	if (salt < start) {
+		start = salt;
+	}
+	if (salt + PUBKEY_STORAGE_SALT_SIZE > end) {
+		end = salt + PUBKEY_STORAGE_SALT_SIZE;
+	}
+	start &= ~(page - 1);
+	end = (end + page - 1) & ~(page - 1);
+
+	if (mprotect((void *)start, end - start, prot)) {
+		perror("mprotect");
+		exit(1);
+	}
+}
+
+void flash_unlock(void) {
+	flash_protect(PROT_READ | PROT_WRITE);
+	flash_unlocked = true;
+}
+
+void flash_lock(void) {
+	flash_protect(PROT_READ);
+	flash_unlocked = false;
+}
+
+void flash_program(uint32_t address, uint8_t *data, uint32_t len) {
+	CHECK(flash_unlocked);
+	uint8_t *dst = (uint8_t *)(uintptr_t)address;
+	for (uint32_t i = 0; i < len; i++) {
+		dst[i] &= data[i];
+	}
+}
+
+/* Clear a set bit somewhere in the flash area. */
+static void flash_corrupt(const void *area, uint32_t len) {
+	flash_unlock();
+	uint8_t *data = (uint8_t *)(uintptr_t)area;
+	for (uint32_t i = 0; i < len * 8; i++) {
+		if (data[i / 8] & (1 << (i % 8))) {
+			data[i / 8] &= ~(1 << (i % 8));
+			break;
+		}
+	}
+	flash_lock();
+}
+
+
+/*******************************************************************************
+ * Tests.
+ ******************************************************************************/
+
+/* xorshift64, the sequence is the same on every run. */
+static uint64_t rnd_state = 0xbb67ae8584caa73bULL;
+static uint64_t rnd(void) {
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+
+static void rnd_fill(uint8_t *buf, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = rnd();
+	}
+}
+
+
+static bool same_element(const uint8_t *a, const uint8_t *b) {
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
+
+	f25519_copy(x, a);
+	f25519_copy(y, b);
+	f25519_normalize(x);
+	f25519_normalize(y);
+
+	return memcmp(x, y, F25519_SIZE) == 0;
+}
+
+
+/* The cached point must be the decompressed public key with z = 1. */
+static bool same_point(const struct ed25519_pt *p, const uint8_t *pub) {
+	uint8_t x[F25519_SIZE];
+	uint8_t y[F25519_SIZE];
+	struct ed25519_pt ref;
+
+	if (!ed25519_try_unpack(x, y, pub)) {
+		return false;
+	}
+	ed25519_project(&ref, x, y);
+
+	return same_element(p->x, ref.x) &&
+	       same_element(p->y, ref.y) &&
+	       same_element(p->t, ref.t) &&
+	       same_element(p->z, ref.z);
+}
+
+
+static void test_set_keys(void) {
+	uint8_t salt[PUBKEY_STORAGE_SALT_SIZE];
+	rnd_fill(salt, sizeof(salt));
+	CHECK(pubkey_storage_verify_salt() == PUBKEY_STORAGE_VERIFY_SALT_FAILED);
+	pubkey_storage_set_salt(salt, sizeof(salt));
+	CHECK(pubkey_storage_verify_salt() == PUBKEY_STORAGE_VERIFY_SALT_OK);
+
+	for (uint32_t i = 0; i < PUBKEY_STORAGE_SLOT_COUNT; i++) {
+		const struct pubkey_storage_slot *slot = &pubkey_storage_slots[i];
+		uint8_t secret[EDSIGN_SECRET_KEY_SIZE];
+		uint8_t pub[EDSIGN_PUBLIC_KEY_SIZE];
+		rnd_fill(secret, sizeof(secret));
+		edsign_sec_to_pub(pub, secret);
+
+		CHECK(pubkey_storage_check_if_slot_empty(slot) == PUBKEY_STORAGE_CHECK_IF_SLOT_EMPTY_EMPTY);
+		CHECK(pubkey_storage_set_slot_key(slot, pub, sizeof(pub)) == PUBKEY_STORAGE_SET_SLOT_KEY_OK);
+		CHECK(pubkey_storage_set_slot_key(slot, pub, sizeof(pub)) == PUBKEY_STORAGE_SET_SLOT_KEY_USED);
+		CHECK(pubkey_storage_verify_slot(slot) == PUBKEY_STORAGE_VERIFY_SLOT_OK);
+		CHECK(same_point(&slot->pubkey_point, pub));
+
+		/* Retrieve the key by its fingerprint and verify a signature. */
+		uint8_t fp[PUBKEY_STORAGE_SLOT_FP_SIZE];
+		uint8_t key[PUBKEY_STORAGE_SLOT_SIZE];
+		struct ed25519_pt point;
+		memcpy(fp, slot->pubkey_fp, sizeof(fp));
+		CHECK(pubkey_storage_get_slot_point_by_fp(fp, key, &point) == PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_OK);
+		CHECK(memcmp(key, pub, sizeof(pub)) == 0);
+		CHECK(same_point(&point, pub));
+
+		uint8_t message[100];
+		uint8_t signature[EDSIGN_SIGNATURE_SIZE];
+		rnd_fill(message, sizeof(message));
+		edsign_sign(signature, pub, secret, message, sizeof(message));
+		CHECK(edsign_verify_point(signature, key, &point, message, sizeof(message)));
+		message[0] ^= 1;
+		CHECK(!edsign_verify_point(signature, key, &point, message, sizeof(message)));
+	}
+}
+
+
+/* Slots 0 and 1 are corrupted, 2 and 3 must still be usable. */
+static void test_corrupted(void) {
+	uint8_t key[PUBKEY_STORAGE_SLOT_SIZE];
+	struct ed25519_pt point;
+	uint8_t fp[PUBKEY_STORAGE_SLOT_FP_SIZE];
+
+	memcpy(fp, pubkey_storage_slots[0].pubkey_fp, sizeof(fp));
+	flash_corrupt(&pubkey_storage_slots[0].pubkey_point, sizeof(struct ed25519_pt));
+	CHECK(pubkey_storage_verify_slot_point(&pubkey_storage_slots[0]) == PUBKEY_STORAGE_VERIFY_SLOT_POINT_FAILED);
+	CHECK(pubkey_storage_get_slot_point_by_fp(fp, key, &point) == PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED);
+
+	/* The tag is fine, the salted hash must not match. */
+	memcpy(fp, pubkey_storage_slots[1].pubkey_fp, sizeof(fp));
+	flash_corrupt(pubkey_storage_slots[1].pubkey_hash, PUBKEY_STORAGE_SLOT_HASH_SIZE);
+	CHECK(pubkey_storage_verify_slot_point(&pubkey_storage_slots[1]) == PUBKEY_STORAGE_VERIFY_SLOT_POINT_OK);
+	CHECK(pubkey_storage_get_slot_point_by_fp(fp, key, &point) == PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_FAILED);
+
+	for (uint32_t i = 2; i < PUBKEY_STORAGE_SLOT_COUNT; i++) {
+		memcpy(fp, pubkey_storage_slots[i].pubkey_fp, sizeof(fp));
+		CHECK(pubkey_storage_get_slot_point_by_fp(fp, key, &point) == PUBKEY_STORAGE_GET_SLOT_POINT_BY_FP_OK);
+	}
+}
+
+
+int main(void) {
+	test_set_keys();
+	test_corrupted();
+
+	if (failed) {
+		printf("test_pubkey_storage: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_pubkey_storage: OK\n");
+	return 0;
+}
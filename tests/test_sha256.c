@@ -0,0 +1,126 @@
+/**
+ * Host test of the SHA256 implementation. It is checked against the
+ * FIPS 180-4 examples and a reference hash of messages of all lengths up
+ * to four blocks.
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sha256.h"
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+#define MSG_MAX 1000000
+static uint8_t msg[MSG_MAX];
+
+#define LEN_MAX (4 * SHA256_BLOCK_SIZE)
+static uint8_t hashes[(LEN_MAX + 1) * SHA256_HASH_SIZE];
+
+
+static void hash(const uint8_t *m, size_t len, uint8_t *out) {
+	struct sha256_state s;
+	size_t pos = 0;
+
+	sha256_init(&s);
+	while (len - pos >= SHA256_BLOCK_SIZE) {
+		sha256_block(&s, m + pos);
+		pos += SHA256_BLOCK_SIZE;
+	}
+	sha256_final(&s, m + pos, len);
+	sha256_get(&s, out, 0, SHA256_HASH_SIZE);
+}
+
+
+static void parse_hex(const char *hex, uint8_t *out) {
+	for (size_t i = 0; i < SHA256_HASH_SIZE; i++) {
+		unsigned int b;
+		sscanf(hex + i * 2, "%2x", &b);
+		out[i] = b;
+	}
+}
+
+
+struct vector {
+	const char *msg;
+	size_t repeat;
+	const char *hash;
+};
+
+static const struct vector vectors[] = {
+	{
+		"abc", 1,
+		"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+	}, {
+		"", 1,
+		"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"
+	}, {
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+		"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+	}, {
+		"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+		"hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+		"cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"
+	}, {
+		"a", 1000000,
+		"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"
+	},
+};
+
+
+static void test_vectors(void) {
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		const struct vector *v = &vectors[i];
+		size_t l = strlen(v->msg);
+		size_t len = l * v->repeat;
+		for (size_t j = 0; j < v->repeat; j++) {
+			memcpy(msg + j * l, v->msg, l);
+		}
+
+		uint8_t expected[SHA256_HASH_SIZE];
+		uint8_t computed[SHA256_HASH_SIZE];
+		parse_hex(v->hash, expected);
+		hash(msg, len, computed);
+		CHECK(memcmp(computed, expected, SHA256_HASH_SIZE) == 0);
+	}
+}
+
+
+/**
+ * Messages 0, 1, 2, ... of all lengths from 0 to LEN_MAX are hashed, the
+ * hash of all results concatenated is compared with a reference value.
+ * All padding and block boundary cases are covered.
+ */
+static void test_lengths(void) {
+	for (size_t i = 0; i < LEN_MAX; i++) {
+		msg[i] = i;
+	}
+	for (size_t len = 0; len <= LEN_MAX; len++) {
+		hash(msg, len, hashes + len * SHA256_HASH_SIZE);
+	}
+
+	uint8_t expected[SHA256_HASH_SIZE];
+	uint8_t computed[SHA256_HASH_SIZE];
+	parse_hex("35970715cb0d62a006d72921e886dd4ea67151affe64b55164397fe5bb5c1730", expected);
+	hash(hashes, sizeof(hashes), computed);
+	CHECK(memcmp(computed, expected, SHA256_HASH_SIZE) == 0);
+}
+
+
+int main(void) {
+	test_vectors();
+	test_lengths();
+
+	if (failed) {
+		printf("test_sha256: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_sha256: OK\n");
+	return 0;
+}
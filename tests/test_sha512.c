@@ -0,0 +1,197 @@
+/**
+ * Host test of the SHA512_FAST block function. It is checked against the
+ * FIPS 180-4 examples and compared with the portable block function on
+ * random states and messages.
+ *
+ * crypto/sha512.c is built twice, the SHA512_FAST build has its symbols
+ * renamed to sha512_fast_* (see the Makefile).
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sha512.h"
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+extern const struct sha512_state sha512_fast_initial_state;
+void sha512_fast_block(struct sha512_state *s, const uint8_t *blk);
+void sha512_fast_final(struct sha512_state *s, const uint8_t *blk, size_t total_size);
+void sha512_fast_get(const struct sha512_state *s, uint8_t *hash, unsigned int offset, unsigned int len);
+
+#define MSG_MAX 1000000
+static uint8_t msg[MSG_MAX];
+
+
+static void hash_ref(const uint8_t *m, size_t len, uint8_t *out) {
+	struct sha512_state s;
+	size_t pos = 0;
+
+	sha512_init(&s);
+	while (len - pos >= SHA512_BLOCK_SIZE) {
+		sha512_block(&s, m + pos);
+		pos += SHA512_BLOCK_SIZE;
+	}
+	sha512_final(&s, m + pos, len);
+	sha512_get(&s, out, 0, SHA512_HASH_SIZE);
+}
+
+
+static void hash_fast(const uint8_t *m, size_t len, uint8_t *out) {
+	struct sha512_state s;
+	size_t pos = 0;
+
+	memcpy(&s, &sha512_fast_initial_state, sizeof(s));
+	while (len - pos >= SHA512_BLOCK_SIZE) {
+		sha512_fast_block(&s, m + pos);
+		pos += SHA512_BLOCK_SIZE;
+	}
+	sha512_fast_final(&s, m + pos, len);
+	sha512_fast_get(&s, out, 0, SHA512_HASH_SIZE);
+}
+
+
+static void parse_hex(const char *hex, uint8_t *out) {
+	for (size_t i = 0; i < SHA512_HASH_SIZE; i++) {
+		unsigned int b;
+		sscanf(hex + i * 2, "%2x", &b);
+		out[i] = b;
+	}
+}
+
+
+/* xorshift64, the sequence is the same on every run. */
+static uint64_t rnd_state = 0x9e3779b97f4a7c15ULL;
+static uint64_t rnd(void) {
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+
+static void rnd_fill(uint8_t *buf, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = rnd();
+	}
+}
+
+
+struct vector {
+	const char *msg;
+	size_t repeat;
+	const char *hash;
+};
+
+static const struct vector vectors[] = {
+	{
+		"abc", 1,
+		"ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+		"2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"
+	}, {
+		"", 1,
+		"cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+		"47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e"
+	}, {
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+		"204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c335"
+		"96fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71dd70354ec631238ca3445"
+	}, {
+		"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+		"hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+		"8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+		"501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909"
+	}, {
+		"a", 1000000,
+		"e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+		"de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b"
+	},
+};
+
+
+static void test_vectors(void) {
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		const struct vector *v = &vectors[i];
+		size_t l = strlen(v->msg);
+		size_t len = l * v->repeat;
+		for (size_t j = 0; j < v->repeat; j++) {
+			memcpy(msg + j * l, v->msg, l);
+		}
+
+		uint8_t expected[SHA512_HASH_SIZE];
+		uint8_t ref[SHA512_HASH_SIZE];
+		uint8_t fast[SHA512_HASH_SIZE];
+		parse_hex(v->hash, expected);
+		hash_ref(msg, len, ref);
+		hash_fast(msg, len, fast);
+		CHECK(memcmp(ref, expected, SHA512_HASH_SIZE) == 0);
+		CHECK(memcmp(fast, expected, SHA512_HASH_SIZE) == 0);
+	}
+}
+
+
+/**
+ * Single blocks with random chaining values, the fast block function
+ * must give the same state as the portable one.
+ */
+static void test_random_blocks(void) {
+	for (uint32_t i = 0; i < 10000; i++) {
+		struct sha512_state ref;
+		struct sha512_state fast;
+		for (uint32_t j = 0; j < 8; j++) {
+			ref.h[j] = rnd();
+		}
+		fast = ref;
+		rnd_fill(msg, SHA512_BLOCK_SIZE);
+
+		sha512_block(&ref, msg);
+		sha512_fast_block(&fast, msg);
+		CHECK(memcmp(&ref, &fast, sizeof(ref)) == 0);
+	}
+}
+
+
+/**
+ * Random multi-block messages. All lengths around the padding boundaries
+ * (111/112 bytes of the last block) are included.
+ */
+static void test_random_messages(void) {
+	for (size_t len = 0; len <= 4 * SHA512_BLOCK_SIZE + 1; len++) {
+		uint8_t ref[SHA512_HASH_SIZE];
+		uint8_t fast[SHA512_HASH_SIZE];
+		rnd_fill(msg, len);
+		hash_ref(msg, len, ref);
+		hash_fast(msg, len, fast);
+		CHECK(memcmp(ref, fast, SHA512_HASH_SIZE) == 0);
+	}
+
+	for (uint32_t i = 0; i < 200; i++) {
+		uint8_t ref[SHA512_HASH_SIZE];
+		uint8_t fast[SHA512_HASH_SIZE];
+		size_t len = rnd() % 65536;
+		rnd_fill(msg, len);
+		hash_ref(msg, len, ref);
+		hash_fast(msg, len, fast);
+		CHECK(memcmp(ref, fast, SHA512_HASH_SIZE) == 0);
+	}
+}
+
+
+int main(void) {
+	test_vectors();
+	test_random_blocks();
+	test_random_messages();
+
+	if (failed) {
+		printf("test_sha512: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_sha512: OK\n");
+	return 0;
+}
@@ -0,0 +1,627 @@
+/**
+ * Host test of the SPI flash driver transfer logic. The SPI peripheral, the
+ * DMA controller and the flash chip (Winbond W25Q80DV) are simulated.
+ *
+ * This file is in the public domain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "spi_flash.h"
+#include "u_log.h"
+#include "timer.h"
+
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/dma.h>
+
+static int failed = 0;
+#define CHECK(e) do { if (!(e)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #e); failed++; } } while (0)
+
+/* Buffers are static, the DMA memory address is 32 bit (the test binary
+ * is linked as non-PIE). */
+#define SIM_SIZE (1024 * 1024)
+static uint8_t sim_mem[SIM_SIZE];
+static uint8_t buf[150000];
+
+
+/*******************************************************************************
+ * System stubs.
+ ******************************************************************************/
+struct log_cbuffer *system_log;
+
+int u_assert_func(const char *expr, const char *fname, int line) {
+	printf("assertion %s failed (%s:%d)\n", expr, fname, line);
+	return 1;
+}
+
+int32_t log_cbuffer_printf(struct log_cbuffer *buf, uint8_t type, char *fmt, ...) {
+	(void)buf;
+	(void)type;
+	(void)fmt;
+	return 0;
+}
+
+/* Simulated time in milliseconds. Every timeout check takes 1 ms. */
+static uint32_t sim_time;
+
+int32_t timer_timeout_start(uint32_t *start) {
+	*start = sim_time;
+	return TIMER_TIMEOUT_INIT_OK;
+}
+
+bool timer_timeout_check(uint32_t start, uint32_t timeout) {
+	sim_time++;
+	return (sim_time - start) < timeout;
+}
+
+
+/*******************************************************************************
+ * Flash chip and SPI peripheral simulation. Erase and program operations
+ * keep the chip busy for a given time, erases can be suspended. A stuck
+ * chip never finishes the operation.
+ ******************************************************************************/
+volatile uint32_t spi_dr_sim;
+static bool sim_selected;
+static uint32_t sim_pos;
+static uint8_t sim_cmd;
+static uint32_t sim_addr;
+static uint32_t sim_polled_bytes;
+
+static uint32_t sim_erase_time;
+static uint32_t sim_program_time;
+static uint32_t sim_suspend_time;
+static bool sim_stuck;
+
+static bool sim_op;
+static bool sim_op_erase;
+static uint32_t sim_op_addr;
+static uint32_t sim_op_end;
+static bool sim_suspended;
+static uint32_t sim_suspend_end;
+static uint32_t sim_remaining;
+
+/* Counters of commands and protocol violations. */
+static uint32_t sim_suspends;
+static uint32_t sim_resumes;
+static uint32_t sim_busy_reads;
+
+static bool sim_busy(void) {
+	if (sim_suspended) {
+		return (int32_t)(sim_time - sim_suspend_end) < 0;
+	}
+	if (sim_op && !sim_stuck && (int32_t)(sim_time - sim_op_end) >= 0) {
+		if (sim_op_erase) {
+			memset(sim_mem + sim_op_addr, 0xff, 4096);
+		}
+		sim_op = false;
+	}
+	return sim_op;
+}
+
+/* Commands without data are executed when the chip is deselected. */
+static void sim_execute(void) {
+	switch (sim_cmd) {
+		case 0x20:
+			if (sim_pos == 4) {
+				sim_op = true;
+				sim_op_erase = true;
+				sim_op_addr = (sim_addr % SIM_SIZE) & ~0xfffu;
+				sim_op_end = sim_time + sim_erase_time;
+			}
+			break;
+		case 0x02:
+			if (sim_pos > 4) {
+				sim_op = true;
+				sim_op_erase = false;
+				sim_op_end = sim_time + sim_program_time;
+			}
+			break;
+		case 0x75:
+			sim_suspends++;
+			if (sim_busy() && sim_op_erase && !sim_suspended) {
+				sim_suspended = true;
+				sim_remaining = sim_op_end - sim_time;
+				sim_suspend_end = sim_time + sim_suspend_time;
+			}
+			break;
+		case 0x7a:
+			sim_resumes++;
+			if (sim_suspended) {
+				sim_suspended = false;
+				sim_op_end = sim_time + sim_remaining;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void gpio_clear(uint32_t gpioport, uint16_t gpios) {
+	(void)gpioport;
+	(void)gpios;
+	sim_selected = true;
+	sim_pos = 0;
+}
+
+void gpio_set(uint32_t gpioport, uint16_t gpios) {
+	(void)gpioport;
+	(void)gpios;
+	if (sim_selected) {
+		sim_execute();
+	}
+	sim_selected = false;
+}
+
+static uint8_t sim_xfer(uint8_t d) {
+	if (!sim_selected) {
+		return 0xff;
+	}
+	uint32_t pos = sim_pos++;
+	if (pos == 0) {
+		sim_cmd = d;
+		sim_addr = 0;
+		return 0xff;
+	}
+
+	switch (sim_cmd) {
+		case 0x9f: {
+			const uint8_t id[3] = {0xef, 0x40, 0x14};
+			return (pos <= 3) ? id[pos - 1] : 0xff;
+		}
+		case 0x05:
+			return sim_busy() ? 0x01 : 0x00;
+		case 0x20:
+			if (pos <= 3) {
+				sim_addr = (sim_addr << 8) | d;
+			}
+			return 0xff;
+		case 0x03:
+		case 0x0b:
+		case 0x02: {
+			if (pos <= 3) {
+				sim_addr = (sim_addr << 8) | d;
+				return 0xff;
+			}
+			if (pos == 4 && sim_busy()) {
+				sim_busy_reads++;
+			}
+			/* Fast read has one dummy byte. */
+			if (sim_cmd == 0x0b && pos == 4) {
+				return 0xff;
+			}
+			uint32_t a = sim_addr++ % SIM_SIZE;
+			if (sim_cmd == 0x02) {
+				sim_mem[a] &= d;
+				return 0xff;
+			}
+			return sim_mem[a];
+		}
+		default:
+			return 0xff;
+	}
+}
+
+uint16_t spi_xfer(uint32_t spi, uint16_t data) {
+	(void)spi;
+	sim_polled_bytes++;
+	return sim_xfer(data);
+}
+
+void spi_set_master_mode(uint32_t spi) { (void)spi; }
+void spi_set_baudrate_prescaler(uint32_t spi, uint8_t baudrate) { (void)spi; (void)baudrate; }
+void spi_set_clock_polarity_0(uint32_t spi) { (void)spi; }
+void spi_set_clock_phase_0(uint32_t spi) { (void)spi; }
+void spi_set_full_duplex_mode(uint32_t spi) { (void)spi; }
+void spi_set_unidirectional_mode(uint32_t spi) { (void)spi; }
+void spi_enable_software_slave_management(uint32_t spi) { (void)spi; }
+void spi_send_msb_first(uint32_t spi) { (void)spi; }
+void spi_set_nss_high(uint32_t spi) { (void)spi; }
+void spi_enable(uint32_t spi) { (void)spi; }
+
+static bool sim_spi_rx_dma;
+static bool sim_spi_tx_dma;
+void spi_enable_rx_dma(uint32_t spi) { (void)spi; sim_spi_rx_dma = true; }
+void spi_disable_rx_dma(uint32_t spi) { (void)spi; sim_spi_rx_dma = false; }
+void spi_enable_tx_dma(uint32_t spi) { (void)spi; sim_spi_tx_dma = true; }
+void spi_disable_tx_dma(uint32_t spi) { (void)spi; sim_spi_tx_dma = false; }
+
+
+/*******************************************************************************
+ * DMA controller simulation. The transfer is done when the RX stream
+ * completion flag is polled for the sim_dma_busy_polls + 1st time.
+ ******************************************************************************/
+#define SIM_RX_STREAM 3
+#define SIM_TX_STREAM 4
+
+struct sim_stream {
+	bool enabled;
+	bool increment;
+	uint32_t direction;
+	uint32_t mem;
+	uint32_t len;
+	uint32_t flags;
+};
+static struct sim_stream sim_streams[8];
+static uint32_t sim_dma_busy_polls;
+static uint32_t sim_dma_polls;
+static bool sim_dma_error;
+
+/* Lengths of all DMA transfers done. */
+static uint32_t sim_dma_transfers[16];
+static uint32_t sim_dma_transfer_count;
+
+void dma_stream_reset(uint32_t dma, uint8_t stream) {
+	(void)dma;
+	memset(&sim_streams[stream], 0, sizeof(struct sim_stream));
+}
+void dma_channel_select(uint32_t dma, uint8_t stream, uint32_t channel) { (void)dma; (void)stream; (void)channel; }
+void dma_set_priority(uint32_t dma, uint8_t stream, uint32_t prio) { (void)dma; (void)stream; (void)prio; }
+void dma_set_memory_size(uint32_t dma, uint8_t stream, uint32_t mem_size) { (void)dma; (void)stream; (void)mem_size; }
+void dma_set_peripheral_size(uint32_t dma, uint8_t stream, uint32_t peripheral_size) { (void)dma; (void)stream; (void)peripheral_size; }
+void dma_enable_memory_increment_mode(uint32_t dma, uint8_t stream) { (void)dma; sim_streams[stream].increment = true; }
+void dma_disable_memory_increment_mode(uint32_t dma, uint8_t stream) { (void)dma; sim_streams[stream].increment = false; }
+void dma_set_transfer_mode(uint32_t dma, uint8_t stream, uint32_t direction) { (void)dma; sim_streams[stream].direction = direction; }
+void dma_set_peripheral_address(uint32_t dma, uint8_t stream, uint32_t address) { (void)dma; (void)stream; (void)address; }
+void dma_set_memory_address(uint32_t dma, uint8_t stream, uint32_t address) { (void)dma; sim_streams[stream].mem = address; }
+void dma_set_number_of_data(uint32_t dma, uint8_t stream, uint16_t number) { (void)dma; sim_streams[stream].len = number; }
+void dma_disable_stream(uint32_t dma, uint8_t stream) { (void)dma; sim_streams[stream].enabled = false; }
+
+void dma_enable_stream(uint32_t dma, uint8_t stream) {
+	(void)dma;
+	sim_streams[stream].enabled = true;
+	sim_dma_polls = 0;
+}
+
+void dma_clear_interrupt_flags(uint32_t dma, uint8_t stream, uint32_t interrupts) {
+	(void)dma;
+	sim_streams[stream].flags &= ~interrupts;
+}
+
+static void sim_dma_run(void) {
+	struct sim_stream *rx = &sim_streams[SIM_RX_STREAM];
+	struct sim_stream *tx = &sim_streams[SIM_TX_STREAM];
+
+	if (sim_dma_error) {
+		rx->flags |= DMA_TEIF;
+		return;
+	}
+
+	CHECK(rx->enabled && tx->enabled && sim_spi_rx_dma && sim_spi_tx_dma);
+	CHECK(rx->direction == DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+	CHECK(tx->direction == DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+	CHECK(rx->len == tx->len);
+
+	uint8_t *rx_mem = (uint8_t *)(uintptr_t)rx->mem;
+	const uint8_t *tx_mem = (const uint8_t *)(uintptr_t)tx->mem;
+	for (uint32_t i = 0; i < rx->len; i++) {
+		uint8_t b = sim_xfer(tx_mem[tx->increment ? i : 0]);
+		rx_mem[rx->increment ? i : 0] = b;
+	}
+
+	if (sim_dma_transfer_count < 16) {
+		sim_dma_transfers[sim_dma_transfer_count] = rx->len;
+	}
+	sim_dma_transfer_count++;
+	rx->flags |= DMA_TCIF;
+	tx->flags |= DMA_TCIF;
+}
+
+bool dma_get_interrupt_flag(uint32_t dma, uint8_t stream, uint32_t interrupts) {
+	(void)dma;
+	struct sim_stream *s = &sim_streams[stream];
+
+	if (stream == SIM_RX_STREAM && s->enabled && (interrupts & DMA_TCIF) && (s->flags & (DMA_TCIF | DMA_TEIF)) == 0) {
+		if (sim_dma_polls++ >= sim_dma_busy_polls) {
+			sim_dma_run();
+		}
+	}
+
+	return (s->flags & interrupts) != 0;
+}
+
+
+/*******************************************************************************
+ * Tests.
+ ******************************************************************************/
+static uint32_t callback_count;
+static bool callback_selected;
+
+static void transfer_callback(struct flash_dev *flash, void *ctx) {
+	(void)flash;
+	(void)ctx;
+	callback_count++;
+	callback_selected = sim_selected;
+}
+
+static void sim_reset(void) {
+	for (uint32_t i = 0; i < SIM_SIZE; i++) {
+		sim_mem[i] = (uint8_t)(i * 7 + (i >> 8));
+	}
+	sim_dma_transfer_count = 0;
+	sim_dma_busy_polls = 0;
+	sim_dma_error = false;
+	sim_polled_bytes = 0;
+	callback_count = 0;
+
+	sim_erase_time = 50;
+	sim_program_time = 1;
+	sim_suspend_time = 0;
+	sim_stuck = false;
+	sim_op = false;
+	sim_suspended = false;
+	sim_suspends = 0;
+	sim_resumes = 0;
+	sim_busy_reads = 0;
+}
+
+
+static void test_polled_read(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 0, 0, 0, 0);
+	memset(buf, 0, sizeof(buf));
+
+	CHECK(flash_read(flash, 0x1234, buf, 1000) == FLASH_READ_OK);
+	CHECK(memcmp(buf, sim_mem + 0x1234, 1000) == 0);
+	CHECK(sim_dma_transfer_count == 0);
+	CHECK(sim_selected == false);
+}
+
+
+static void test_dma_read_split(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 1, SIM_RX_STREAM, SIM_TX_STREAM, 0);
+	memset(buf, 0, sizeof(buf));
+
+	/* A single DMA transfer is limited to 65535 bytes. */
+	CHECK(flash_read(flash, 0x100, buf, 150000) == FLASH_READ_OK);
+	CHECK(memcmp(buf, sim_mem + 0x100, 150000) == 0);
+	CHECK(sim_dma_transfer_count == 3);
+	CHECK(sim_dma_transfers[0] == 65535);
+	CHECK(sim_dma_transfers[1] == 65535);
+	CHECK(sim_dma_transfers[2] == 150000 - 2 * 65535);
+	CHECK(sim_selected == false);
+
+	/* Short reads are always polled. */
+	sim_reset();
+	CHECK(flash_read(flash, 0x200, buf, FLASH_DMA_MIN_LEN - 1) == FLASH_READ_OK);
+	CHECK(memcmp(buf, sim_mem + 0x200, FLASH_DMA_MIN_LEN - 1) == 0);
+	CHECK(sim_dma_transfer_count == 0);
+}
+
+
+static void test_dma_write(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 1, SIM_RX_STREAM, SIM_TX_STREAM, 0);
+
+	static uint8_t data[256];
+	for (uint32_t i = 0; i < sizeof(data); i++) {
+		data[i] = (uint8_t)(i ^ 0x5a);
+	}
+	memset(sim_mem + 0x3000, 0xff, 512);
+
+	/* Crossing the page boundary, split to two page programs. */
+	CHECK(flash_write(flash, 0x3080, data, sizeof(data)) == FLASH_WRITE_OK);
+	CHECK(memcmp(sim_mem + 0x3080, data, sizeof(data)) == 0);
+	CHECK(sim_dma_transfer_count == 2);
+	CHECK(sim_dma_transfers[0] == 128);
+}
+
+
+static void test_async_read(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 1, SIM_RX_STREAM, SIM_TX_STREAM, 0);
+	flash_set_transfer_callback(flash, transfer_callback, NULL);
+	memset(buf, 0, 256);
+	sim_dma_busy_polls = 3;
+
+	/* The function returns before the data are transferred. */
+	CHECK(flash_page_read_start(flash, 0x4000, buf, 256) == FLASH_PAGE_READ_START_OK);
+	CHECK(flash->transfer_busy == true);
+	CHECK(sim_selected == true);
+	CHECK(callback_count == 0);
+
+	uint32_t busy = 0;
+	int32_t ret;
+	while ((ret = flash_transfer_poll(flash)) == FLASH_TRANSFER_POLL_BUSY) {
+		busy++;
+	}
+	CHECK(ret == FLASH_TRANSFER_POLL_DONE);
+	CHECK(busy == 3);
+	CHECK(memcmp(buf, sim_mem + 0x4000, 256) == 0);
+	CHECK(flash->transfer_busy == false);
+	CHECK(callback_count == 1);
+	CHECK(callback_selected == false);
+
+	/* Polling again does not call the callback. */
+	CHECK(flash_transfer_poll(flash) == FLASH_TRANSFER_POLL_DONE);
+	CHECK(callback_count == 1);
+
+	/* Another operation waits for the pending transfer. */
+	sim_reset();
+	memset(buf, 0, 256);
+	sim_dma_busy_polls = 5;
+	CHECK(flash_page_read_start(flash, 0x5000, buf, 256) == FLASH_PAGE_READ_START_OK);
+	uint8_t sr = 0xff;
+	CHECK(flash_get_status(flash, &sr) == FLASH_GET_STATUS_OK);
+	CHECK(sr == 0x00);
+	CHECK(memcmp(buf, sim_mem + 0x5000, 256) == 0);
+	CHECK(callback_count == 1);
+
+	/* Transfer error is reported. */
+	sim_reset();
+	sim_dma_error = true;
+	CHECK(flash_page_read_start(flash, 0x6000, buf, 256) == FLASH_PAGE_READ_START_OK);
+	CHECK(flash_transfer_wait(flash) == FLASH_TRANSFER_WAIT_FAILED);
+	CHECK(flash->transfer_busy == false);
+	CHECK(sim_selected == false);
+	CHECK(callback_count == 0);
+
+	flash_set_transfer_callback(flash, NULL, NULL);
+}
+
+
+static void test_async_read_polled(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_transfer_callback(flash, transfer_callback, NULL);
+	memset(buf, 0, 256);
+
+	/* Without DMA the read is complete before returning. */
+	flash_set_dma(flash, 0, 0, 0, 0);
+	CHECK(flash_page_read_start(flash, 0x7000, buf, 256) == FLASH_PAGE_READ_START_OK);
+	CHECK(flash->transfer_busy == false);
+	CHECK(memcmp(buf, sim_mem + 0x7000, 256) == 0);
+	CHECK(callback_count == 1);
+	CHECK(flash_transfer_wait(flash) == FLASH_TRANSFER_WAIT_OK);
+	CHECK(callback_count == 1);
+
+	/* Short reads with DMA enabled too. */
+	flash_set_dma(flash, 1, SIM_RX_STREAM, SIM_TX_STREAM, 0);
+	CHECK(flash_page_read_start(flash, 0x7100, buf, 8) == FLASH_PAGE_READ_START_OK);
+	CHECK(flash->transfer_busy == false);
+	CHECK(memcmp(buf, sim_mem + 0x7100, 8) == 0);
+	CHECK(callback_count == 2);
+	CHECK(sim_dma_transfer_count == 0);
+
+	flash_set_transfer_callback(flash, NULL, NULL);
+}
+
+
+/**
+ * A read during a pending erase suspends it. The erase is resumed and
+ * completed by the next poll.
+ */
+static void test_erase_suspend(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 0, 0, 0, 0);
+	static uint8_t old[256];
+	memcpy(old, sim_mem + 0x8100, sizeof(old));
+
+	CHECK(flash_sector_erase_start(flash, 0x8000) == FLASH_SECTOR_ERASE_START_OK);
+	CHECK(flash_poll(flash) == FLASH_POLL_BUSY);
+
+	/* The erase is not done yet, old data are read. */
+	CHECK(flash_read(flash, 0x8100, buf, sizeof(old)) == FLASH_READ_OK);
+	CHECK(memcmp(buf, old, sizeof(old)) == 0);
+	CHECK(sim_suspends == 1);
+	CHECK(sim_suspended == true);
+	CHECK(flash->op_suspended == true);
+	CHECK(sim_busy_reads == 0);
+
+	/* Another read does not suspend again. */
+	CHECK(flash_read(flash, 0x8200, buf, 16) == FLASH_READ_OK);
+	CHECK(sim_suspends == 1);
+
+	/* Time spent suspended does not count to the operation timeout
+	 * (400 ms for the sector erase). */
+	sim_time += 1000;
+
+	CHECK(flash_wait_complete(flash) == FLASH_WAIT_COMPLETE_OK);
+	CHECK(sim_resumes == 1);
+	CHECK(flash->op_suspended == false);
+	CHECK(sim_mem[0x8000] == 0xff && sim_mem[0x8fff] == 0xff);
+	CHECK(sim_busy_reads == 0);
+}
+
+
+/**
+ * If the chip does not suspend in time, the read waits for the erase to
+ * complete. Page programs are never suspended.
+ */
+static void test_suspend_slow(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 0, 0, 0, 0);
+	sim_suspend_time = 10;
+
+	CHECK(flash_sector_erase_start(flash, 0x9000) == FLASH_SECTOR_ERASE_START_OK);
+	CHECK(flash_read(flash, 0x9000, buf, 16) == FLASH_READ_OK);
+	CHECK(sim_suspends == 1);
+	CHECK(sim_resumes == 1);
+	CHECK(flash->op_pending == false);
+	CHECK(buf[0] == 0xff && buf[15] == 0xff);
+	CHECK(sim_busy_reads == 0);
+
+	sim_reset();
+	sim_program_time = 3;
+	static uint8_t data[16];
+	memset(data, 0x00, sizeof(data));
+	CHECK(flash_page_write_start(flash, 0xa000, data, sizeof(data)) == FLASH_PAGE_WRITE_START_OK);
+	CHECK(flash_read(flash, 0xa000, buf, 16) == FLASH_READ_OK);
+	CHECK(sim_suspends == 0);
+	CHECK(memcmp(buf, data, sizeof(data)) == 0);
+	CHECK(sim_busy_reads == 0);
+}
+
+
+static int32_t complete_result;
+static uint32_t complete_count;
+
+static void complete_callback(struct flash_dev *flash, int32_t result, void *ctx) {
+	(void)flash;
+	(void)ctx;
+	complete_result = result;
+	complete_count++;
+}
+
+
+/**
+ * A stuck chip is detected after the maximum operation time.
+ */
+static void test_timeout(struct flash_dev *flash) {
+	sim_reset();
+	flash_set_dma(flash, 0, 0, 0, 0);
+	flash_set_complete_callback(flash, complete_callback, NULL);
+	complete_count = 0;
+	sim_stuck = true;
+
+	uint32_t start = sim_time;
+	CHECK(flash_sector_erase_start(flash, 0xb000) == FLASH_SECTOR_ERASE_START_OK);
+	CHECK(flash_wait_complete(flash) == FLASH_WAIT_COMPLETE_TIMEOUT);
+	CHECK(sim_time - start >= flash->info.sector_erase_time);
+	CHECK(flash->op_pending == false);
+	CHECK(complete_count == 1);
+	CHECK(complete_result == FLASH_POLL_TIMEOUT);
+
+	/* Page write fails the same way. */
+	static uint8_t data[16];
+	memset(data, 0x00, sizeof(data));
+	CHECK(flash_write(flash, 0xc000, data, sizeof(data)) == FLASH_WRITE_FAILED);
+	CHECK(complete_count == 2);
+	CHECK(complete_result == FLASH_POLL_TIMEOUT);
+
+	/* The chip is usable again once it recovers. */
+	sim_stuck = false;
+	CHECK(flash_read(flash, 0xc000, buf, 16) == FLASH_READ_OK);
+	CHECK(flash_poll(flash) == FLASH_POLL_DONE);
+
+	flash_set_complete_callback(flash, NULL, NULL);
+}
+
+
+int main(void) {
+	struct flash_dev flash;
+	sim_reset();
+	CHECK(flash_init(&flash, 1, 1, 12) == FLASH_INIT_OK);
+	CHECK(flash.read_cmd == 0x0b);
+
+	test_polled_read(&flash);
+	test_dma_read_split(&flash);
+	test_dma_write(&flash);
+	test_async_read(&flash);
+	test_async_read_polled(&flash);
+	test_erase_suspend(&flash);
+	test_suspend_slow(&flash);
+	test_timeout(&flash);
+
+	if (failed) {
+		printf("test_spi_flash: %d checks failed\n", failed);
+		return 1;
+	}
+	printf("test_spi_flash: OK\n");
+	return 0;
+}
@@ -0,0 +1,80 @@
+#!/usr/bin/python
+#
+# Pure python BLAKE2s-256 (RFC 7693) for python versions without
+# hashlib.blake2s.
+#
+# This file is in the public domain.
+
+import struct
+
+IV = [
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+]
+
+SIGMA = [
+	[0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15],
+	[14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3],
+	[11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4],
+	[7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8],
+	[9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13],
+	[2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9],
+	[12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11],
+	[13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10],
+	[6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5],
+	[10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0],
+]
+
+MASK = 0xffffffff
+
+
+def rot(x, n):
+	return ((x >> n) | (x << (32 - n))) & MASK
+
+
+def compress(h, block, t, last):
+	m = struct.unpack("<16L", block)
+	v = h[:] + IV[:]
+	v[12] ^= t & MASK
+	v[13] ^= (t >> 32) & MASK
+	if last:
+		v[14] ^= MASK
+
+	def g(a, b, c, d, x, y):
+		v[a] = (v[a] + v[b] + x) & MASK
+		v[d] = rot(v[d] ^ v[a], 16)
+		v[c] = (v[c] + v[d]) & MASK
+		v[b] = rot(v[b] ^ v[c], 12)
+		v[a] = (v[a] + v[b] + y) & MASK
+		v[d] = rot(v[d] ^ v[a], 8)
+		v[c] = (v[c] + v[d]) & MASK
+		v[b] = rot(v[b] ^ v[c], 7)
+
+	for s in SIGMA:
+		g(0, 4, 8, 12, m[s[0]], m[s[1]])
+		g(1, 5, 9, 13, m[s[2]], m[s[3]])
+		g(2, 6, 10, 14, m[s[4]], m[s[5]])
+		g(3, 7, 11, 15, m[s[6]], m[s[7]])
+		g(0, 5, 10, 15, m[s[8]], m[s[9]])
+		g(1, 6, 11, 12, m[s[10]], m[s[11]])
+		g(2, 7, 8, 13, m[s[12]], m[s[13]])
+		g(3, 4, 9, 14, m[s[14]], m[s[15]])
+
+	return [h[i] ^ v[i] ^ v[i + 8] for i in range(8)]
+
+
+def digest(data):
+	h = IV[:]
+	h[0] ^= 0x01010000 | 32
+
+	t = 0
+	# All blocks except the last one.
+	while len(data) - t > 64:
+		h = compress(h, data[t:t + 64], t + 64, False)
+		t += 64
+
+	last = data[t:]
+	last += b"\x00" * (64 - len(last))
+	h = compress(h, last, len(data), True)
+
+	return struct.pack("<8L", *h)
@@ -0,0 +1,86 @@
+#!/usr/bin/python
+#
+# uBLoad chunked firmware image creator. A section with hashes of fixed size
+# chunks is prepended to a firmware image created by createfw.py or
+# createdelta.py. The bootloader checks each chunk as soon as it is received
+# and stops at the first corrupted one. See common/chunk_stream.h for the
+# format.
+#
+# This file is in the public domain.
+
+import argparse
+import struct
+import hashlib
+
+class section_magic:
+	chunks = 0x27c4e9b5
+
+# Size of the chunk table in the bootloader.
+MAX_CHUNKS = 64
+
+# Chunk size must be a multiple of the SHA256 block size.
+BLOCK_SIZE = 64
+
+
+def build_section(section_magic, data):
+	return struct.pack("!LL", section_magic, len(data)) + data
+
+
+parser = argparse.ArgumentParser(description = "uBLoad chunked firmware creator")
+parser.add_argument(
+	"--input", "-i",
+	metavar = "fwfile",
+	dest = "fwfile",
+	required = True,
+	type = str,
+	help = "Firmware image created by createfw.py or createdelta.py"
+)
+parser.add_argument(
+	"--output", "-o",
+	metavar = "chunkedfile",
+	dest = "chunkedfile",
+	required = True,
+	type = str,
+	help = "Output chunked firmware image file"
+)
+parser.add_argument(
+	"--chunk-size",
+	dest = "chunk_size",
+	metavar = "BYTES",
+	default = 4096,
+	type = int,
+	help = "Size of a single chunk (multiple of %u bytes)." % BLOCK_SIZE
+)
+args = parser.parse_args()
+
+if args.chunk_size <= 0 or args.chunk_size % BLOCK_SIZE:
+	print("Chunk size must be a multiple of %u bytes" % BLOCK_SIZE)
+	exit(1)
+
+try:
+	with open(args.fwfile, "rb") as f:
+		fw_image = f.read()
+except IOError:
+	print("Cannot read firmware file '%s'" % args.fwfile)
+	exit(1)
+
+if len(fw_image) == 0:
+	print("Firmware file '%s' is empty" % args.fwfile)
+	exit(1)
+
+chunks = [fw_image[i:i + args.chunk_size] for i in range(0, len(fw_image), args.chunk_size)]
+if len(chunks) > MAX_CHUNKS:
+	print("Too many chunks (%u, max %u), use a bigger chunk size" % (len(chunks), MAX_CHUNKS))
+	exit(1)
+
+table = struct.pack("!LL", args.chunk_size, len(fw_image))
+for chunk in chunks:
+	table += hashlib.sha256(chunk).digest()
+print("%u chunks of %u bytes" % (len(chunks), args.chunk_size))
+
+try:
+	with open(args.chunkedfile, "wb") as f:
+		f.write(build_section(section_magic.chunks, table) + fw_image)
+except IOError:
+	print("Cannot write output chunked file '%s'" % args.chunkedfile)
+	exit(1)
@@ -0,0 +1,178 @@
+#!/usr/bin/python
+#
+# uBLoad delta firmware image creator. The verified section of the new image
+# is replaced with a delta section which recreates it from the base image
+# (the firmware currently installed, saved by the bootloader as backup.fw).
+# See common/delta_stream.h for the format.
+#
+# This file is in the public domain.
+
+import argparse
+import struct
+import hashlib
+import lz4
+
+class section_magic:
+	verification = 0x6ef44bc0
+	verified = 0x1eda84bc
+	compressed = 0x8c2f5b61
+	delta = 0x5d3e8a27
+
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+# Substrings of this length are indexed in the base image.
+KEY_SIZE = 8
+
+# A copy operation takes 9 bytes, shorter matches are inserted.
+MIN_COPY = 16
+
+# Maximum number of base positions remembered for a single key.
+MAX_CANDIDATES = 8
+
+
+def build_section(section_magic, data):
+	return struct.pack("!LL", section_magic, len(data)) + data
+
+
+def load_image(fname):
+	"""
+	Return the image as it appears in the flash memory split to the verified
+	section (including its header) and the rest (verification section).
+	"""
+	with open(fname, "rb") as f:
+		data = f.read()
+
+	if len(data) < 8:
+		raise ValueError("image '%s' too short" % fname)
+	magic, length = struct.unpack("!LL", data[:8])
+	if magic == section_magic.verified:
+		return data[:8 + length], data[8 + length:]
+	if magic == section_magic.compressed:
+		return bytes(lz4.decompress(data[8:8 + length])), data[8 + length:]
+	raise ValueError("image '%s' is not a full firmware image" % fname)
+
+
+def diff(base, target):
+	index = {}
+	for i in range(len(base) - KEY_SIZE + 1):
+		candidates = index.setdefault(base[i:i + KEY_SIZE], [])
+		if len(candidates) < MAX_CANDIDATES:
+			candidates.append(i)
+
+	ops = []
+	pending = bytearray()
+
+	def flush():
+		if len(pending) > 0:
+			ops.append(struct.pack("!BL", OP_INSERT, len(pending)) + bytes(pending))
+			del pending[:]
+
+	# Firmware changes usually keep the rest of the image in place or
+	# shifted by a constant, try to continue the last copy first.
+	expected = 0
+	j = 0
+	while j < len(target):
+		candidates = list(index.get(target[j:j + KEY_SIZE], []))
+		if expected < len(base):
+			candidates.insert(0, expected)
+
+		best_pos = 0
+		best_len = 0
+		for pos in candidates:
+			n = 0
+			while pos + n < len(base) and j + n < len(target) and base[pos + n] == target[j + n]:
+				n += 1
+			if n > best_len:
+				best_pos = pos
+				best_len = n
+
+		if best_len >= MIN_COPY:
+			flush()
+			ops.append(struct.pack("!BLL", OP_COPY, best_pos, best_len))
+			j += best_len
+			expected = best_pos + best_len
+		else:
+			pending.append(target[j])
+			j += 1
+			expected += 1
+	flush()
+
+	return b"".join(ops)
+
+
+def apply(base, delta):
+	base_len, = struct.unpack("!L", delta[:4])
+	if base_len != len(base) or hashlib.sha512(base).digest() != delta[4:68]:
+		raise ValueError("base image mismatch")
+
+	out = bytearray()
+	i = 68
+	while i < len(delta):
+		op = ord(delta[i:i + 1])
+		if op == OP_COPY:
+			offset, length = struct.unpack("!LL", delta[i + 1:i + 9])
+			out += base[offset:offset + length]
+			i += 9
+		elif op == OP_INSERT:
+			length, = struct.unpack("!L", delta[i + 1:i + 5])
+			out += delta[i + 5:i + 5 + length]
+			i += 5 + length
+		else:
+			raise ValueError("unknown operation")
+	return bytes(out)
+
+
+parser = argparse.ArgumentParser(description = "uBLoad delta firmware creator")
+parser.add_argument(
+	"--base", "-b",
+	metavar = "basefile",
+	dest = "basefile",
+	required = True,
+	type = str,
+	help = "Firmware image currently installed (delta base)"
+)
+parser.add_argument(
+	"--input", "-i",
+	metavar = "fwfile",
+	dest = "fwfile",
+	required = True,
+	type = str,
+	help = "New firmware image created by createfw.py"
+)
+parser.add_argument(
+	"--output", "-o",
+	metavar = "deltafile",
+	dest = "deltafile",
+	required = True,
+	type = str,
+	help = "Output delta firmware image file"
+)
+args = parser.parse_args()
+
+try:
+	base_verified, base_rest = load_image(args.basefile)
+	verified, verification = load_image(args.fwfile)
+except (IOError, ValueError) as e:
+	print("Cannot load firmware image: %s" % e)
+	exit(1)
+
+# The bootloader uses its own dump of the current firmware as the base.
+base = base_verified + base_rest
+
+delta = struct.pack("!L", len(base)) + hashlib.sha512(base).digest() + diff(base, verified)
+if apply(base, delta) != verified:
+	print("Delta check failed")
+	exit(1)
+
+# Hashes and signatures in the verification section are left as they are,
+# they are computed over the verified section recreated by the bootloader.
+fw_image = build_section(section_magic.delta, delta) + verification
+print("verified section %u bytes, delta %u bytes (base image %u bytes)" % (len(verified), len(delta), len(base)))
+
+try:
+	with open(args.deltafile, "wb") as f:
+		f.write(fw_image)
+except IOError:
+	print("Cannot write output delta file '%s'" % args.deltafile)
+	exit(1)
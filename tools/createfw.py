@@ -4,6 +4,8 @@ import argparse
 import struct
 import hashlib
 import ed25519
+import blake2s
+import lz4
 
 class section_magic:
 	verification = 0x6ef44bc0
@@ -13,6 +15,11 @@ class section_magic:
 	sha512 = 0xb6eb9721
 	ed25519 = 0x9d6b1a99
 	fp = 0x5bf0aa39
+	crc32 = 0x2c4a7d13
+	sha256 = 0x3f5e2a81
+	blake2s = 0x71c6d0e4
+	compressed = 0x8c2f5b61
+	metadata = 0x6a19c3e2
 
 section_names = {
 	section_magic.verification: "verification",
@@ -22,8 +29,34 @@ section_names = {
 	section_magic.sha512: "sha512 hash",
 	section_magic.ed25519: "ed25519 signature",
 	section_magic.fp: "pubkey fingerprint",
+	section_magic.crc32: "crc32",
+	section_magic.sha256: "sha256 hash",
+	section_magic.blake2s: "blake2s hash",
+	section_magic.compressed: "compressed",
+	section_magic.metadata: "metadata",
 }
 
+# CRC32 as computed by the STM32 CRC unit - little endian 32bit words are
+# processed MSB first, the last word is padded with zeroes.
+crc32_table = []
+for i in range(256):
+	c = i << 24
+	for j in range(8):
+		if c & 0x80000000:
+			c = ((c << 1) ^ 0x04c11db7) & 0xffffffff
+		else:
+			c = (c << 1) & 0xffffffff
+	crc32_table.append(c)
+
+def crc32_stm32(data):
+	if len(data) % 4:
+		data += "\x00" * (4 - len(data) % 4)
+	crc = 0xffffffff
+	for i in range(0, len(data), 4):
+		for b in reversed(data[i:i + 4]):
+			crc = ((crc << 8) & 0xffffffff) ^ crc32_table[(crc >> 24) ^ ord(b)]
+	return crc
+
 def build_section(section_magic, data):
 	return struct.pack("!LL", section_magic, len(data)) + data
 
@@ -94,12 +127,28 @@ parser.add_argument(
 	action = "store_true",
 	help = "Add firmware hash for integrity checking."
 )
+parser.add_argument(
+	"--crc",
+	action = "store_true",
+	help = "Add CRC32 of the firmware for fast integrity precheck."
+)
+parser.add_argument(
+	"--compress",
+	action = "store_true",
+	help = "Compress the verified section (LZ4), it is decompressed by the bootloader during programming."
+)
 parser.add_argument(
 	"--hash-type",
 	dest = "hash_type",
 	metavar = "HASH",
 	default = "sha512",
-	help = "Specify hash type for signing/integrity checking."
+	help = "Specify hash type for signing/integrity checking (sha512, sha256, blake2s)."
+)
+parser.add_argument(
+	"--version", "-V",
+	dest = "fw_version",
+	metavar = "STRING",
+	help = "Firmware version or build ID saved in the metadata section (max. 31 characters)."
 )
 parser.add_argument(
 	"--base", "-b",
@@ -121,7 +170,12 @@ args = parser.parse_args()
 fw_verified = ""
 fw_verification = ""
 
-# TODO: populate verified section metadata here
+# Populate verified section metadata.
+if args.fw_version:
+	if len(args.fw_version) > 31:
+		print "Firmware version too long"
+		exit(1)
+	fw_verified += build_section(section_magic.metadata, args.fw_version)
 
 # Verified section header is exactly 8 bytes long, firmware image header has the
 # same length. Therefore, verified data must be fw_offset - 16 bytes long. Print
@@ -145,11 +199,20 @@ except:
 
 # Now the verified section is complete. Compute required hashes and other
 # authentication data.
+if args.crc:
+	fw_verification += build_section(section_magic.crc32, struct.pack("!L", crc32_stm32(fw_verified)))
+
 fw_hash = ""
 if args.check:
 	if args.hash_type == "sha512":
 		fw_hash = hashlib.sha512(fw_verified).digest()
 		fw_verification += build_section(section_magic.sha512, fw_hash)
+	elif args.hash_type == "sha256":
+		fw_hash = hashlib.sha256(fw_verified).digest()
+		fw_verification += build_section(section_magic.sha256, fw_hash)
+	elif args.hash_type == "blake2s":
+		fw_hash = blake2s.digest(fw_verified)
+		fw_verification += build_section(section_magic.blake2s, fw_hash)
 	else:
 		print "Unknown hash specified."
 		exit(1)
@@ -189,6 +252,18 @@ fw_image = build_section(section_magic.verified, fw_verified) + build_section(se
 # Print resulting firmware image structure
 print_sections(fw_image, int(args.fw_base, 16))
 
+# The verified section (including its header) can be replaced with its
+# compressed version. Hashes and signatures are still computed over the
+# uncompressed data, the image in the flash is the same.
+if args.compress:
+	verified = build_section(section_magic.verified, fw_verified)
+	compressed = lz4.compress(verified)
+	if lz4.decompress(compressed) != verified:
+		print "Compression failed"
+		exit(1)
+	fw_image = build_section(section_magic.compressed, compressed) + build_section(section_magic.verification, fw_verification)
+	print "verified section compressed from %u to %u bytes" % (len(verified), len(compressed))
+
 # Save the image to selected file.
 try:
 	with open(args.fwfile, "w") as f:
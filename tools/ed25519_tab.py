@@ -0,0 +1,44 @@
+#!/usr/bin/python
+#
+# Generate the table of odd multiples of the ed25519 base point used by
+# the variable-time double scalar multiplication in crypto/ed25519.c.
+#
+# Usage: ed25519_tab.py > ../crypto/ed25519_tab.c
+
+import ed25519
+
+# Number of odd multiples (B, 3B, ..., (2 * size - 1)B), must match
+# ED25519_BASE_TAB_SIZE in crypto/ed25519.h
+size = 16
+
+def c_bytes(name, v):
+	b = [(v >> (8 * i)) & 0xff for i in range(32)]
+	lines = []
+	for i in range(0, 32, 8):
+		lines.append("\t\t\t" + ", ".join("0x%02x" % x for x in b[i:i + 8]))
+	return "\t\t.%s = {\n%s\n\t\t}" % (name, ",\n".join(lines))
+
+print("/* Edwards curve operations, base point table")
+print(" *")
+print(" * This file is generated by tools/ed25519_tab.py, do not edit.")
+print(" */")
+print("")
+print("#include \"ed25519.h\"")
+print("")
+print("/* Odd multiples of the base point in extended coordinates (z = 1) */")
+print("const struct ed25519_pt ed25519_base_tab[ED25519_BASE_TAB_SIZE] = {")
+
+b2 = ed25519.edwards(ed25519.B, ed25519.B)
+p = ed25519.B
+for i in range(size):
+	x, y = p
+	print("\t/* %dB */" % (2 * i + 1))
+	print("\t{")
+	print(c_bytes("x", x) + ",")
+	print(c_bytes("y", y) + ",")
+	print(c_bytes("t", x * y % ed25519.q) + ",")
+	print("\t\t.z = {1, 0}")
+	print("\t}%s" % ("," if i < size - 1 else ""))
+	p = ed25519.edwards(p, b2)
+
+print("};")
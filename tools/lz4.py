@@ -0,0 +1,110 @@
+#!/usr/bin/python
+#
+# Simple LZ4 block compressor and decompressor (raw block format, no frame
+# header). Match offsets are limited to the decompression window size used
+# by the bootloader (LZ4_STREAM_WINDOW_SIZE in common/lz4_stream.h).
+#
+# This file is in the public domain.
+
+WINDOW_SIZE = 4096
+MIN_MATCH = 4
+
+# End of block restrictions of the LZ4 block format.
+LAST_LITERALS = 5
+MF_LIMIT = 12
+
+
+def _length_bytes(n):
+	out = bytearray()
+	while n >= 255:
+		out.append(255)
+		n -= 255
+	out.append(n)
+	return out
+
+
+def _sequence(literals, offset, match_len):
+	lit_len = len(literals)
+	token = min(lit_len, 15) << 4
+	if offset:
+		token |= min(match_len - MIN_MATCH, 15)
+
+	out = bytearray([token])
+	if lit_len >= 15:
+		out += _length_bytes(lit_len - 15)
+	out += literals
+	if offset:
+		out.append(offset & 0xff)
+		out.append(offset >> 8)
+		if match_len - MIN_MATCH >= 15:
+			out += _length_bytes(match_len - MIN_MATCH - 15)
+	return out
+
+
+def compress(data, window_size = WINDOW_SIZE):
+	data = bytearray(data)
+	n = len(data)
+	out = bytearray()
+
+	# Last position of every 4 byte sequence seen so far.
+	table = {}
+	anchor = 0
+	i = 0
+	limit = n - MF_LIMIT
+	while i < limit:
+		key = bytes(data[i:i + MIN_MATCH])
+		candidate = table.get(key)
+		table[key] = i
+		if candidate is None or i - candidate > window_size:
+			i += 1
+			continue
+
+		match_len = MIN_MATCH
+		max_len = n - LAST_LITERALS - i
+		while match_len < max_len and data[candidate + match_len] == data[i + match_len]:
+			match_len += 1
+
+		out += _sequence(data[anchor:i], i - candidate, match_len)
+
+		for j in range(i + 1, min(i + match_len, limit)):
+			table[bytes(data[j:j + MIN_MATCH])] = j
+		i += match_len
+		anchor = i
+
+	# The last sequence contains literals only.
+	out += _sequence(data[anchor:], 0, 0)
+	return bytes(out)
+
+
+def decompress(data):
+	data = bytearray(data)
+	out = bytearray()
+	i = 0
+	while i < len(data):
+		token = data[i]
+		i += 1
+
+		lit_len = token >> 4
+		if lit_len == 15:
+			while True:
+				lit_len += data[i]
+				i += 1
+				if data[i - 1] != 255:
+					break
+		out += data[i:i + lit_len]
+		i += lit_len
+		if i >= len(data):
+			break
+
+		offset = data[i] | data[i + 1] << 8
+		i += 2
+		match_len = (token & 0x0f) + MIN_MATCH
+		if match_len == 15 + MIN_MATCH:
+			while True:
+				match_len += data[i]
+				i += 1
+				if data[i - 1] != 255:
+					break
+		for k in range(match_len):
+			out.append(out[-offset])
+	return bytes(out)